@@ -1,8 +1,14 @@
 #pragma once
 
+#include "StringPiece.h"
+#include "SimdSearch.h"
+
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <endian.h>
 
 class Buffer{
     public:
@@ -13,6 +19,7 @@ class Buffer{
             : buffer_(kCheapPrepend + initialSize)              // 底层vector的长度
             , readerIndex_(kCheapPrepend)
             , writerIndex_(kCheapPrepend)
+            , scanned_(0)
         {}
 
         // 待读取数据长度
@@ -40,6 +47,7 @@ class Buffer{
             if(len < readableBytes()){
                 // 这里就是可读数据没有读完
                 readerIndex_ += len;
+                scanned_ = scanned_ > len ? scanned_ - len : 0;
             }else{
                 // len == readableBytes()
                 // 可读数据读完了，readerIndex_和writerIndex_都要复位
@@ -50,6 +58,105 @@ class Buffer{
         void retrieveAll(){
             readerIndex_ = kCheapPrepend;
             writerIndex_ = kCheapPrepend;
+            scanned_ = 0;
+        }
+
+        // 取走可读数据直到end，end必须在[peek(), beginWrite()]之间，一般是findCRLF等的返回值
+        void retrieveUntil(const char* end){
+            retrieve(end - peek());
+        }
+
+        // 把最多len字节的可读数据拷贝到调用者提供的dest中并取走，返回拷贝的字节数，不分配内存
+        size_t retrieveTo(void* dest, size_t len){
+            len = std::min(len, readableBytes());
+            memcpy(dest, peek(), len);
+            retrieve(len);
+            return len;
+        }
+
+        // 可读数据的只读视图，不拷贝，Buffer有写入或者取走数据以后失效
+        StringPiece toStringPiece() const{
+            return StringPiece(peek(), readableBytes());
+        }
+
+        // 查找\r\n，返回\r的位置，没有找到返回nullptr
+        const char* findCRLF() const{
+            return findCRLF(peek());
+        }
+        // 从start开始查找，start必须在可读区间内，用于从上次查找结束的位置继续
+        const char* findCRLF(const char* start) const{
+            return SimdSearch::find(start, beginWrite(), "\r\n", 2);
+        }
+
+        // 查找\n，没有找到返回nullptr
+        const char* findEOL() const{
+            return findEOL(peek());
+        }
+        const char* findEOL(const char* start) const{
+            return static_cast<const char*>(memchr(start, '\n', beginWrite() - start));
+        }
+
+        // 查找分隔符，返回分隔符在可读数据中的起始位置，没有找到返回nullptr
+        // 会记住已经查找过的位置，一条消息分多次readFd到达时，每次只查找新到达的数据；
+        // 取走数据以后继续有效，换一个分隔符查找时从头开始
+        const char* findDelimiter(const char* delim, size_t len){
+            if(scanDelim_.size() != len || memcmp(scanDelim_.data(), delim, len) != 0){
+                scanDelim_.assign(delim, len);
+                scanned_ = 0;
+            }
+            const char* found = SimdSearch::find(peek() + scanned_, beginWrite(), delim, len);
+            if(found != nullptr){
+                scanned_ = found - peek();
+            }else if(readableBytes() >= len){
+                // 最后len-1个字节可能是分隔符的前半部分，下次从这里开始
+                scanned_ = readableBytes() - len + 1;
+            }
+            return found;
+        }
+        const char* findDelimiter(const StringPiece& delim){
+            return findDelimiter(delim.data(), delim.size());
+        }
+
+        // 以网络字节序读取整数，peek不取走数据，read会取走数据
+        // 调用前需要保证readableBytes()不小于整数的长度
+        int8_t peekInt8() const{
+            return static_cast<int8_t>(*peek());
+        }
+        int16_t peekInt16() const{
+            uint16_t be16 = 0;
+            memcpy(&be16, peek(), sizeof(be16));
+            return static_cast<int16_t>(be16toh(be16));
+        }
+        int32_t peekInt32() const{
+            uint32_t be32 = 0;
+            memcpy(&be32, peek(), sizeof(be32));
+            return static_cast<int32_t>(be32toh(be32));
+        }
+        int64_t peekInt64() const{
+            uint64_t be64 = 0;
+            memcpy(&be64, peek(), sizeof(be64));
+            return static_cast<int64_t>(be64toh(be64));
+        }
+
+        int8_t readInt8(){
+            int8_t result = peekInt8();
+            retrieve(sizeof(result));
+            return result;
+        }
+        int16_t readInt16(){
+            int16_t result = peekInt16();
+            retrieve(sizeof(result));
+            return result;
+        }
+        int32_t readInt32(){
+            int32_t result = peekInt32();
+            retrieve(sizeof(result));
+            return result;
+        }
+        int64_t readInt64(){
+            int64_t result = peekInt64();
+            retrieve(sizeof(result));
+            return result;
         }
 
         std::string retrieveAsString(size_t len){
@@ -80,18 +187,95 @@ class Buffer{
             // len字节的data写入到Buffer后，就移动writerIndex_
             writerIndex_ += len;
         }
+        void append(const StringPiece& str){
+            append(str.data(), str.size());
+        }
+
+        // 以网络字节序追加整数
+        void appendInt8(int8_t x){
+            append(reinterpret_cast<const char*>(&x), sizeof(x));
+        }
+        void appendInt16(int16_t x){
+            uint16_t be16 = htobe16(static_cast<uint16_t>(x));
+            append(reinterpret_cast<const char*>(&be16), sizeof(be16));
+        }
+        void appendInt32(int32_t x){
+            uint32_t be32 = htobe32(static_cast<uint32_t>(x));
+            append(reinterpret_cast<const char*>(&be32), sizeof(be32));
+        }
+        void appendInt64(int64_t x){
+            uint64_t be64 = htobe64(static_cast<uint64_t>(x));
+            append(reinterpret_cast<const char*>(&be64), sizeof(be64));
+        }
+
+        // 在可读数据前面写入len字节，使用readerIndex_前面的预留空间，不移动已有的数据
+        // 必须要保证len <= prependableBytes()，Buffer预留了kCheapPrepend字节用来写长度头
+        void prepend(const void* data, size_t len){
+            readerIndex_ -= len;
+            const char* d = static_cast<const char*>(data);
+            std::copy(d, d + len, begin() + readerIndex_);
+            // 前面多出来的数据还没有查找过分隔符
+            scanned_ = 0;
+        }
+        void prependInt8(int8_t x){
+            prepend(&x, sizeof(x));
+        }
+        void prependInt16(int16_t x){
+            uint16_t be16 = htobe16(static_cast<uint16_t>(x));
+            prepend(&be16, sizeof(be16));
+        }
+        void prependInt32(int32_t x){
+            uint32_t be32 = htobe32(static_cast<uint32_t>(x));
+            prepend(&be32, sizeof(be32));
+        }
+        void prependInt64(int64_t x){
+            uint64_t be64 = htobe64(static_cast<uint64_t>(x));
+            prepend(&be64, sizeof(be64));
+        }
         
         char* beginWrite() {
             return begin() + writerIndex_;
         }
 
+        // 直接往beginWrite()写入len字节以后调用，调用前需要ensureWritableBytes(len)
+        void hasWritten(size_t len){
+            writerIndex_ += len;
+        }
+        // 撤销最后写入的len字节，len <= readableBytes()
+        void unwrite(size_t len){
+            writerIndex_ -= len;
+            scanned_ = 0;
+        }
+
         const char* beginWrite() const{
             return begin() + writerIndex_;
         }
 
+        // 底层vector的容量
+        size_t internalCapacity() const{
+            return buffer_.capacity();
+        }
+
+        // 释放多余的内存，只保留可读数据和reserve字节的可写空间
+        void shrink(size_t reserve){
+            Buffer other(readableBytes() + reserve);
+            other.append(peek(), readableBytes());
+            swap(other);
+        }
+
+        void swap(Buffer& rhs){
+            buffer_.swap(rhs.buffer_);
+            std::swap(readerIndex_, rhs.readerIndex_);
+            std::swap(writerIndex_, rhs.writerIndex_);
+            std::swap(scanned_, rhs.scanned_);
+            scanDelim_.swap(rhs.scanDelim_);
+        }
+
         // 从fd上读取数据，存放到writerIndex_，返回实际读取的数据大小
         ssize_t readFd(int fd, int* saveErrno);
         ssize_t writeFd(int fd, int* saveErrno);
+        // 最多写maxBytes字节，用于发送限速
+        ssize_t writeFd(int fd, size_t maxBytes, int* saveErrno);
 
 
     private:
@@ -120,4 +304,6 @@ class Buffer{
         std::vector<char> buffer_;                               // vector管理的资源自动释放，Buffer对象在哪个区，buffer_就在哪个区，主要利用vector自动扩容的功能
         size_t readerIndex_;
         size_t writerIndex_;
+        size_t scanned_;                                         // findDelimiter已经查找过的可读数据长度
+        std::string scanDelim_;                                  // findDelimiter上次查找的分隔符
 };
@@ -12,4 +12,22 @@ using ConnectionCallback = std::function<void(const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*, Timestamp)>;
-using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void (const TcpConnectionPtr&, size_t)>;
+using TimerCallback = std::function<void()>;
+using ReleaseCallback = std::function<void()>;
+// 流式发送的生产者，往Buffer中追加下一段数据，数据全部产生完时返回false
+using StreamProducer = std::function<bool(Buffer*)>;
+
+// 零拷贝接收时交给用户的只读数据片段，只在回调期间有效
+struct ReadSpan{
+    const char* data;
+    size_t length;
+};
+// 按顺序给出本次收到的数据片段，回调返回后数据就被丢弃了，需要保留的数据用户自己拷贝
+using ZeroCopyReadCallback = std::function<void(const TcpConnectionPtr&, const ReadSpan* spans, int count, Timestamp)>;
+
+class UdpSocket;
+struct UdpDatagram;
+using UdpSocketPtr = std::shared_ptr<UdpSocket>;
+// 收到一个UDP数据报，datagram中的数据只在回调期间有效
+using UdpMessageCallback = std::function<void(const UdpSocketPtr&, const UdpDatagram& datagram, Timestamp)>;
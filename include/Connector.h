@@ -0,0 +1,78 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <memory>
+
+class Channel;
+class EventLoop;
+
+/**
+ * 主动发起连接，非阻塞connect，连接失败后通过loop的定时器重试，重试间隔按指数增长
+ * 只负责拿到连接成功的sockfd，TcpConnection由TcpClient创建
+ */
+class Connector : noncopyable, public std::enable_shared_from_this<Connector>{
+    public:
+        using NewConnectionCallback = std::function<void(int sockfd)>;
+        // 放弃连接时回调，err是最后一次失败的errno
+        using ConnectFailedCallback = std::function<void(int err)>;
+
+        Connector(EventLoop* loop, const InetAddress& serverAddr);
+        ~Connector();
+
+        void setNewConnectionCallback(const NewConnectionCallback& cb){ newConnectionCallback_ = cb; }
+        // 重试也不会成功的错误（EACCES等），或者连续重试maxRetries次都失败以后回调，之后不再重试
+        void setConnectFailedCallback(const ConnectFailedCallback& cb){ connectFailedCallback_ = cb; }
+        // -1表示一直重试，需要在start之前设置
+        void setMaxRetries(int maxRetries){ maxRetries_ = maxRetries; }
+        // 重试间隔从initMs开始，每次失败翻倍，最多maxMs
+        void setRetryDelay(int initMs, int maxMs){
+            initRetryDelayMs_ = initMs;
+            maxRetryDelayMs_ = maxMs;
+            retryDelayMs_ = initMs;
+        }
+
+        const InetAddress& serverAddress() const { return serverAddr_; }
+
+        void start();    // 可以在任意线程调用
+        void restart();  // 只能在loop线程调用
+        void stop();     // 可以在任意线程调用
+
+    private:
+        enum States{ kDisconnected, kConnecting, kConnected };
+        static const int kInitRetryDelayMs = 500;
+        static const int kMaxRetryDelayMs = 30 * 1000;
+
+        void setState(States s){ state_ = s; }
+        void startInLoop();
+        void stopInLoop();
+        void connect();
+        // connect正在进行，关注sockfd的写事件，可写时说明连接建立成功或者失败了
+        void connecting(int sockfd);
+        void handleWrite();
+        void handleError();
+        // 关闭sockfd，定时器到期后重新connect，重试次数用完后回调connectFailedCallback_
+        void retry(int sockfd, int err);
+        void giveUp(int err);
+        int removeAndResetChannel();
+        void resetChannel();
+
+        EventLoop* loop_;
+        InetAddress serverAddr_;
+        bool connect_;                      // 用户是否要求连接，stop后为false
+        States state_;
+        std::unique_ptr<Channel> channel_;  // 只在connect进行中存在
+        NewConnectionCallback newConnectionCallback_;
+        ConnectFailedCallback connectFailedCallback_;
+        int maxRetries_;
+        int retries_;                       // 连续失败的次数，连接成功或者restart后清零
+        int initRetryDelayMs_;
+        int maxRetryDelayMs_;
+        int retryDelayMs_;
+        TimerId retryTimer_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
@@ -3,6 +3,8 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callbacks.h"
+#include "TimerId.h"
 
 #include <functional>
 #include <vector>
@@ -12,6 +14,7 @@
 
 class Channel;
 class Poller;
+class TimerQueue;
 
 /**
  * 事件循环类：主要包含两个大模块 Channel（包含了监听的sockfd，感兴趣的事件和发生的事件） Poller（epoll的抽象）
@@ -33,6 +36,12 @@ class EventLoop : noncopyable{
 
         void wakeup();                               // 用于唤醒loop所在线程
 
+        // 定时器，可以在任意线程调用，回调在loop所在线程执行
+        TimerId runAt(Timestamp time, TimerCallback cb);         // 在time时刻执行cb
+        TimerId runAfter(double delay, TimerCallback cb);        // delay秒后执行cb
+        TimerId runEvery(double interval, TimerCallback cb);     // 每隔interval秒执行一次cb
+        void cancel(TimerId timerId);                            // 取消定时器
+
         void updateChannel(Channel* channel);        // Channel调用所在loop的updateChannel来epoll_ctl  EPOLL_CTL_ADD  EPOLL_CTL_MOD
         void removeChannel(Channel* channel);        // Channel调用所在loop的removeChannel来epoll_ctl  EPOLL_CTL_DEL
 
@@ -57,6 +66,7 @@ class EventLoop : noncopyable{
         
         Timestamp pollReturnTime_;                   // 记录Poller返回发生事件的Channels的时间，有事件发生后，Poller会返回所有有事件发生的Channel
         std::unique_ptr<Poller> poller_;             // EventLoop对象管理的唯一的poller
+        std::unique_ptr<TimerQueue> timerQueue_;     // 定时器队列，timerfd也由poller_监听
 
         int wakeupFd_;                               // eventfd()创建的，作用是当mainLoop获取一个新用户的Channel，通过轮询算法选择一个subLoop，通过wakeupFd_唤醒subLoop处理事件，每一个subReactor都监听了wakeupFd_
         std::unique_ptr<Channel> wakeupChannel_;     // 用于封装wakeupFd_
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+
+/**
+ * 每条连接的HTTP解析状态，保存在TcpConnection的context中
+ * 增量解析：数据分多次到达时，已经查找过的头部不会重新查找，已经解码的chunk不会重新解码
+ * 请求数据一直留在inputBuffer_中，解析结果只记录偏移，请求完整以后HttpRequest直接指向inputBuffer_
+ */
+class HttpContext : noncopyable{
+    public:
+        enum ParseResult{
+            kIncomplete,    // 数据还不够一个完整的请求
+            kComplete,      // request()可用，处理完以后调用finishRequest
+            kError,         // 请求不合法，errorStatus()是应该返回的状态码，需要关闭连接
+        };
+
+        HttpContext(size_t maxHeaderSize, size_t maxBodySize);
+
+        // 从buff的可读数据开头解析一个请求，一个请求在finishRequest之前重复调用是安全的
+        ParseResult parseRequest(Buffer* buff, Timestamp receiveTime);
+        // 从buff中取走已经处理完的请求，准备解析下一个请求（流水线中的请求已经在buff中了）
+        void finishRequest(Buffer* buff);
+
+        const HttpRequest& request() const { return request_; }
+        HttpResponse* response() { return &response_; }
+        // 序列化响应用的缓冲区，一次收到的多个流水线请求的响应写在一起，一次发送
+        Buffer* output() { return &output_; }
+        int errorStatus() const { return errorStatus_; }
+
+        // 请求带了Expect: 100-continue并且请求体还没有收到时返回true，只返回一次
+        bool takeExpectContinue();
+
+    private:
+        enum ParseState{
+            kExpectHeaders,
+            kExpectBody,            // Content-Length
+            kExpectChunkSize,
+            kExpectChunkData,
+            kExpectChunkDataCRLF,
+            kExpectTrailers,
+            kGotAll,
+        };
+
+        ParseResult fail(int status);
+        bool parseHeaders(const char* begin, const char* end);
+        bool parseRequestLine(const char* begin, const char* end);
+        ParseResult parseChunked(Buffer* buff);
+        void complete(Buffer* buff, Timestamp receiveTime);
+
+        const size_t maxHeaderSize_;
+        const size_t maxBodySize_;
+        ParseState state_;
+        size_t headerLength_;           // 请求行和头部的长度，包括最后的空行
+        size_t offset_;                 // chunked时下一个要解析的位置，相对于请求起始位置
+        size_t chunkRemaining_;         // 当前chunk还没有收到的数据
+        size_t requestLength_;          // 整个请求在buff中的长度
+        bool expectContinue_;
+        int errorStatus_;
+        HttpRequest request_;
+        HttpResponse response_;
+        Buffer chunkedBody_;            // 解码以后的chunked请求体
+        Buffer output_;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <vector>
+#include <stdint.h>
+#include <strings.h>
+
+/**
+ * HttpContext解析出来的一个请求，不拷贝数据，所有的StringPiece都指向连接的inputBuffer_，
+ * 只在HttpServer的回调中有效，需要保存时拷贝一份
+ */
+class HttpRequest{
+    public:
+        enum Method{
+            kInvalid,
+            kGet,
+            kPost,
+            kHead,
+            kPut,
+            kDelete,
+            kOptions,
+            kPatch,
+        };
+
+        enum Version{
+            kUnknown,
+            kHttp10,
+            kHttp11,
+        };
+
+        HttpRequest()
+            : base_(nullptr)
+            , method_(kInvalid)
+            , version_(kUnknown)
+            , chunked_(false)
+            , contentLength_(0)
+        {}
+
+        Method method() const { return method_; }
+        Version version() const { return version_; }
+        StringPiece methodString() const { return piece(methodRange_); }
+        // 请求行中的路径，不包括?后面的查询参数
+        StringPiece path() const { return piece(pathRange_); }
+        StringPiece query() const { return piece(queryRange_); }
+        Timestamp receiveTime() const { return receiveTime_; }
+
+        // 字段名不区分大小写，没有这个字段时返回空的StringPiece
+        StringPiece getHeader(const StringPiece& field) const{
+            for(const Header& header : headers_){
+                StringPiece name = piece(header.name);
+                if(name.size() == field.size() && strncasecmp(name.data(), field.data(), name.size()) == 0){
+                    return piece(header.value);
+                }
+            }
+            return StringPiece();
+        }
+        size_t headerCount() const { return headers_.size(); }
+        StringPiece headerName(size_t i) const { return piece(headers_[i].name); }
+        StringPiece headerValue(size_t i) const { return piece(headers_[i].value); }
+
+        // chunked的请求体已经解码，是连续的一段数据
+        const StringPiece& body() const { return body_; }
+        bool chunked() const { return chunked_; }
+
+        // HTTP/1.1默认保持连接，HTTP/1.0需要Connection: keep-alive
+        bool keepAlive() const{
+            StringPiece connection = getHeader("Connection");
+            if(version_ == kHttp11){
+                return !hasToken(connection, "close");
+            }
+            return hasToken(connection, "keep-alive");
+        }
+
+        // 逗号分隔的字段值中是否有token，不区分大小写
+        static bool hasToken(const StringPiece& value, const StringPiece& token){
+            const char* p = value.begin();
+            while(p < value.end()){
+                while(p < value.end() && (*p == ' ' || *p == '\t' || *p == ',')){
+                    ++p;
+                }
+                const char* start = p;
+                while(p < value.end() && *p != ',' && *p != ' ' && *p != '\t'){
+                    ++p;
+                }
+                if(static_cast<size_t>(p - start) == token.size() && strncasecmp(start, token.data(), token.size()) == 0){
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        friend class HttpContext;
+
+        // 相对于请求起始位置的偏移，inputBuffer_扩容移动数据以后依然有效
+        struct Range{
+            uint32_t offset;
+            uint32_t length;
+        };
+        struct Header{
+            Range name;
+            Range value;
+        };
+
+        StringPiece piece(const Range& range) const{
+            return StringPiece(base_ + range.offset, range.length);
+        }
+
+        const char* base_;                  // 请求在inputBuffer_中的起始位置，请求完整以后才设置
+        Method method_;
+        Version version_;
+        Range methodRange_;
+        Range pathRange_;
+        Range queryRange_;
+        std::vector<Header> headers_;       // 请求之间复用，不会每个请求都分配内存
+        bool chunked_;
+        size_t contentLength_;
+        StringPiece body_;
+        Timestamp receiveTime_;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "StringPiece.h"
+
+/**
+ * HTTP响应，头部字段和响应体都写在复用的Buffer中，HttpServer把它序列化到连接的发送缓冲区
+ * 每条连接一个HttpResponse，请求之间只清空数据，不释放内存
+ */
+class HttpResponse : noncopyable{
+    public:
+        enum StatusCode{
+            k100Continue = 100,
+            k101SwitchingProtocols = 101,
+            k200Ok = 200,
+            k204NoContent = 204,
+            k301MovedPermanently = 301,
+            k400BadRequest = 400,
+            k403Forbidden = 403,
+            k404NotFound = 404,
+            k413PayloadTooLarge = 413,
+            k426UpgradeRequired = 426,
+            k431HeaderFieldsTooLarge = 431,
+            k500InternalServerError = 500,
+            k501NotImplemented = 501,
+            k505VersionNotSupported = 505,
+        };
+
+        explicit HttpResponse(bool close = false);
+
+        // 开始一个新的响应，状态码200，http10表示请求是HTTP/1.0的
+        void reset(bool close, bool http10 = false);
+
+        void setStatusCode(int code){ statusCode_ = code; }
+        int statusCode() const { return statusCode_; }
+        void setCloseConnection(bool on){ closeConnection_ = on; }
+        // 没有长度、以关闭连接表示响应体结束时，总是关闭连接
+        bool closeConnection() const { return closeConnection_ || closeDelimited_; }
+
+        void setContentType(const StringPiece& contentType){ addHeader("Content-Type", contentType); }
+        // 不要添加Content-Length、Transfer-Encoding和Connection，这些由appendToBuffer生成，101响应除外
+        void addHeader(const StringPiece& field, const StringPiece& value);
+
+        void setBody(const StringPiece& body){
+            body_.retrieveAll();
+            body_.append(body);
+        }
+        void appendBody(const StringPiece& data){ body_.append(data); }
+        // 直接往响应体中写数据
+        Buffer* body(){ return &body_; }
+
+        // 使用chunked传输编码，每次appendChunk是一个chunk，不需要事先知道响应体的长度
+        // 需要在写响应体之前调用；HTTP/1.0的请求不支持chunked，appendChunk的数据原样作为响应体，发送完后关闭连接
+        void setChunked(bool on);
+        void appendChunk(const StringPiece& data);
+
+        // 序列化完整的响应，includeBody为false时只有头部（HEAD请求）
+        void appendToBuffer(Buffer* output, bool includeBody = true) const;
+
+        // 状态码对应的默认原因短语
+        static const char* statusMessage(int code);
+
+    private:
+        int statusCode_;
+        bool closeConnection_;
+        bool chunked_;
+        bool http10_;
+        bool closeDelimited_;           // HTTP/1.0请求设置了chunked，不写Content-Length，关闭连接表示响应体结束
+        Buffer headers_;                // 用户添加的头部字段，已经是"field: value\r\n"的格式
+        Buffer body_;                   // 响应体，chunked时已经是编码以后的格式
+};
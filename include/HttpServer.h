@@ -0,0 +1,52 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+
+#include <functional>
+#include <string>
+
+/**
+ * HTTP/1.1服务器，支持长连接、流水线请求和chunked传输编码
+ * 回调在连接所在的subloop中同步执行，填好HttpResponse返回以后才处理下一个请求，流水线请求按顺序响应
+ * 一次收到的多个请求的响应序列化到同一个缓冲区，一次发送
+ */
+class HttpServer : noncopyable{
+    public:
+        using HttpCallback = std::function<void(const HttpRequest&, HttpResponse*)>;
+        // 带Upgrade头部的请求交给这个回调，接受升级时把response设置成101，返回升级以后处理连接数据的回调
+        // 返回空的回调表示不升级：修改了状态码时response作为拒绝升级的响应发送，状态码还是200时按普通请求交给HttpCallback
+        using UpgradeCallback = std::function<MessageCallback(const TcpConnectionPtr&, const HttpRequest&, HttpResponse*)>;
+
+        HttpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, TcpServer::Option option = TcpServer::kNoReusePort);
+
+        EventLoop* getLoop() const { return loop_; }
+        // 底层的TcpServer，用于设置限速、内存预算等连接选项
+        TcpServer* tcpServer() { return &server_; }
+
+        // 没有设置时所有请求都返回404
+        void setHttpCallback(const HttpCallback& cb){ httpCallback_ = cb; }
+        void setUpgradeCallback(const UpgradeCallback& cb){ upgradeCallback_ = cb; }
+        // 连接建立、断开时在HttpServer自己的处理之后调用
+        void setConnectionCallback(const ConnectionCallback& cb){ connectionCallback_ = cb; }
+        // 头部、请求体超过限制时返回431、413并关闭连接
+        void setMaxHeaderSize(size_t bytes){ maxHeaderSize_ = bytes; }
+        void setMaxBodySize(size_t bytes){ maxBodySize_ = bytes; }
+
+        void setThreadNum(int numThreads){ server_.setThreadNum(numThreads); }
+        void start();
+
+    private:
+        void onConnection(const TcpConnectionPtr& conn);
+        void onMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime);
+
+        EventLoop* loop_;
+        TcpServer server_;
+        HttpCallback httpCallback_;
+        UpgradeCallback upgradeCallback_;
+        ConnectionCallback connectionCallback_;
+        size_t maxHeaderSize_;
+        size_t maxBodySize_;
+};
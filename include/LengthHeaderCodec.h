@@ -0,0 +1,49 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "StringPiece.h"
+#include "Timestamp.h"
+
+#include <functional>
+
+/**
+ * 长度头分帧编解码器，每一帧前面是4字节网络字节序的长度（不包括长度头本身）
+ * 编码时长度头写在Buffer的预留空间中，不移动消息数据
+ * 解码时只把完整的帧交给用户，一次readFd收到的所有完整帧一起交付
+ *
+ * 用法：server.setMessageCallback(codec.messageCallback());
+ * 同一个codec可以给多个连接、多个loop线程使用
+ */
+class LengthHeaderCodec : noncopyable{
+    public:
+        // frame指向连接的inputBuffer_，只在回调中有效，需要保存时拷贝一份
+        using FrameCallback = std::function<void(const TcpConnectionPtr&, const StringPiece& frame, Timestamp)>;
+        // 一次交付多个完整的帧，count最大为kMaxBatch
+        using FrameBatchCallback = std::function<void(const TcpConnectionPtr&, const StringPiece* frames, int count, Timestamp)>;
+
+        static const size_t kHeaderLen = sizeof(int32_t);
+        static const int kMaxBatch = 64;
+
+        // 长度超过maxFrameSize的帧视为错误，关闭连接
+        explicit LengthHeaderCodec(const FrameCallback& cb, size_t maxFrameSize = 64*1024*1024);
+        explicit LengthHeaderCodec(const FrameBatchCallback& cb, size_t maxFrameSize = 64*1024*1024);
+
+        // 作为TcpServer、TcpClient的MessageCallback
+        MessageCallback messageCallback();
+        void onMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime);
+
+        // 在buff的可读数据前面写入长度头
+        static void encode(Buffer* buff);
+        // 发送一帧，buff中的数据会被取走，不拷贝
+        void send(const TcpConnectionPtr& conn, Buffer* buff);
+        void send(const TcpConnectionPtr& conn, const StringPiece& message);
+
+    private:
+        void deliver(const TcpConnectionPtr& conn, const StringPiece* frames, int count, Timestamp receiveTime);
+
+        FrameCallback frameCallback_;
+        FrameBatchCallback frameBatchCallback_;
+        const size_t maxFrameSize_;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "MemcacheStore.h"
+
+#include <string>
+#include <atomic>
+
+/**
+ * 兼容memcached文本协议的缓存服务器
+ * 支持get/gets（多个key）、set/add/replace/append/prepend/cas、delete、incr/decr、touch、flush_all、stats、version、quit，以及noreply
+ * 一次收到的多条命令（流水线、multi-get）的响应写进同一个缓冲区，处理完以后一次发送
+ * 所有subloop共享一个MemcacheStore，store内部按key分shard加锁
+ */
+class MemcacheServer : noncopyable{
+    public:
+        MemcacheServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, size_t memoryLimit = 64*1024*1024, int shards = 16, TcpServer::Option option = TcpServer::kNoReusePort);
+
+        TcpServer* tcpServer() { return &server_; }
+        MemcacheStore* store() { return &store_; }
+
+        void setThreadNum(int numThreads){ server_.setThreadNum(numThreads); }
+        void start();
+
+    private:
+        struct Context;
+
+        void onConnection(const TcpConnectionPtr& conn);
+        void onMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime);
+        // 处理buff开头的一条命令，数据不完整时返回false；需要关闭连接时设置close
+        bool processCommand(Context* context, Buffer* buff, bool* close);
+        bool processStorage(const StringPiece* tokens, int count, bool noreply, Context* context, Buffer* buff, size_t lineLen, bool* close);
+        void appendStats(Buffer* output);
+
+        TcpServer server_;
+        MemcacheStore store_;
+        const Timestamp startTime_;
+        std::atomic<int> currConnections_;
+        std::atomic<uint64_t> totalConnections_;
+        std::atomic<uint64_t> cmdSet_;
+};
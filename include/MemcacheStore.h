@@ -0,0 +1,108 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Buffer.h"
+#include "StringPiece.h"
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * memcached语义的内存缓存，可以被多个loop线程同时访问
+ * 按key的哈希值分成多个shard，每个shard一把锁，不同shard上的操作互不影响
+ * 每个shard有自己的哈希表和slab分配器：数据项按大小放进不同的slab class，每个class有自己的空闲链表和LRU链表
+ * 内存按页（最大数据项大小，默认1MB）从所有shard共享的预算中分配，预算用完以后淘汰同一个class中最久没有访问的数据项
+ * 和memcached一样，页分给一个class以后不再回收，其它class没有页时返回内存不足
+ * 内存上限很小时会减少shard的个数，保证每个shard都能分到几页
+ */
+class MemcacheStore : noncopyable{
+    public:
+        enum StoreMode{
+            kSet,
+            kAdd,           // key不存在时才保存
+            kReplace,       // key存在时才保存
+            kAppend,
+            kPrepend,
+            kCas,           // cas值相同时才保存
+        };
+        enum StoreResult{
+            kStored,
+            kNotStored,
+            kExists,        // cas值不同
+            kNotFound,      // cas的key不存在
+            kTooLarge,
+            kOutOfMemory,
+        };
+        enum DeltaResult{
+            kDeltaOk,
+            kDeltaNotFound,
+            kDeltaNonNumeric,
+            kDeltaOutOfMemory,
+        };
+
+        struct Stats{
+            size_t currItems;
+            size_t totalItems;
+            size_t bytes;
+            uint64_t getHits;
+            uint64_t getMisses;
+            uint64_t evictions;
+            size_t pagesUsed;
+            size_t pageLimit;
+            size_t pageSize;
+        };
+
+        static const size_t kMaxKeyLen = 250;
+
+        // memoryLimit是所有数据项占用的内存上限，不包括哈希表
+        MemcacheStore(size_t memoryLimit, int shards = 16, size_t maxItemSize = 1024*1024);
+        ~MemcacheStore();
+
+        size_t maxItemSize() const { return maxItemSize_; }
+
+        // 命中时把"VALUE key flags bytes [cas]\r\n数据\r\n"追加到output，持有锁时直接从slab拷贝到output
+        bool get(const StringPiece& key, bool withCas, Buffer* output);
+        // exptime和memcached一样：0不过期，不超过30天是相对时间，否则是unix时间，负数表示立即过期
+        StoreResult store(StoreMode mode, const StringPiece& key, uint32_t flags, int64_t exptime, const StringPiece& value, uint64_t casUnique = 0);
+        bool remove(const StringPiece& key);
+        // 值必须是十进制的无符号整数，incr按2^64回绕，decr最小减到0
+        DeltaResult delta(const StringPiece& key, bool incr, uint64_t amount, uint64_t* result);
+        bool touch(const StringPiece& key, int64_t exptime);
+        // delay秒以后，之前保存的数据项全部失效
+        void flushAll(int64_t delay = 0);
+
+        Stats stats();
+
+    private:
+        struct Item;
+        struct SlabClass;
+        struct Shard;
+
+        Shard* shardFor(size_t hash) { return shards_[hash % shards_.size()].get(); }
+        int classFor(size_t itemSize) const;
+
+        Item* find(Shard* shard, size_t hash, const StringPiece& key, uint32_t now);
+        Item* allocItem(Shard* shard, size_t itemSize, uint32_t now);
+        void freeItem(Shard* shard, Item* item);
+        bool grabPage(Shard* shard, int classId);
+        // 放进哈希表和LRU链表的头部
+        void linkItem(Shard* shard, Item* item);
+        // 从哈希表和LRU链表中摘下来，不释放
+        void unlinkItem(Shard* shard, Item* item);
+        void lruRemove(Shard* shard, Item* item);
+        void lruPushFront(Shard* shard, Item* item);
+        bool expired(const Item* item, uint32_t now) const;
+        uint32_t convertExptime(int64_t exptime, uint32_t now) const;
+
+        const size_t maxItemSize_;
+        const size_t pageSize_;
+        const size_t pageLimit_;
+        std::vector<size_t> classSizes_;                // 每个slab class的chunk大小，从小到大
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<size_t> pagesUsed_;
+        std::atomic<uint64_t> nextCas_;
+        std::atomic<uint32_t> flushTime_;              // 到了这个时间，之前保存的数据项失效，0表示没有延迟的flush
+        std::atomic<uint64_t> flushCas_;               // cas值小于它的数据项已经被flush
+};
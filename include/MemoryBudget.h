@@ -0,0 +1,74 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+class TcpConnection;
+
+/**
+ * 服务器级别的内存预算，统计所有TcpConnection的inputBuffer_、outputBuffer_占用的内存和其他排队发送的数据
+ * 多个subloop中的连接共享同一个MemoryBudget，usage_使用原子变量，超过预算后按照policy_处理
+ */
+class MemoryBudget : noncopyable{
+    public:
+        // 超过预算时的处理策略
+        enum Policy{
+            kPauseReading,      // 暂停占用较多的连接的读，预算降到恢复线以下再恢复读
+            kRejectSend,        // 拒绝新的send，直接丢弃数据
+            kCloseConnection,   // 关闭占用较多的连接
+        };
+
+        MemoryBudget(size_t limit, Policy policy);
+        ~MemoryBudget();
+
+        size_t limit() const { return limit_; }
+        Policy policy() const { return policy_; }
+        // 当前所有连接占用的内存总量，可以在任意线程读取
+        size_t usage() const { return usage_; }
+        bool exceeded() const { return usage_ > limit_; }
+        size_t connectionCount() const { return connections_; }
+
+        // 每条连接平均能分到的预算，超过预算时，占用超过平均值的连接就认为是"最重"的连接，需要被处理
+        // 这样不需要在多个线程之间对所有连接排序
+        size_t fairShare() const;
+
+        void addConnection(){ ++connections_; }
+        void removeConnection(){ --connections_; }
+
+        // 连接积压的数据增加、减少，由连接所在的loop线程调用
+        void charge(size_t bytes);
+        void release(size_t bytes);
+
+        // kPauseReading策略下，记录暂停读的连接，usage_降到恢复线以下时，在各自的loop中恢复读
+        void addPausedConnection(const std::weak_ptr<TcpConnection>& conn);
+
+        void countRejectedSend(){ ++rejectedSends_; }
+        void countClosedConnection(){ ++closedConnections_; }
+
+        uint64_t rejectedSends() const { return rejectedSends_; }
+        uint64_t closedConnections() const { return closedConnections_; }
+        uint64_t pausedConnections() const { return pausedConnections_; }
+
+    private:
+        void resumePausedConnections();
+
+        const size_t limit_;
+        const size_t resumeThreshold_;                        // 恢复读的阈值，比limit_低一些，避免在limit_附近反复暂停、恢复
+        const Policy policy_;
+
+        std::atomic<size_t> usage_;
+        std::atomic<size_t> connections_;
+        std::atomic<uint64_t> rejectedSends_;
+        std::atomic<uint64_t> closedConnections_;
+        std::atomic<uint64_t> pausedConnections_;
+
+        std::atomic_bool hasPaused_;                          // 避免每次release都去加锁检查paused_
+        std::mutex mutex_;                                    // 保护paused_
+        std::vector<std::weak_ptr<TcpConnection>> paused_;
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <string>
+
+// 序列化好的、不再修改的待发送数据
+// 多条连接发送同一份数据时共享一个Payload，TcpConnection只持有引用，数据写入内核以后才释放引用
+class Payload : noncopyable{
+    public:
+        explicit Payload(std::string&& data)
+            : data_(std::move(data))
+        {}
+        explicit Payload(const std::string& data)
+            : data_(data)
+        {}
+        Payload(const char* data, size_t len)
+            : data_(data, len)
+        {}
+
+        const char* data() const { return data_.data(); }
+        size_t size() const { return data_.size(); }
+
+    private:
+        const std::string data_;
+};
+
+using PayloadPtr = std::shared_ptr<const Payload>;
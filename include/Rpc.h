@@ -0,0 +1,193 @@
+#pragma once
+
+#include "Buffer.h"
+#include "StringPiece.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+
+/**
+ * RPC的公共部分：状态码、帧格式和消息的序列化
+ *
+ * 帧格式（所有整数都是网络字节序）：
+ *   请求：len(4) | kRequest(1) | id(8) | timeoutMs(4) | methodLen(1) | method | 请求消息
+ *   响应：len(4) | kResponse(1) | id(8) | status(1) | 响应消息
+ *   取消：len(4) | kCancel(1) | id(8)
+ * len是长度头后面的字节数，和LengthHeaderCodec的格式一样；id由客户端分配，一条连接上可以同时有很多个请求，响应按id匹配，不要求按顺序返回
+ *
+ * 消息的格式由消息类型的schema成员函数描述，同一个描述既用于编码也用于解码：
+ *   struct EchoRequest{
+ *       StringPiece text;
+ *       int32_t repeat;
+ *       template<typename Archive> void schema(Archive& ar){ ar.field(text); ar.field(repeat); }
+ *   };
+ * 解码时StringPiece字段直接指向收到的帧（连接的inputBuffer_），不拷贝，只在回调中有效；需要保存的字段声明成std::string
+ */
+namespace Rpc{
+    enum Status{
+        kOk = 0,
+        kNoSuchMethod = 1,
+        kBadRequest = 2,            // 请求消息解码失败
+        kDeadlineExceeded = 3,
+        kCancelled = 4,
+        kConnectionClosed = 5,      // 请求发出后连接断开，不知道服务端有没有执行
+        kInternalError = 6,
+        kUserError = 64,            // 64以上留给业务自己定义
+    };
+    const char* statusString(int status);
+
+    enum FrameKind{
+        kRequest = 1,
+        kResponse = 2,
+        kCancel = 3,
+    };
+
+    const size_t kLengthLen = sizeof(int32_t);
+    const size_t kCancelFrameLen = kLengthLen + 1 + 8;
+    const size_t kResponseHeaderLen = kCancelFrameLen + 1;
+    const size_t kMaxMethodLen = 255;
+
+    // 开始写一帧：写入长度头占位、类型和id，返回帧在buff可读数据中的起始位置
+    size_t beginFrame(Buffer* buff, FrameKind kind, uint64_t id);
+    // 帧的数据写完以后回填长度头
+    void endFrame(Buffer* buff, size_t frameStart);
+    // 在buff中写入一个完整的请求帧
+    void appendRequest(Buffer* buff, uint64_t id, const StringPiece& method, uint32_t timeoutMs, const StringPiece& request);
+    void appendCancel(Buffer* buff, uint64_t id);
+
+    // 序列化：整数按网络字节序定长编码，字符串和数组前面是4字节的长度
+    class Writer{
+        public:
+            explicit Writer(Buffer* buff)
+                : buff_(buff)
+            {}
+
+            void field(int8_t x){ buff_->appendInt8(x); }
+            void field(int16_t x){ buff_->appendInt16(x); }
+            void field(int32_t x){ buff_->appendInt32(x); }
+            void field(int64_t x){ buff_->appendInt64(x); }
+            void field(uint8_t x){ buff_->appendInt8(static_cast<int8_t>(x)); }
+            void field(uint16_t x){ buff_->appendInt16(static_cast<int16_t>(x)); }
+            void field(uint32_t x){ buff_->appendInt32(static_cast<int32_t>(x)); }
+            void field(uint64_t x){ buff_->appendInt64(static_cast<int64_t>(x)); }
+            void field(bool x){ buff_->appendInt8(x ? 1 : 0); }
+            void field(double x){
+                uint64_t bits;
+                memcpy(&bits, &x, sizeof(bits));
+                field(bits);
+            }
+            void field(const StringPiece& s){
+                field(static_cast<uint32_t>(s.size()));
+                buff_->append(s);
+            }
+            void field(const std::string& s){ field(StringPiece(s)); }
+            template<typename T>
+            void field(const std::vector<T>& v){
+                field(static_cast<uint32_t>(v.size()));
+                for(const T& x : v){
+                    field(x);
+                }
+            }
+            // 嵌套的消息，schema对Writer只读不写
+            template<typename T>
+            void field(const T& msg){ const_cast<T&>(msg).schema(*this); }
+
+        private:
+            Buffer* buff_;
+    };
+
+    // 反序列化，数据不够或者长度不合法时ok()变成false，之后的字段都不再读取
+    class Reader{
+        public:
+            explicit Reader(const StringPiece& data)
+                : cur_(data.data())
+                , end_(data.data() + data.size())
+                , ok_(true)
+            {}
+
+            bool ok() const { return ok_; }
+            // 所有数据都正好读完
+            bool done() const { return ok_ && cur_ == end_; }
+            StringPiece remaining() const { return StringPiece(cur_, end_ - cur_); }
+
+            void field(int8_t& x){ readRaw(&x, sizeof(x)); }
+            void field(int16_t& x){ uint16_t be16 = 0; readRaw(&be16, sizeof(be16)); x = static_cast<int16_t>(be16toh(be16)); }
+            void field(int32_t& x){ uint32_t be32 = 0; readRaw(&be32, sizeof(be32)); x = static_cast<int32_t>(be32toh(be32)); }
+            void field(int64_t& x){ uint64_t be64 = 0; readRaw(&be64, sizeof(be64)); x = static_cast<int64_t>(be64toh(be64)); }
+            void field(uint8_t& x){ readRaw(&x, sizeof(x)); }
+            void field(uint16_t& x){ uint16_t be16 = 0; readRaw(&be16, sizeof(be16)); x = be16toh(be16); }
+            void field(uint32_t& x){ uint32_t be32 = 0; readRaw(&be32, sizeof(be32)); x = be32toh(be32); }
+            void field(uint64_t& x){ uint64_t be64 = 0; readRaw(&be64, sizeof(be64)); x = be64toh(be64); }
+            void field(bool& x){ uint8_t b = 0; field(b); x = (b != 0); }
+            void field(double& x){
+                uint64_t bits = 0;
+                field(bits);
+                memcpy(&x, &bits, sizeof(x));
+            }
+            // 不拷贝，指向被解码的数据
+            void field(StringPiece& s){
+                uint32_t len = 0;
+                field(len);
+                if(!ok_ || len > static_cast<size_t>(end_ - cur_)){
+                    ok_ = false;
+                    return;
+                }
+                s.set(cur_, len);
+                cur_ += len;
+            }
+            void field(std::string& s){
+                StringPiece view;
+                field(view);
+                if(ok_){
+                    s.assign(view.data(), view.size());
+                }
+            }
+            template<typename T>
+            void field(std::vector<T>& v){
+                uint32_t count = 0;
+                field(count);
+                // 每个元素至少1字节，防止错误的长度导致分配大量内存
+                if(!ok_ || count > static_cast<size_t>(end_ - cur_)){
+                    ok_ = false;
+                    return;
+                }
+                v.resize(count);
+                for(uint32_t i = 0; i < count && ok_; ++i){
+                    field(v[i]);
+                }
+            }
+            template<typename T>
+            void field(T& msg){ msg.schema(*this); }
+
+        private:
+            void readRaw(void* dst, size_t len){
+                if(!ok_ || static_cast<size_t>(end_ - cur_) < len){
+                    ok_ = false;
+                    return;
+                }
+                memcpy(dst, cur_, len);
+                cur_ += len;
+            }
+
+            const char* cur_;
+            const char* end_;
+            bool ok_;
+    };
+
+    template<typename T>
+    void encode(const T& msg, Buffer* buff){
+        Writer writer(buff);
+        writer.field(msg);
+    }
+
+    // 数据必须正好是一条完整的消息
+    template<typename T>
+    bool decode(const StringPiece& data, T* msg){
+        Reader reader(data);
+        reader.field(*msg);
+        return reader.done();
+    }
+}
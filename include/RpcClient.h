@@ -0,0 +1,82 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpClient.h"
+#include "LengthHeaderCodec.h"
+#include "Rpc.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <string>
+#include <atomic>
+#include <unordered_map>
+
+class EventLoop;
+
+/**
+ * RPC客户端，所有调用共用一条连接，请求按id匹配响应，发出去的请求不需要等响应就可以继续发
+ * 同一轮事件处理中发起的调用合并成一次发送
+ * 每个调用的回调在loop线程中正好执行一次：收到响应、超时、被取消或者连接断开
+ * 和UpstreamPool一样，一个loop使用自己的RpcClient，subloop中转发给下一跳的调用不需要跨线程
+ * RpcClient需要在loop线程中析构，析构之后loop不能再运行（定时器和排队的回调持有this）
+ * 析构时还没有完成的调用以kConnectionClosed回调，这些回调中不能再使用这个RpcClient
+ */
+class RpcClient : noncopyable{
+    public:
+        // response指向连接的inputBuffer_，只在回调中有效；status不是kOk时response是服务端返回的错误信息，可能为空
+        using ResponseCallback = std::function<void(int status, const StringPiece& response)>;
+
+        RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name);
+        ~RpcClient();
+
+        void connect(){ client_.connect(); }
+        void disconnect(){ client_.disconnect(); }
+        // 连接断开以后自动重连，需要在connect之前设置
+        void enableRetry(){ client_.enableRetry(); }
+        EventLoop* getLoop() const { return loop_; }
+
+        // 可以在任意线程调用，返回调用的id，用于cancel
+        // timeout秒以后还没有收到响应时回调kDeadlineExceeded，0表示不限制；超时时间随请求发给服务端，服务端据此取消异步处理
+        // 还没有连接上时请求先缓存，连接建立以后发送
+        uint64_t call(const StringPiece& method, const StringPiece& request, double timeout, const ResponseCallback& cb);
+        // 按消息的schema编码请求
+        template<typename T>
+        uint64_t callMessage(const StringPiece& method, const T& request, double timeout, const ResponseCallback& cb){
+            Buffer buff;
+            Rpc::encode(request, &buff);
+            return call(method, StringPiece(buff.peek(), buff.readableBytes()), timeout, cb);
+        }
+        // 可以在任意线程调用，还没有完成的调用以kCancelled回调，同时通知服务端取消
+        void cancel(uint64_t id);
+
+        // 还没有完成的调用数，只能在loop线程中调用
+        size_t pendingCalls() const { return pending_.size(); }
+
+    private:
+        struct PendingCall{
+            ResponseCallback cb;
+            TimerId timer;
+            bool hasTimer;
+        };
+
+        void callInLoop(uint64_t id, const std::string& frame, double timeout, const ResponseCallback& cb);
+        void addPending(uint64_t id, double timeout, const ResponseCallback& cb);
+        void scheduleFlush();
+        void flush();
+        // 从pending_中取出一个调用，取消它的定时器，找不到时返回false
+        bool takePending(uint64_t id, ResponseCallback* cb);
+        void cancelInLoop(uint64_t id, int status);
+
+        void onConnection(const TcpConnectionPtr& conn);
+        void onFrames(const TcpConnectionPtr& conn, const StringPiece* frames, int count, Timestamp receiveTime);
+
+        EventLoop* loop_;
+        TcpClient client_;
+        LengthHeaderCodec codec_;
+        std::atomic<uint64_t> nextId_;
+        // 以下只在loop线程中访问
+        TcpConnectionPtr conn_;
+        Buffer output_;                                         // 等待发送的请求
+        bool flushQueued_;
+        std::unordered_map<uint64_t, PendingCall> pending_;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "TcpServer.h"
+#include "LengthHeaderCodec.h"
+#include "Rpc.h"
+#include "TimerId.h"
+#include "Timestamp.h"
+
+#include <functional>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
+
+/**
+ * 异步处理中的一个RPC调用，处理完以后调用reply返回响应
+ * reply可以在任意线程调用，只有第一次有效；调用被取消以后reply直接丢弃
+ */
+class RpcCall : noncopyable, public std::enable_shared_from_this<RpcCall>{
+    public:
+        RpcCall(const TcpConnectionPtr& conn, uint64_t id, Timestamp deadline);
+
+        uint64_t id() const { return id_; }
+        // 客户端设置的截止时间，没有设置时无效
+        Timestamp deadline() const { return deadline_; }
+        // 离截止时间还有多少秒，调用下一跳时作为超时时间传下去；没有截止时间时返回0，已经过了截止时间时返回一个很小的正数
+        double remainingSeconds() const;
+
+        // 客户端取消、超过截止时间或者连接断开
+        bool cancelled() const { return cancelled_; }
+        // 调用被取消时在连接所在的loop线程中执行，比如取消转发给下一跳的调用，只能在loop线程中设置
+        void setCancelCallback(const std::function<void()>& cb);
+
+        void reply(const StringPiece& response, int status = Rpc::kOk);
+        void fail(int status){ reply(StringPiece(), status); }
+        // 按消息的schema直接编码到响应帧中
+        template<typename T>
+        void replyMessage(const T& msg){
+            if(finished_.exchange(true)){
+                return;
+            }
+            Buffer frame;
+            size_t frameStart = Rpc::beginFrame(&frame, Rpc::kResponse, id_);
+            frame.appendInt8(Rpc::kOk);
+            Rpc::encode(msg, &frame);
+            Rpc::endFrame(&frame, frameStart);
+            sendReply(&frame);
+        }
+
+    private:
+        friend class RpcServer;
+
+        void sendReply(Buffer* frame);
+        void finishInLoop();
+        void cancelInLoop();
+        // 定时器只持有弱引用，已经回复的调用不因为定时器延长生命周期
+        static void onDeadline(const std::weak_ptr<RpcCall>& weakCall);
+
+        std::weak_ptr<TcpConnection> conn_;
+        EventLoop* loop_;
+        const uint64_t id_;
+        const Timestamp deadline_;
+        std::atomic<bool> finished_;        // 已经回复或者已经取消
+        std::atomic<bool> cancelled_;
+        // 以下只在loop线程中访问
+        TimerId timer_;
+        bool hasTimer_;
+        std::function<void()> cancelCallback_;
+};
+
+using RpcCallPtr = std::shared_ptr<RpcCall>;
+
+/**
+ * RPC服务端，一条连接上的多个请求按id区分，可以同时处理，响应不需要按顺序返回
+ * 同步的方法在连接所在的subloop中执行，返回以后立即回复；一次收到的多个请求的响应合并成一次发送
+ * 异步的方法拿到RpcCall以后可以交给其它线程处理，处理完调用reply
+ * 请求中带了超时时间的异步调用，到截止时间还没有回复时自动取消
+ */
+class RpcServer : noncopyable{
+    public:
+        // request指向连接的inputBuffer_，只在回调中有效；把响应消息追加到response中，只能追加
+        // 返回kOk以外的状态码时丢弃已经写入response的数据，只回复状态码
+        using SyncHandler = std::function<int(const StringPiece& request, Buffer* response)>;
+        // request只在回调中有效，需要的数据先解码或者拷贝出来
+        using AsyncHandler = std::function<void(const StringPiece& request, const RpcCallPtr& call)>;
+
+        RpcServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, TcpServer::Option option = TcpServer::kNoReusePort);
+
+        TcpServer* tcpServer() { return &server_; }
+
+        // 需要在start之前注册，方法名最长255字节
+        void registerMethod(const std::string& method, const SyncHandler& handler);
+        void registerAsyncMethod(const std::string& method, const AsyncHandler& handler);
+
+        void setThreadNum(int numThreads){ server_.setThreadNum(numThreads); }
+        void start();
+
+    private:
+        struct Method{
+            SyncHandler sync;
+            AsyncHandler async;
+        };
+
+        void onConnection(const TcpConnectionPtr& conn);
+        void onFrames(const TcpConnectionPtr& conn, const StringPiece* frames, int count, Timestamp receiveTime);
+        // 返回false表示帧格式错误
+        bool handleRequest(const TcpConnectionPtr& conn, Rpc::Reader& reader, uint64_t id, Buffer* output, Timestamp receiveTime);
+
+        TcpServer server_;
+        LengthHeaderCodec codec_;
+        std::unordered_map<std::string, Method> methods_;   // start以后只读，多个loop线程同时查找不需要加锁
+};
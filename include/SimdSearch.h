@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+// 在[begin, end)中查找pattern第一次出现的位置，没有找到返回nullptr
+// x86上使用SSE2/AVX2一次比较16/32个字节，第一次调用时根据CPU选择实现，其它平台使用标量实现
+namespace SimdSearch{
+    const char* find(const char* begin, const char* end, const char* pattern, size_t len);
+
+    // 当前使用的实现："avx2"、"sse2"或者"scalar"
+    const char* implementation();
+
+    // 指定实现，用于测试和性能对比，CPU不支持时返回nullptr
+    using SearchFunc = const char* (*)(const char*, const char*, const char*, size_t);
+    SearchFunc findImpl(const char* name);
+}
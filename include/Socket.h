@@ -1,5 +1,8 @@
 #include "noncopyable.h"
 
+#include <stdint.h>
+#include <stddef.h>
+
 struct tcp_info;
 
 class InetAddress;
@@ -22,6 +25,12 @@ class Socket : noncopyable{
         void setReuseAddr(bool on);
         void setReusePort(bool on);
         void setKeepAlive(bool on);
+        bool setMaxPacingRate(uint64_t bytesPerSecond);   // 内核发送限速，需要fq队列规则或者TCP内部pacing支持
+        bool setZeroCopy(bool on);                        // 开启SO_ZEROCOPY，之后才能使用MSG_ZEROCOPY发送
+        bool setNotSentLowat(uint32_t bytes);             // 内核发送缓冲区中未发送的数据低于bytes时才通知可写
+        bool getNotSentBytes(size_t* bytes);              // 内核发送缓冲区中还没发送出去的字节数
+        bool setRecvBufferSize(int bytes);                // SO_RCVBUF，UDP突发流量时内核能缓存的数据报更多
+        bool setSendBufferSize(int bytes);                // SO_SNDBUF
 
     private:
         const int sockfd_;  // 这就是服务器用于监听客户端的listenfd
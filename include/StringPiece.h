@@ -0,0 +1,110 @@
+#pragma once
+
+#include <string>
+#include <string.h>
+#include <algorithm>
+
+// 不拥有内存的字符串片段，C++11没有std::string_view
+// 只保存指针和长度，原来的内存（比如Buffer的可读区间）被修改或者释放以后就失效了
+class StringPiece{
+    public:
+        static const size_t npos = static_cast<size_t>(-1);
+
+        StringPiece()
+            : ptr_(nullptr)
+            , length_(0)
+        {}
+        StringPiece(const char* str)
+            : ptr_(str)
+            , length_(strlen(str))
+        {}
+        StringPiece(const std::string& str)
+            : ptr_(str.data())
+            , length_(str.size())
+        {}
+        StringPiece(const char* offset, size_t len)
+            : ptr_(offset)
+            , length_(len)
+        {}
+
+        const char* data() const { return ptr_; }
+        size_t size() const { return length_; }
+        bool empty() const { return length_ == 0; }
+        const char* begin() const { return ptr_; }
+        const char* end() const { return ptr_ + length_; }
+        char operator[](size_t i) const { return ptr_[i]; }
+
+        void clear(){
+            ptr_ = nullptr;
+            length_ = 0;
+        }
+        void set(const char* buffer, size_t len){
+            ptr_ = buffer;
+            length_ = len;
+        }
+
+        // 去掉开头、结尾的n个字节，n不能超过size()
+        void remove_prefix(size_t n){
+            ptr_ += n;
+            length_ -= n;
+        }
+        void remove_suffix(size_t n){
+            length_ -= n;
+        }
+
+        StringPiece substr(size_t pos, size_t n = npos) const{
+            pos = std::min(pos, length_);
+            return StringPiece(ptr_ + pos, std::min(n, length_ - pos));
+        }
+
+        // 返回第一次出现的位置，没有找到返回npos
+        size_t find(char c, size_t pos = 0) const{
+            if(pos >= length_){
+                return npos;
+            }
+            const void* found = memchr(ptr_ + pos, c, length_ - pos);
+            return found == nullptr ? npos : static_cast<const char*>(found) - ptr_;
+        }
+        size_t find(const StringPiece& s, size_t pos = 0) const{
+            if(pos > length_){
+                return npos;
+            }
+            const char* found = std::search(ptr_ + pos, ptr_ + length_, s.ptr_, s.ptr_ + s.length_);
+            return found == ptr_ + length_ && s.length_ > 0 ? npos : found - ptr_;
+        }
+
+        bool starts_with(const StringPiece& x) const{
+            return length_ >= x.length_ && memcmp(ptr_, x.ptr_, x.length_) == 0;
+        }
+
+        int compare(const StringPiece& x) const{
+            int r = memcmp(ptr_, x.ptr_, std::min(length_, x.length_));
+            if(r == 0){
+                if(length_ < x.length_){
+                    r = -1;
+                }else if(length_ > x.length_){
+                    r = 1;
+                }
+            }
+            return r;
+        }
+
+        bool operator==(const StringPiece& x) const{
+            return length_ == x.length_ && memcmp(ptr_, x.ptr_, length_) == 0;
+        }
+        bool operator!=(const StringPiece& x) const{
+            return !(*this == x);
+        }
+        bool operator<(const StringPiece& x) const{
+            return compare(x) < 0;
+        }
+
+        // 需要保存数据时再拷贝成std::string
+        std::string as_string() const{
+            return std::string(ptr_, length_);
+        }
+
+    private:
+        const char* ptr_;
+        size_t length_;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "Connector.h"
+#include "TcpConnection.h"
+
+#include <string>
+#include <mutex>
+
+class EventLoop;
+
+/**
+ * TCP客户端，通过Connector主动连接服务器，连接建立后和TcpServer一样使用TcpConnection收发数据
+ * 一个TcpClient同时只管理一条连接，开启retry后连接断开会自动重连
+ */
+class TcpClient : noncopyable{
+    public:
+        TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+        ~TcpClient();
+
+        void connect();
+        void disconnect();  // 等outputBuffer_中的数据发送完后关闭写端
+        void stop();        // 停止正在进行的连接
+
+        TcpConnectionPtr connection() const{
+            std::unique_lock<std::mutex> lock(mutex_);
+            return connection_;
+        }
+
+        EventLoop* getLoop() const { return loop_; }
+        const std::string& name() const { return name_; }
+        bool retry() const { return retry_; }
+        void enableRetry(){ retry_ = true; }
+
+        // 非线程安全，需要在connect之前设置
+        void setConnectionCallback(const ConnectionCallback& cb){ connectionCallback_ = cb; }
+        void setMessageCallback(const MessageCallback& cb){ messageCallback_ = cb; }
+        void setWriteCompleteCallback(const WriteCompleteCallback& cb){ writeCompleteCallback_ = cb; }
+        // 连接失败、不再重试时回调，默认一直重试，见Connector::setMaxRetries
+        void setConnectFailedCallback(const Connector::ConnectFailedCallback& cb){ connector_->setConnectFailedCallback(cb); }
+        void setMaxConnectRetries(int maxRetries){ connector_->setMaxRetries(maxRetries); }
+
+    private:
+        // Connector连接成功后在loop_线程中调用
+        void newConnection(int sockfd);
+        // 连接断开后在loop_线程中调用
+        void removeConnection(const TcpConnectionPtr& conn);
+
+        EventLoop* loop_;
+        ConnectorPtr connector_;
+        const std::string name_;
+        ConnectionCallback connectionCallback_;
+        MessageCallback messageCallback_;
+        WriteCompleteCallback writeCompleteCallback_;
+        bool retry_;
+        bool connect_;
+        int nextConnId_;                                   // 只在loop_线程中访问
+        mutable std::mutex mutex_;                         // 保护connection_
+        TcpConnectionPtr connection_;
+};
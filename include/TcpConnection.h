@@ -6,13 +6,38 @@
 #include "Buffer.h"
 #include "Timestamp.h"
 #include "EventLoop.h"
+#include "Payload.h"
 
 #include <memory>
 #include <atomic>
+#include <deque>
+#include <vector>
+#include <sys/types.h>
 #include <string.h>
+#include <stdint.h>
 
 class Channel;
 class Socket;
+class MemoryBudget;
+class TokenBucket;
+
+// sendv的一个数据片段
+// 指定payload时持有引用，没有发送完的部分不拷贝；否则data只需要在sendv调用期间有效，没有发送完的部分会被拷贝
+struct SendSegment{
+    SendSegment(const char* d, size_t len)
+        : data(d), length(len)
+    {}
+    SendSegment(const std::string& s)
+        : data(s.data()), length(s.size())
+    {}
+    SendSegment(const PayloadPtr& p)
+        : data(p->data()), length(p->size()), payload(p)
+    {}
+
+    const char* data;
+    size_t length;
+    PayloadPtr payload;
+};
 
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>{
     public:
@@ -30,8 +55,15 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
         bool connected() const {return state_ == kConnected; }
         bool disconnected() const {return state_ == kDisconnected; }
 
+        // 连接上保存的用户数据，比如协议的解析状态，C++11没有std::any，用shared_ptr<void>保存任意类型
+        // 只在连接所在的loop线程中访问
+        void setContext(const std::shared_ptr<void>& context) { context_ = context; }
+        const std::shared_ptr<void>& getContext() const { return context_; }
+
         void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
         void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
+        // 设置后收到的数据交给cb，不再放入inputBuffer_调用messageCallback_
+        void setZeroCopyReadCallback(const ZeroCopyReadCallback& cb) { zeroCopyReadCallback_ = cb; }
         void setWriteCompleteCallback_(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
         void setCloseCallback(const CloseCallback& cb) { closeCallback_ = cb; }
         void setHighWaterMarkCallback_(const HighWaterMarkCallback& cb, size_t highWaterMark) { 
@@ -39,8 +71,120 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
             highWaterMark_ = highWaterMark;
         }
 
+        // 开启内置的流量控制：outputBuffer_积压超过highWaterMark时暂停读，降到lowWaterMark以下时恢复读
+        // 需要在connectEstablished之前设置（TcpServer::newConnection中设置）
+        void setWaterMarks(size_t lowWaterMark, size_t highWaterMark){
+            lowWaterMark_ = lowWaterMark;
+            highWaterMark_ = highWaterMark;
+            flowControl_ = true;
+        }
+        size_t lowWaterMark() const { return lowWaterMark_; }
+        size_t highWaterMark() const { return highWaterMark_; }
+
+        // 关联对端连接（比如代理中的客户端连接和上游连接），任意一方的outputBuffer_超过高水位，都会暂停另一方的读
+        // 关联是双向的，两条连接可以在不同的subloop中；一方关闭时，另一方发送完已经转发给它的数据后关闭写端
+        void linkPeer(const TcpConnectionPtr& peer);
+        void unlinkPeer();
+
+        // 从这条连接收到的数据用splice经过管道直接转发给peer，数据不进入用户态的Buffer，两边各调用一次就是双向转发
+        // 开启后不再回调messageCallback_，inputBuffer_中还没取走的数据先发送给peer，管道的数据排在peer已有的待发送数据后面
+        // peer发送拥塞（管道中的数据写不出去）时暂停本连接的读，peer把管道写空后恢复；本连接读到EOF后，管道写空了才关闭，同时关闭peer的写端
+        // 转发一直持续到有一方关闭；peer先关闭时管道中没发出去的数据被丢弃，之后收到的数据重新交给messageCallback_
+        // 需要检查、修改数据的协议不要开启，继续在messageCallback_中拷贝转发
+        // 只能在loop线程中调用，peer必须属于同一个loop（比如UpstreamPool按loop分配的上游连接）
+        // pipeSize为0时使用系统默认的管道大小，创建管道失败、peer不在同一个loop、已经开启过时返回false
+        bool startSplice(const TcpConnectionPtr& peer, size_t pipeSize = 0);
+        bool splicing() const { return spliceOut_ != nullptr; }
+        // 通过splice读到管道中的字节数
+        uint64_t splicedBytes() const { return splicedBytes_; }
+
+        // 用户主动暂停、恢复读，和流量控制导致的暂停相互独立，只有所有暂停原因都解除了才会重新读
+        void startRead();
+        void stopRead();
+        bool isReading() const { return reading_; }
+
+        // 流量控制导致的暂停读、恢复读的次数
+        uint64_t readPauseCount() const { return readPauseCount_; }
+        uint64_t readResumeCount() const { return readResumeCount_; }
+
+        // 设置服务器级别的内存预算，需要在connectEstablished之前设置（TcpServer::newConnection中设置）
+        void setMemoryBudget(const std::shared_ptr<MemoryBudget>& budget);
+        // 内存预算降到恢复线以下时，由MemoryBudget在任意线程调用
+        void resumeReadingByBudget();
+
+        // 发送、接收限速，单位字节/秒，bytesPerSecond为0表示取消限速
+        // 限速通过loop的定时器实现，令牌不够时暂停关注读写事件，不会阻塞loop上的其他连接
+        // 需要在loop线程中调用，或者在connectEstablished之前调用（TcpServer::newConnection中设置）
+        void setSendRateLimit(double bytesPerSecond, double burst = 0.0);
+        void setRecvRateLimit(double bytesPerSecond, double burst = 0.0);
+        // 多条连接共享的令牌桶，用于TcpServer级别的限速，可以为空
+        void setSharedRateLimiters(const std::shared_ptr<TokenBucket>& sendLimiter, const std::shared_ptr<TokenBucket>& recvLimiter);
+        // 使用内核的SO_MAX_PACING_RATE进行发送限速，内核不支持时返回false
+        bool setKernelPacingRate(double bytesPerSecond);
+
+        // 开启MSG_ZEROCOPY发送，threshold为0表示关闭，内核不支持SO_ZEROCOPY时返回false
+        // 需要在loop线程中调用，或者在connectEstablished之前调用（TcpServer::newConnection中设置）
+        bool setZeroCopyThreshold(size_t threshold);
+        size_t zeroCopyThreshold() const { return zeroCopyThreshold_; }
+        // 开启TCP_NOTSENT_LOWAT，内核中还没发送的数据不超过bytes，其余的数据留在outputBuffer_中，应用还可以调整、丢弃
+        // 内核需要更多数据时才通过EPOLLOUT通知，writeCompleteCallback_回调时数据都交给了内核，内核中积压的不超过bytes
+        // 0表示关闭，需要在loop线程中调用，或者在connectEstablished之前调用
+        bool setNotSentLowWaterMark(size_t bytes);
+        size_t notSentLowWaterMark() const { return notSentLowWaterMark_; }
+        // 还没有交给内核的发送数据，只能在loop线程中访问，第一条消息可能已经发送了一部分
+        Buffer* outputBuffer() { return &outputBuffer_; }
+
+        // 自动合并发送：开启后send不直接写socket，同一轮事件循环中的多次send在loop处理完事件后合并成一次write
+        // 适合一次请求调用多次send、或者流水线请求的小响应，需要在loop线程中调用，或者在connectEstablished之前调用
+        void setAutoCork(bool on);
+        bool autoCork() const { return autoCork_; }
+
+        // 使用MSG_ZEROCOPY发送的次数，以及其中内核实际上还是拷贝了的次数（比如回环网卡）
+        uint64_t zeroCopySends() const { return zeroCopySends_; }
+        uint64_t zeroCopyCopied() const { return zeroCopyCopied_; }
+
+        // 映射regionSize大小的接收区，用TCP_ZEROCOPY_RECEIVE把整页的数据直接映射到用户空间，不是整页的部分还是用readv读取
+        // 需要配合setZeroCopyReadCallback使用，映射失败返回false，这时候数据仍然通过拷贝交给ZeroCopyReadCallback
+        // 需要在loop线程中调用，或者在connectEstablished之前调用（TcpServer::newConnection中设置）
+        bool enableZeroCopyReceive(size_t regionSize);
+        bool zeroCopyReceiveEnabled() const { return zeroCopyRegion_ != nullptr; }
+        // 通过映射收到的字节数
+        uint64_t zeroCopyReceivedBytes() const { return zeroCopyReceivedBytes_; }
+
+        // 可以在任意线程调用，其他线程调用时数据会被拷贝（或者移动）到loop线程中发送
         void send(const std::string& buff);
+        void send(std::string&& buff);
+        // 发送buff中的全部数据并清空buff，outputBuffer_为空时直接交换内存，不拷贝数据
+        void send(Buffer* buff);
+        // 只持有payload的引用，不拷贝，同一个payload可以发送给多条连接
+        void send(const PayloadPtr& payload);
+        // 流式发送：缓冲的数据少于kStreamLowWaterMark时调用producer要下一段数据，内存占用和数据总长度无关
+        // producer暂时没有数据时可以不追加数据并返回true，有数据以后调用resumeStream
+        // 数据发送完之前连接关闭则调用onCancel，producer和onCancel都在loop线程中调用
+        void sendStream(const StreamProducer& producer, const ReleaseCallback& onCancel = ReleaseCallback());
+        void resumeStream();
+
+        // 按优先级发送一条消息，priority越大越先发送，0和send相同，最大为kMaxPriority
+        // 高优先级的消息只会插在普通数据的消息边界上（每次send、sendv、sendFile等调用是一条消息），不会打断正在发送的消息
+        void sendWithPriority(const std::string& message, int priority);
+        static const int kMaxPriority = 3;
+        // 各个优先级队列中排队的消息数和字节数，可以在任意线程调用，priority为0时是普通数据积压在内存中的字节数
+        size_t priorityQueueDepth(int priority) const { return priorityDepth_[priority]; }
+        size_t priorityQueueBytes(int priority) const { return priorityBytesByClass_[priority]; }
+
+        // 按顺序发送多个数据片段，比如协议头和消息体，不需要先拼接成一个字符串
+        // 没有排队的数据时直接writev，只有没发送完的部分才放入发送队列
+        void sendv(const std::vector<SendSegment>& segments);
+        // 发送文件fd从offset开始的length个字节，排在已经缓冲的数据后面，用sendfile发送，数据不经过用户态
+        // fd由调用者管理，writeCompleteCallback_回调之前不能关闭
+        void sendFile(int fd, off_t offset, size_t length);
+        // 发送用户持有的内存，release回调之前data不能修改、释放，release在loop线程中调用
+        // 开启了零拷贝并且len不小于阈值时，用MSG_ZEROCOPY发送，内核通知发送完成后才release
+        // 否则拷贝到outputBuffer_后立即release
+        void sendPinned(const void* data, size_t len, const ReleaseCallback& release);
         void shutdown();
+        // 不等待outputBuffer_中的数据发送完，直接关闭连接
+        void forceClose();
 
         // 建立连接
         void connectEstablished();
@@ -54,14 +198,112 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
         void setState(StateE state){
             state_ = state;
         }
-        
+
+        // 暂停读的原因，用位表示，多个原因可以同时存在
+        enum ReadPauseReason{
+            kPauseByUser = 1,        // 用户调用stopRead
+            kPauseBySelf = 2,        // 自己的outputBuffer_超过高水位
+            kPauseByPeer = 4,        // 关联的对端outputBuffer_超过高水位
+            kPauseByBudget = 8,      // 服务器的内存预算超限
+            kPauseByRate = 16,       // 接收限速，令牌不够
+            kPauseBySplice = 32,     // splice转发的对端拥塞，管道中还有数据
+        };
+        void pauseReadingInLoop(int reason);
+        void resumeReadingInLoop(int reason);
+        void setPeerInLoop(const std::weak_ptr<TcpConnection>& peer);
+        void unlinkPeerInLoop();
+
+        static const size_t kShrinkThreshold = 64 * 1024;  // inputBuffer_取空、outputBuffer_发送完后，容量超过这个值就释放内存
+        static const size_t kPayloadCopyThreshold = 4096;  // 小于这个长度的Payload直接拷贝，和前后的数据合并成一次write
+        static const int kMaxIovecs = 64;                  // sendv一次writev最多的片段数
+        static const size_t kStreamLowWaterMark = 64 * 1024;  // 流式发送缓冲的数据少于这个值时向生产者要数据
+        void notifyPeerWaterMark(bool above);
+        // outputBuffer_积压的数据变化后调用，检查水位线，更新内存预算
+        void onOutputChanged();
+        // 检查是否越过了高/低水位
+        void checkWaterMarks();
+        // 把inputBuffer_和outputBuffer_占用的内存、其他排队的数据计入内存预算，超过预算时按照预算的策略处理
+        void updateMemoryUsage();
+        void forceCloseInLoop();
+
+        // 令牌桶允许发送的字节数，没有限速时返回SIZE_MAX
+        size_t sendQuota();
+        // 本次可以写入内核的字节数，在sendQuota的基础上还受TCP_NOTSENT_LOWAT的限制
+        size_t writeQuota();
+        // 内核中未发送的数据距离TCP_NOTSENT_LOWAT还有多少字节，没有开启时返回SIZE_MAX
+        size_t notSentRoom();
+        void consumeSendQuota(size_t bytes);
+        // 开始关注写事件，令牌不够时改为等待定时器
+        void startWriting();
+        // 令牌不够，暂停写，定时器到期后resumeWriting
+        void throttleWriting();
+        void resumeWriting();
+        // 接收的数据扣除令牌，令牌不够时暂停读，定时器到期后恢复
+        void chargeRecvQuota(size_t bytes);
+
+        static const size_t kRateLimitQuantum = 4096;  // 限速时至少攒够这么多令牌再发送、接收，避免定时器过于频繁        
         void handleRead(Timestamp receiveTime);
+        // 设置了zeroCopyReadCallback_时的读事件处理
+        void handleZeroCopyRead(Timestamp receiveTime);
+        // 开启了splice转发时的读事件处理
+        void handleSpliceRead();
+        // 对端往管道中放了数据，尽快发送
+        void flushSpliceInput();
+        // 发送对端管道中的数据，最多发送maxBytes个字节，管道写空以后通知对端
+        ssize_t writeSpliceInput(size_t maxBytes, int* saveErrno);
+        // splice转发的对端关闭了，丢弃管道，恢复用messageCallback_处理收到的数据
+        void stopSpliceOut();
+        void releaseZeroCopyRegion();
         void handleWrite();
+        // 发送一次待发送的数据，全部发送完后取消关注写事件，回调writeCompleteCallback_
+        ssize_t writeOutput(int* saveErrno);
+        void flushCorkedOutput();
+        // 没有排队的数据、没有在等待写事件和限速定时器时，send可以直接写socket
+        bool canWriteDirectly() const;
         void handleClose();
         void handleError();
 
-        // 发送数据
-        void sendInLoop(const void* data, size_t len);
+        struct OutputChunk;
+        // 发送数据，owner不为空时data就是owner的可读数据，需要排队时直接交换owner和outputBuffer_
+        void sendInLoop(const void* data, size_t len, Buffer* owner = nullptr);
+        void sendStringInLoop(const std::string& buff);
+        void sendBufferInLoop(const std::shared_ptr<Buffer>& buff);
+        void sendPayloadInLoop(const PayloadPtr& payload);
+        void sendvInLoop(const std::vector<SendSegment>& segments);
+        // 把不属于连接的内存块（用户内存、Payload）放入发送队列，前面没有待发送的数据时直接发送
+        void queueMemoryChunk(OutputChunk&& chunk);
+        void sendFileInLoop(int fd, off_t offset, size_t length);
+        void sendPinnedInLoop(const void* data, size_t len, const ReleaseCallback& release);
+        void sendWithPriorityInLoop(const std::string& message, int priority);
+        void sendStreamInLoop(const StreamProducer& producer, const ReleaseCallback& onCancel);
+        void resumeStreamInLoop();
+        // 发送队首的流，缓冲的数据不够时先向生产者要数据
+        ssize_t writeStreamChunk(size_t maxBytes, int* saveErrno);
+        void cancelStreams();
+        // 开始一条len字节的普通消息之前调用，前面还有没发送完的普通数据时记录消息边界
+        void markMessageBoundary(size_t len);
+        // 已经发送的普通数据是否刚好在消息边界上，这时候才能插入高优先级的消息
+        bool atMessageBoundary();
+        void popSentBoundaries();
+        // 应用通过outputBuffer()丢弃的数据没有经过normalSent_，按队列中实际剩下的普通数据重新计算已经发送的字节数
+        void resyncNormalSent();
+        // 发送优先级最高的队列中的消息，最多发送maxBytes个字节
+        ssize_t writePriority(size_t maxBytes, int* saveErrno);
+        // 把数据追加到待发送队列的末尾，队列中有数据块时追加到最后一个数据块，保证发送顺序
+        void appendOutput(const char* data, size_t len);
+        // outputBuffer_和后面排队的数据块中积压的内存字节数，不包括文件
+        size_t queuedOutputBytes() const;
+        // 是否还有没发送完的数据
+        bool hasPendingOutput() const { return hasPendingNormalOutput() || priorityBytes_ > 0 || (spliceIn_ && spliceIn_->bytes > 0); }
+        bool hasPendingNormalOutput() const { return outputBuffer_.readableBytes() > 0 || !outputChunks_.empty(); }
+        // outputBuffer_发送完后，把后面排队的内存数据块换到outputBuffer_
+        void promoteOutputChunk();
+        // 发送队首的文件块，最多发送maxBytes个字节
+        ssize_t sendFileChunk(size_t maxBytes, int* saveErrno);
+        // 用MSG_ZEROCOPY发送队首的用户内存块，最多发送maxBytes个字节
+        ssize_t sendPinnedChunk(size_t maxBytes, int* saveErrno);
+        // 从socket的错误队列读取零拷贝发送完成的通知，release已经完成的内存块
+        void handleZeroCopyCompletion();
         // 客户端断开，或者有其他特殊情况，关闭当前TcpConnection
         void shutdownInLoop();
 
@@ -75,14 +317,100 @@ class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnec
 
         const InetAddress localAddr_;                      // 主机地址，这是定义变量，编译阶段需要知道变量占用空间，要包含头文件
         const InetAddress peerAddr_;                       // 客户端地址
+        std::shared_ptr<void> context_;                    // 用户保存在连接上的数据
 
         ConnectionCallback connectionCallback_;            // 有新连接和关闭连接的回调处理函数，就是用户传入的on_connection
         MessageCallback messageCallback_;                  // 已连接用户的读写消息回调处理函数，就是用户传入的on_message
+        ZeroCopyReadCallback zeroCopyReadCallback_;        // 零拷贝接收的消息回调
         WriteCompleteCallback writeCompleteCallback_;      // 消息发送完成的回调处理函数
         CloseCallback closeCallback_;
         HighWaterMarkCallback highWaterMarkCallback_;      // 控制双方发送、接收速度
         size_t highWaterMark_;                             // 水位线
+        size_t lowWaterMark_;                              // 低水位线，流量控制时降到这里以下恢复读
+        bool flowControl_;                                 // 是否开启内置的流量控制
+        bool aboveHighWaterMark_;                          // outputBuffer_当前是否处于高水位之上
+        int readPauseReasons_;                             // ReadPauseReason的组合，为0时才真正读
+        std::weak_ptr<TcpConnection> peer_;                // 关联的对端连接，只在loop_线程访问
+        std::atomic<uint64_t> readPauseCount_;
+        std::atomic<uint64_t> readResumeCount_;
+
+        std::shared_ptr<MemoryBudget> budget_;             // 服务器级别的内存预算，可以为空
+        size_t budgetCharged_;                             // 当前计入内存预算的字节数
+
+        std::unique_ptr<TokenBucket> sendLimiter_;         // 连接自己的发送限速
+        std::unique_ptr<TokenBucket> recvLimiter_;         // 连接自己的接收限速
+        std::shared_ptr<TokenBucket> sharedSendLimiter_;   // TcpServer所有连接共享的发送限速
+        std::shared_ptr<TokenBucket> sharedRecvLimiter_;   // TcpServer所有连接共享的接收限速
+        bool sendThrottled_;                               // 是否因为发送限速在等待定时器
+
+        // 排在outputBuffer_后面的待发送数据块，按顺序发送
+        struct OutputChunk{
+            enum Type{ kBuffer, kFile, kPinned, kStream };
+            explicit OutputChunk(Type t)
+                : type(t), fd(-1), offset(0), remaining(0), data(nullptr), zeroCopy(false), zeroCopied(false), lastSeq(0), streamDone(false)
+            {}
+            Type type;
+            Buffer buffer;                                 // kBuffer：文件块后面追加的数据；kStream：生产者产生的还没发送的数据
+            int fd;                                        // kFile：文件描述符、当前偏移
+            off_t offset;
+            size_t remaining;                              // kFile、kPinned：剩余字节数
+            const char* data;                              // kPinned：用户内存中下一个要发送的位置
+            ReleaseCallback release;                       // kPinned：内核不再引用用户内存后调用；kStream：流被取消时调用
+            PayloadPtr payload;                            // kPinned：发送Payload时持有引用，data指向payload的数据
+            bool zeroCopy;                                 // kPinned：是否使用MSG_ZEROCOPY发送
+            bool zeroCopied;                               // kPinned：是否有数据用MSG_ZEROCOPY发送了
+            uint32_t lastSeq;                              // kPinned：最后一次MSG_ZEROCOPY发送的序号
+            StreamProducer producer;                       // kStream：数据生产者
+            bool streamDone;                               // kStream：生产者是否已经结束
+        };
+
+        // splice转发用的管道，由读数据的一方（source）和发送数据的一方共同持有，source先关闭时管道中的数据还能发送完
+        struct SplicePipe{
+            SplicePipe(int r, int w, size_t cap)
+                : readFd(r), writeFd(w), capacity(cap), bytes(0), sourcePaused(false), eof(false)
+            {}
+            ~SplicePipe();
+            const int readFd;
+            const int writeFd;
+            const size_t capacity;
+            size_t bytes;                                  // 管道中还没发送的字节数
+            bool sourcePaused;                             // source是否因为管道中有数据暂停了读
+            bool eof;                                      // source是否已经读到了EOF
+            std::weak_ptr<TcpConnection> source;
+        };
 
         Buffer inputBuffer_;                               // 用于服务器接收数据，handleRead就是写入inputBuffer_
         Buffer outputBuffer_;                              // 用于服务器发送数据，应用层需要发送的数据先存到outputBuffer_
+        std::deque<OutputChunk> outputChunks_;             // outputBuffer_发送完后再发送的数据块
+
+        size_t zeroCopyThreshold_;                         // 不小于这个长度的sendPinned使用MSG_ZEROCOPY，0表示关闭
+        uint32_t zeroCopyNextSeq_;                         // 内核给每次MSG_ZEROCOPY发送分配的序号，从0开始递增
+        uint32_t zeroCopyCompleted_;                       // 这个序号之前的发送内核都已经通知完成了
+        std::deque<std::pair<uint32_t, ReleaseCallback>> zeroCopyPending_;  // 已经发送、等待内核通知完成的内存块
+        std::atomic<uint64_t> zeroCopySends_;
+        std::atomic<uint64_t> zeroCopyCopied_;
+
+        void* zeroCopyRegion_;                             // TCP_ZEROCOPY_RECEIVE映射的接收区，页对齐
+        size_t zeroCopyRegionSize_;
+        std::atomic<uint64_t> zeroCopyReceivedBytes_;
+
+        bool autoCork_;                                    // 是否合并同一轮事件循环中的发送
+        bool corkFlushPending_;                            // 是否已经queueInLoop了flushCorkedOutput
+        size_t notSentLowWaterMark_;                       // TCP_NOTSENT_LOWAT，0表示没有开启
+
+        std::deque<std::string> priorityQueues_[kMaxPriority + 1];  // 各个优先级的消息队列，下标0不使用
+        size_t priorityBytes_;                             // 所有优先级队列中的字节数
+        int priorityInProgress_;                           // 只发送了一部分的消息所在的优先级，0表示没有
+        size_t priorityOffset_;                            // 这条消息已经发送的字节数
+        std::atomic<size_t> priorityDepth_[kMaxPriority + 1];
+        std::atomic<size_t> priorityBytesByClass_[kMaxPriority + 1];
+        uint64_t normalQueued_;                            // 交给连接发送的普通数据的字节数
+        uint64_t normalSent_;                              // 已经发送的普通数据的字节数
+        uint64_t lastBoundary_;                            // 已经发送到的最后一个消息边界
+        std::deque<uint64_t> messageBoundaries_;           // 还没发送到的消息边界，用普通数据流中的偏移表示
+
+        std::shared_ptr<SplicePipe> spliceOut_;            // 本连接收到的数据转发给spliceTarget_的管道
+        std::weak_ptr<TcpConnection> spliceTarget_;
+        std::shared_ptr<SplicePipe> spliceIn_;             // 对端转发给本连接发送的管道
+        std::atomic<uint64_t> splicedBytes_;
 };
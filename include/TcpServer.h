@@ -9,6 +9,8 @@
 #include "Callbacks.h"
 #include "TcpConnection.h"
 #include "Buffer.h"
+#include "MemoryBudget.h"
+#include "TokenBucket.h"
 
 #include <functional>
 #include <string>
@@ -32,11 +34,54 @@ class TcpServer : noncopyable{
         TcpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg, Option = kNoReusePort);
         ~TcpServer();
 
+        const std::string& ipPort() const { return ipPort_; }
+        const std::string& name() const { return name_; }
+
         // 线程初始化回调
         void setThreadInitCallback(const ThreadInitCallback& cb){ threadInitCallback_ = cb; }
         void setConnectionCallback(const ConnectionCallback& cb){ connectionCallback_ = cb; }
         void setMessageCallback(const MessageCallback& cb){ messageCallback_ = cb; }
+        // 新连接使用TCP_ZEROCOPY_RECEIVE接收，收到的数据交给cb而不是messageCallback_，regionSize是每条连接映射的接收区大小
+        void setZeroCopyReadCallback(const ZeroCopyReadCallback& cb, size_t regionSize = 2*1024*1024){
+            zeroCopyReadCallback_ = cb;
+            zeroCopyRegionSize_ = regionSize;
+        }
         void setWriteCompleteCallback(const WriteCompleteCallback& cb){ writeCompleteCallback_ = cb; }
+        void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark){
+            highWaterMarkCallback_ = cb;
+            highWaterMark_ = highWaterMark;
+        }
+        // 对之后建立的所有连接开启流量控制，outputBuffer_超过highWaterMark暂停读，降到lowWaterMark以下恢复读
+        void setWaterMarks(size_t lowWaterMark, size_t highWaterMark){
+            lowWaterMark_ = lowWaterMark;
+            highWaterMark_ = highWaterMark;
+            flowControl_ = true;
+        }
+
+        // 所有连接共享的内存预算，可以多个TcpServer共用一个MemoryBudget
+        void setMemoryBudget(const std::shared_ptr<MemoryBudget>& budget){ memoryBudget_ = budget; }
+        void setMemoryBudget(size_t limit, MemoryBudget::Policy policy){
+            memoryBudget_ = std::make_shared<MemoryBudget>(limit, policy);
+        }
+        const std::shared_ptr<MemoryBudget>& memoryBudget() const { return memoryBudget_; }
+        // 当前所有连接缓冲区积压的数据，没有设置内存预算时返回0
+        size_t memoryUsage() const { return memoryBudget_ ? memoryBudget_->usage() : 0; }
+
+        // 每条连接的发送、接收限速，单位字节/秒，0表示不限速
+        void setConnectionRateLimit(double sendBytesPerSecond, double recvBytesPerSecond){
+            connSendRate_ = sendBytesPerSecond;
+            connRecvRate_ = recvBytesPerSecond;
+        }
+        // 所有连接共享的发送、接收限速，单位字节/秒，0表示不限速
+        void setServerRateLimit(double sendBytesPerSecond, double recvBytesPerSecond);
+        // 连接的发送限速优先使用内核的SO_MAX_PACING_RATE，内核不支持时退回到令牌桶
+        void setKernelPacing(bool on){ kernelPacing_ = on; }
+        // 新连接开启MSG_ZEROCOPY，TcpConnection::sendPinned不小于threshold字节的数据不拷贝，0表示关闭
+        void setZeroCopyThreshold(size_t threshold){ zeroCopyThreshold_ = threshold; }
+        // 新连接开启自动合并发送，同一轮事件循环中的多次send合并成一次write
+        void setAutoCork(bool on){ autoCork_ = on; }
+        // 新连接开启TCP_NOTSENT_LOWAT，待发送的数据尽量留在outputBuffer_中，0表示关闭
+        void setNotSentLowWaterMark(size_t bytes){ notSentLowWaterMark_ = bytes; }
 
         // 设置subloop的数量
         void setThreadNum(int numThreads);
@@ -59,7 +104,22 @@ class TcpServer : noncopyable{
         ThreadInitCallback threadInitCallback_;            // loop线程初始化的回调
         ConnectionCallback connectionCallback_;            // 有新连接的回调处理函数
         MessageCallback messageCallback_;                  // 已连接用户的读写消息回调处理函数
+        ZeroCopyReadCallback zeroCopyReadCallback_;        // 零拷贝接收的消息回调
+        size_t zeroCopyRegionSize_;                        // 零拷贝接收每条连接映射的大小
         WriteCompleteCallback writeCompleteCallback_;      // 消息发送完成的回调处理函数
+        HighWaterMarkCallback highWaterMarkCallback_;      // outputBuffer_超过高水位的回调
+        size_t highWaterMark_;                             // 高水位线，传给每一个TcpConnection
+        size_t lowWaterMark_;                              // 低水位线，开启流量控制时使用
+        bool flowControl_;                                 // 是否对新连接开启流量控制
+        std::shared_ptr<MemoryBudget> memoryBudget_;       // 所有连接共享的内存预算
+        double connSendRate_;                              // 每条连接的发送限速
+        double connRecvRate_;                              // 每条连接的接收限速
+        bool kernelPacing_;                                // 发送限速是否使用内核pacing
+        size_t zeroCopyThreshold_;                         // 零拷贝发送的阈值，传给每一个TcpConnection
+        bool autoCork_;                                    // 新连接是否开启自动合并发送
+        size_t notSentLowWaterMark_;                       // 传给每一个TcpConnection的TCP_NOTSENT_LOWAT
+        std::shared_ptr<TokenBucket> serverSendLimiter_;   // 所有连接共享的发送令牌桶
+        std::shared_ptr<TokenBucket> serverRecvLimiter_;   // 所有连接共享的接收令牌桶
 
         std::atomic_int started_;
         int nextConnId_;
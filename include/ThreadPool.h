@@ -0,0 +1,103 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <atomic>
+
+/**
+ * 计算线程池，用于把耗时、阻塞的操作从subloop中移出去，执行完后再通过conn->getLoop()->queueInLoop把结果交回IO线程
+ * 任务队列有上限，队列满时run会阻塞提交任务的线程，tryRun直接返回false
+ * runInOrder排在同一条连接后面、还没进入队列的任务也计入队列长度，IO线程中提交任务应该用tryRun、tryRunInOrder
+ */
+class ThreadPool : noncopyable{
+    public:
+        using Task = std::function<void()>;
+        using ThreadInitCallback = std::function<void()>;
+
+        explicit ThreadPool(const std::string& nameArg = std::string("ThreadPool"));
+        ~ThreadPool();
+
+        // 需要在start之前调用，0表示不限制队列长度
+        void setMaxQueueSize(size_t maxSize){ maxQueueSize_ = maxSize; }
+        void setThreadInitCallback(const ThreadInitCallback& cb){ threadInitCallback_ = cb; }
+
+        // numThreads为0时，run直接在调用者线程中执行任务
+        void start(int numThreads);
+        // 等待队列中的任务执行完，然后结束所有线程，还排在连接后面的有序任务被丢弃
+        void stop();
+
+        // 提交任务，队列满时阻塞等待
+        void run(Task task);
+        // 提交任务，队列满时返回false
+        bool tryRun(Task task);
+
+        // 在线程池中执行work，执行完后在conn所在的loop中执行done（done可以为空）
+        // 同一条连接提交的任务按提交顺序串行执行，done也按顺序执行，不同连接的任务并行执行
+        // 队列满时阻塞等待
+        void runInOrder(const TcpConnectionPtr& conn, Task work, Task done = Task());
+        // 队列满或者线程池已经停止时返回false，work和done都不会执行
+        bool tryRunInOrder(const TcpConnectionPtr& conn, Task work, Task done = Task());
+
+        const std::string& name() const { return name_; }
+        // 包括排在连接后面还没进入队列的有序任务
+        size_t queueSize() const;
+
+        // 用于确定线程池大小的统计信息
+        size_t peakQueueSize() const { return peakQueueSize_; }
+        uint64_t completedTasks() const { return completedTasks_; }
+        // 任务从提交到开始执行的平均等待时间和最大等待时间，单位微秒
+        int64_t averageWaitMicroSeconds() const;
+        int64_t maxWaitMicroSeconds() const { return maxWaitMicroSeconds_; }
+
+    private:
+        struct QueuedTask{
+            Task task;
+            Timestamp enqueueTime;
+        };
+
+        // 同一条连接还没执行的任务
+        struct OrderedTasks{
+            TcpConnectionPtr conn;                           // 保证任务执行完之前连接和它的loop不会被销毁
+            std::deque<std::pair<Task, Task>> tasks;         // work和done
+        };
+
+        void runInThread();
+        bool take(QueuedTask* task);
+        bool put(Task task, bool block);
+        bool putOrdered(const TcpConnectionPtr& conn, Task work, Task done, bool block);
+        // 把一条连接最早的任务放入队列，队列中的名额在putOrdered中已经预留了
+        void scheduleOrdered(TcpConnection* key);
+        void runOrdered(TcpConnection* key);
+        void updatePeakQueueSize();
+
+        std::string name_;
+        mutable std::mutex mutex_;
+        std::condition_variable notEmpty_;
+        std::condition_variable notFull_;
+        std::deque<QueuedTask> queue_;
+        size_t maxQueueSize_;
+        size_t orderedWaiting_;                              // 排在连接后面还没进入queue_的有序任务数，由mutex_保护
+        bool running_;
+
+        std::vector<std::unique_ptr<Thread>> threads_;
+        ThreadInitCallback threadInitCallback_;
+
+        std::mutex orderedMutex_;                            // 保护ordered_
+        std::unordered_map<TcpConnection*, OrderedTasks> ordered_;
+
+        std::atomic<size_t> peakQueueSize_;
+        std::atomic<uint64_t> completedTasks_;
+        std::atomic<int64_t> totalWaitMicroSeconds_;
+        std::atomic<int64_t> maxWaitMicroSeconds_;
+};
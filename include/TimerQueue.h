@@ -0,0 +1,54 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+
+#include <set>
+#include <vector>
+#include <utility>
+
+class EventLoop;
+class Timer;
+class TimerId;
+
+/**
+ * 定时器队列，使用timerfd把定时器统一到EventLoop的IO事件中，timerfd的超时时间设置为最早到期的定时器
+ * timerfd可读时，取出所有到期的定时器执行回调，所有操作都在所属loop线程中执行
+ */
+class TimerQueue : noncopyable{
+    public:
+        explicit TimerQueue(EventLoop* loop);
+        ~TimerQueue();
+
+        // 可以在任意线程调用，真正的添加、删除在loop线程中进行
+        TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+        void cancel(TimerId timerId);
+
+    private:
+        using Entry = std::pair<Timestamp, Timer*>;       // 按照超时时间排序，超时时间相同时按照地址区分
+        using TimerList = std::set<Entry>;
+        using ActiveTimer = std::pair<Timer*, int64_t>;   // 按照地址和序号查找，用于cancel
+        using ActiveTimerSet = std::set<ActiveTimer>;
+
+        void addTimerInLoop(Timer* timer);
+        void cancelInLoop(TimerId timerId);
+        // timerfd可读时调用
+        void handleRead();
+        // 取出所有到期的定时器
+        std::vector<Entry> getExpired(Timestamp now);
+        // 重复执行的定时器重新插入队列，并重新设置timerfd
+        void reset(const std::vector<Entry>& expired, Timestamp now);
+        // 插入定时器，返回最早到期的定时器是否改变
+        bool insert(Timer* timer);
+
+        EventLoop* loop_;
+        const int timerfd_;
+        Channel timerfdChannel_;
+        TimerList timers_;                   // 和activeTimers_保存的是同一组定时器
+
+        ActiveTimerSet activeTimers_;
+        bool callingExpiredTimers_;          // 是否正在执行到期定时器的回调
+        ActiveTimerSet cancelingTimers_;     // 执行回调期间被取消的定时器，不能再重新插入
+};
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include <stdint.h>
 
 class Timestamp{
     public:
@@ -9,6 +10,33 @@ class Timestamp{
         explicit Timestamp(int64_t microSecondsSinceEpoch);
         static Timestamp now(); // now方法不需要通过对象调用，类名即可直接调用
         std::string toString() const;
+
+        int64_t microSecondsSinceEpoch() const { return microSecondsSinceEpoch_; }
+        bool valid() const { return microSecondsSinceEpoch_ > 0; }
+
+        static Timestamp invalid(){ return Timestamp(); }
+
+        static const int kMicroSecondsPerSecond = 1000 * 1000;
     private:
         int64_t microSecondsSinceEpoch_;
 };
+
+inline bool operator<(Timestamp lhs, Timestamp rhs){
+    return lhs.microSecondsSinceEpoch() < rhs.microSecondsSinceEpoch();
+}
+
+inline bool operator==(Timestamp lhs, Timestamp rhs){
+    return lhs.microSecondsSinceEpoch() == rhs.microSecondsSinceEpoch();
+}
+
+// 两个时间相差的秒数
+inline double timeDifference(Timestamp high, Timestamp low){
+    int64_t diff = high.microSecondsSinceEpoch() - low.microSecondsSinceEpoch();
+    return static_cast<double>(diff) / Timestamp::kMicroSecondsPerSecond;
+}
+
+// timestamp加上seconds秒后的时间
+inline Timestamp addTime(Timestamp timestamp, double seconds){
+    int64_t delta = static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond);
+    return Timestamp(timestamp.microSecondsSinceEpoch() + delta);
+}
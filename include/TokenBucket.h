@@ -0,0 +1,37 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <mutex>
+
+/**
+ * 令牌桶，用于发送、接收限速，rate_是每秒补充的令牌数（字节数），burst_是桶的容量
+ * 允许令牌数为负（先读后扣），调用者在令牌不足时通过定时器等待，不会阻塞loop
+ * TcpServer级别的令牌桶会被多个subloop共享，所以用mutex_保护
+ */
+class TokenBucket : noncopyable{
+    public:
+        // burst为0时，默认容量为100ms的流量，且不小于16K
+        TokenBucket(double bytesPerSecond, double burst = 0.0);
+
+        double rate() const { return rate_; }
+        double burst() const { return burst_; }
+
+        // 当前可用的令牌数，没有令牌时返回0
+        size_t available(Timestamp now);
+        // 消耗bytes个令牌，令牌数可以变成负数
+        void consume(size_t bytes, Timestamp now);
+        // 还要等多少秒，令牌数才能达到bytes（超过容量时按容量计算）
+        double delayFor(size_t bytes, Timestamp now);
+
+    private:
+        // 根据上次补充到现在经过的时间补充令牌，需要持有mutex_
+        void refill(Timestamp now);
+
+        const double rate_;
+        const double burst_;
+        double tokens_;
+        Timestamp lastRefill_;
+        std::mutex mutex_;
+};
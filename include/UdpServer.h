@@ -0,0 +1,75 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "UdpSocket.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+class EventLoop;
+class EventLoopThreadPool;
+
+/**
+ * UDP服务器，数据报由UdpSocket批量收发
+ * kReusePort时每个subloop（没有subloop时是baseloop）各有一个绑定同一端口的SO_REUSEPORT socket，内核按四元组把数据报分给不同的loop
+ * kNoReusePort时只有一个socket，放在一个subloop中
+ * 同一个peer的数据报总是由同一个socket收到，回复用回调参数中的UdpSocket发送，在同一个loop中不需要跨线程
+ */
+class UdpServer : noncopyable{
+    public:
+        using ThreadInitCallback = std::function<void(EventLoop*)>;
+
+        enum Option{
+            kNoReusePort,
+            kReusePort,
+        };
+
+        UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg, Option option = kReusePort);
+        ~UdpServer();
+
+        const std::string& name() const { return name_; }
+
+        // 下面的设置需要在start之前调用
+        void setThreadNum(int numThreads);
+        void setThreadInitCallback(const ThreadInitCallback& cb){ threadInitCallback_ = cb; }
+        void setMessageCallback(const UdpMessageCallback& cb){ messageCallback_ = cb; }
+        // 每次recvmmsg最多收batchSize个数据报，比maxDatagramSize长的数据报被截断后丢弃
+        void setBatchSize(int batchSize){ batchSize_ = batchSize; }
+        void setMaxDatagramSize(size_t bytes){ maxDatagramSize_ = bytes; }
+        // 每个socket的SO_RCVBUF，0表示使用系统默认值
+        void setReceiveBufferSize(int bytes){ recvBufferSize_ = bytes; }
+        // 每个socket开启GSO、GRO，内核不支持时退回到普通的收发，见UdpSocket::enableGso、enableGro
+        void setGsoEnabled(bool on){ gso_ = on; }
+        void setGroEnabled(bool on){ gro_ = on; }
+
+        // 绑定端口失败时LOG_FATAL
+        void start();
+
+        // start之后才有，kReusePort时和loop一一对应
+        const std::vector<UdpSocketPtr>& sockets() const { return sockets_; }
+        // 所有socket的统计信息之和
+        uint64_t receivedDatagrams() const;
+        uint64_t sentDatagrams() const;
+        uint64_t droppedDatagrams() const;
+
+    private:
+        EventLoop* loop_;
+        const InetAddress listenAddr_;
+        const std::string name_;
+        const bool reusePort_;
+        std::shared_ptr<EventLoopThreadPool> threadPool_;
+        ThreadInitCallback threadInitCallback_;
+        UdpMessageCallback messageCallback_;
+        int batchSize_;
+        size_t maxDatagramSize_;
+        int recvBufferSize_;
+        bool gso_;
+        bool gro_;
+        std::atomic_int started_;
+        std::vector<UdpSocketPtr> sockets_;
+};
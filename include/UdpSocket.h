@@ -0,0 +1,149 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+class Channel;
+class EventLoop;
+class Socket;
+
+// 收到的一个UDP数据报，data指向UdpSocket的接收区
+// 开启GRO时可能是内核合并的多个数据报：每segmentSize个字节是一个数据报，最后一个可能更短；没有合并时segmentSize等于length
+struct UdpDatagram{
+    const char* data;
+    size_t length;
+    InetAddress peer;
+    size_t segmentSize;
+};
+
+/**
+ * 绑定在一个loop上的UDP socket，由Channel管理读写事件
+ * 每次读事件用recvmmsg一次收一批数据报，接收区在创建时按batchSize * maxDatagramSize分配好，之后不再分配内存
+ * send只把数据报追加到发送队列，一批数据报处理完（或者本轮事件循环结束）后用sendmmsg一起发送
+ * 内核发送缓冲区满时等待EPOLLOUT，队列超过上限后新的数据报直接丢弃，和网络丢包一样由上层处理
+ * 大块的流式数据可以开启GSO/GRO，由内核切分、合并数据报，一个系统调用处理的数据报个数再乘以几十
+ */
+class UdpSocket : noncopyable, public std::enable_shared_from_this<UdpSocket>{
+    public:
+        // sockfd必须是非阻塞的UDP socket，由UdpSocket负责关闭
+        UdpSocket(EventLoop* loop, const std::string& nameArg, int sockfd, int batchSize = 64, size_t maxDatagramSize = 2048);
+        ~UdpSocket();
+
+        // 创建非阻塞的UDP socket并绑定到addr，失败时返回-1
+        static int createBound(const InetAddress& addr, bool reusePort);
+
+        EventLoop* getLoop() const { return loop_; }
+        const std::string& name() const { return name_; }
+        int fd() const;
+        Socket* socket() { return socket_.get(); }
+
+        void setMessageCallback(const UdpMessageCallback& cb){ messageCallback_ = cb; }
+        // 发送队列中积压的字节数上限，超过以后丢弃新的数据报
+        void setMaxQueuedBytes(size_t bytes){ maxQueuedBytes_ = bytes; }
+        // 发送队列中还没发送的字节数，只能在loop线程中访问，发送方可以据此控制产生数据的速度
+        size_t queuedBytes() const { return sendArena_.readableBytes(); }
+
+        // 开启UDP_SEGMENT（GSO），sendSegmented的一大块数据在内核中切分成数据报，一次sendmmsg的每个消息都可以是几十个数据报
+        // 内核不支持时返回false，sendSegmented退回到每个数据报一个消息；发送时被拒绝（比如网卡不支持校验和卸载）也会自动退回
+        bool enableGso();
+        bool gsoEnabled() const { return gso_; }
+        // 开启UDP_GRO，内核把同一个流的连续数据报合并成一个大缓冲区交给回调，接收区的每个槽位扩大到64KB
+        // 需要在start之前调用，内核不支持时返回false，接收方式不变
+        bool enableGro();
+        bool groEnabled() const { return gro_; }
+
+        // 开始、停止关注读事件，需要在loop线程中调用
+        void start();
+        void stop();
+
+        // 可以在任意线程调用，其他线程调用时数据会被拷贝到loop线程中发送
+        void send(const InetAddress& peer, const void* data, size_t len);
+        void send(const InetAddress& peer, const std::string& data);
+        // 把data按segmentSize切分成多个数据报发送，最后一个可能更短，开启了GSO时由内核切分
+        void sendSegmented(const InetAddress& peer, const void* data, size_t len, size_t segmentSize);
+
+        // 统计信息，可以在任意线程读取
+        uint64_t receivedDatagrams() const { return receivedDatagrams_; }
+        uint64_t receiveCalls() const { return receiveCalls_; }
+        uint64_t truncatedDatagrams() const { return truncatedDatagrams_; }
+        uint64_t sentDatagrams() const { return sentDatagrams_; }
+        uint64_t sendCalls() const { return sendCalls_; }
+        uint64_t droppedDatagrams() const { return droppedDatagrams_; }
+        // 收到的内核合并过的缓冲区个数，receivedDatagrams按合并之前的数据报计数
+        uint64_t coalescedReceives() const { return coalescedReceives_; }
+
+    private:
+        // 发送队列中的一个数据报，数据保存在sendArena_中，sendArena_扩容以后只有偏移还有效
+        // segmentSize不为0时是GSO消息，内核按segmentSize切分
+        struct PendingDatagram{
+            sockaddr_in peer;
+            size_t offset;
+            size_t length;
+            size_t segmentSize;
+        };
+
+        static const int kMaxReceiveRounds = 8;         // 一次读事件最多调用几次recvmmsg，避免一直占着loop
+        static const int kMaxSendBatch = 256;           // 一次sendmmsg最多发送的消息个数
+        static const size_t kMaxGsoSegments = 64;       // 一个GSO消息最多的数据报个数，老版本内核的上限
+        static const size_t kMaxUdpPayload = 65507;     // IPv4上一个UDP消息（包括GSO消息）最多的数据字节数
+
+        void handleRead(Timestamp receiveTime);
+        void handleWrite();
+        void handleError();
+        void sendInLoop(const sockaddr_in& peer, const void* data, size_t len);
+        void sendStringInLoop(const InetAddress& peer, const std::string& data);
+        void sendSegmentedInLoop(const sockaddr_in& peer, const char* data, size_t len, size_t segmentSize);
+        void sendSegmentedStringInLoop(const InetAddress& peer, const std::string& data, size_t segmentSize);
+        // 内核拒绝了GSO消息，关闭GSO，把队列中剩下的GSO消息拆成普通的数据报，数据还在sendArena_中，不用拷贝
+        void disableGso();
+        // 为接收区的每个槽位分配内存，设置iovec、地址和控制消息的缓冲区
+        void setupReceiveArena(size_t slotSize);
+        // 删除已经发送的数据报，释放它们在sendArena_中的数据，剩下的数据报的偏移跟着前移
+        void compactSendQueue();
+        // 发送队列中的数据报，内核发送缓冲区满时关注写事件
+        void flushSendQueue();
+        void queueFlush();
+
+        EventLoop* loop_;
+        const std::string name_;
+        std::unique_ptr<Socket> socket_;
+        std::unique_ptr<Channel> channel_;
+        UdpMessageCallback messageCallback_;
+
+        // 接收区：recvmmsg的每个数据报对应一段recvSlotSize_的内存、一个iovec和一个地址
+        const int batchSize_;
+        const size_t maxDatagramSize_;
+        size_t recvSlotSize_;                            // 接收区每个槽位的大小，开启GRO后是64KB
+        std::vector<char> recvArena_;
+        std::vector<mmsghdr> recvMsgs_;
+        std::vector<iovec> recvIovecs_;
+        std::vector<sockaddr_in> recvAddrs_;
+        std::vector<char> recvControl_;                  // 每个槽位接收UDP_GRO控制消息的缓冲区
+        bool gso_;
+        bool gro_;
+
+        Buffer sendArena_;
+        std::vector<PendingDatagram> sendQueue_;
+        size_t sendHead_;                                // sendQueue_中下一个要发送的数据报
+        size_t maxQueuedBytes_;
+        bool inReceiveBatch_;                            // 是否在处理收到的一批数据报，处理完以后统一发送
+        bool flushQueued_;                               // 是否已经queueInLoop了flushSendQueue
+
+        std::atomic<uint64_t> receivedDatagrams_;
+        std::atomic<uint64_t> receiveCalls_;
+        std::atomic<uint64_t> truncatedDatagrams_;
+        std::atomic<uint64_t> sentDatagrams_;
+        std::atomic<uint64_t> sendCalls_;
+        std::atomic<uint64_t> droppedDatagrams_;
+        std::atomic<uint64_t> coalescedReceives_;
+};
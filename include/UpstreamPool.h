@@ -0,0 +1,97 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+#include "Connector.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+
+#include <functional>
+#include <string>
+#include <deque>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+class EventLoop;
+
+/**
+ * 上游连接池，每个loop有自己的一组上游连接，subloop中的请求只使用属于同一个loop的上游连接，不需要跨线程
+ * 用完的连接放回池中复用（keep-alive），每个loop的连接数有上限，达到上限后acquire排队等待归还的连接
+ * 上游连不上时排队的请求会失败，排队有超时和个数上限，上游不可用不会让请求一直挂起
+ * UpstreamPool需要在所有loop退出之后再析构
+ */
+class UpstreamPool : noncopyable{
+    public:
+        // 拿到一条已建立的上游连接，连接属于acquire传入的loop
+        // conn为空表示失败：上游连接失败、等待超时或者排队的请求太多
+        using AcquireCallback = std::function<void(const TcpConnectionPtr& conn)>;
+
+        UpstreamPool(const InetAddress& serverAddr, const std::string& nameArg, size_t maxConnectionsPerLoop);
+        ~UpstreamPool();
+
+        // 空闲超过seconds秒的连接会被关闭，0表示不关闭，需要在第一次acquire之前设置
+        void setIdleTimeout(double seconds){ idleTimeout_ = seconds; }
+        // 排队等待连接超过seconds秒的请求以失败回调，0表示不超时
+        void setAcquireTimeout(double seconds){ acquireTimeout_ = seconds; }
+        // 每个loop排队等待连接的请求数上限，超过时acquire直接失败
+        void setMaxWaitersPerLoop(size_t maxWaiters){ maxWaitersPerLoop_ = maxWaiters; }
+        // 新建连接失败后重试的次数，重试完仍然失败时减少连接计数
+        void setConnectRetries(int retries){ connectRetries_ = retries; }
+
+        // 只能在loop线程中调用，有空闲连接时直接回调，否则新建连接或者排队等待
+        // 拿到连接后，用户自己设置连接的MessageCallback来接收上游的响应
+        void acquire(EventLoop* loop, AcquireCallback cb);
+        // 归还连接，可以在连接的MessageCallback中调用，reusable为false时关闭连接
+        void release(const TcpConnectionPtr& conn, bool reusable = true);
+
+        // 只能在loop线程中调用
+        size_t idleConnections(EventLoop* loop);
+        size_t totalConnections(EventLoop* loop);
+
+    private:
+        // 排队的请求，id用来在超时的时候找到它
+        struct Waiter{
+            uint64_t id;
+            AcquireCallback cb;
+            TimerId timer;
+        };
+
+        // 一个loop的连接池，只在这个loop的线程中访问
+        struct LoopPool{
+            EventLoop* loop;
+            size_t total;                                                  // 已建立和正在建立的连接数
+            int nextConnId;
+            uint64_t nextWaiterId;
+            std::set<ConnectorPtr> connectors;                             // 正在建立的连接
+            std::set<TcpConnectionPtr> connections;                        // 持有所有已建立的连接，包括借出去的
+            std::deque<std::pair<TcpConnectionPtr, Timestamp>> idle;       // 空闲连接和放回池中的时间
+            std::deque<Waiter> waiters;                                    // 等待连接的请求
+        };
+
+        LoopPool* getLoopPool(EventLoop* loop);
+        void connectNew(LoopPool* pool);
+        void newConnection(LoopPool* pool, Connector* connector, int sockfd);
+        // 连接重试完仍然失败，没有其他连接可以等待时，排队的请求全部失败
+        void connectFailed(LoopPool* pool, Connector* connector, int err);
+        void removeConnector(LoopPool* pool, Connector* connector);
+        void acquireTimeout(LoopPool* pool, uint64_t waiterId);
+        void releaseInLoop(const TcpConnectionPtr& conn, bool reusable);
+        // 有等待的请求就交给它，否则放入空闲队列
+        void handOut(LoopPool* pool, const TcpConnectionPtr& conn);
+        void removeConnection(LoopPool* pool, const TcpConnectionPtr& conn);
+        void closeIdleConnections(LoopPool* pool);
+
+        const InetAddress serverAddr_;
+        const std::string name_;
+        const size_t maxConnectionsPerLoop_;
+        double idleTimeout_;
+        double acquireTimeout_;
+        size_t maxWaitersPerLoop_;
+        int connectRetries_;
+
+        std::mutex mutex_;                                                 // 只保护pools_的查找和插入
+        std::unordered_map<EventLoop*, std::unique_ptr<LoopPool>> pools_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Buffer.h"
+#include "StringPiece.h"
+#include "Payload.h"
+
+#include <string>
+#include <stddef.h>
+
+// WebSocket（RFC 6455）的握手和帧格式
+namespace WebSocket{
+    enum Opcode{
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xA,
+    };
+
+    enum CloseCode{
+        kNormalClosure = 1000,
+        kGoingAway = 1001,
+        kProtocolError = 1002,
+        kUnsupportedData = 1003,
+        kInvalidPayload = 1007,
+        kPolicyViolation = 1008,
+        kMessageTooBig = 1009,
+        kInternalError = 1011,
+    };
+
+    // 握手响应的Sec-WebSocket-Accept：base64(sha1(key + GUID))
+    std::string acceptKey(const StringPiece& clientKey);
+
+    // dst[i] = src[i] ^ mask[(maskOffset + i) % 4]，dst可以等于src
+    // x86上使用SSE2/AVX2一次处理16/32个字节，返回处理完以后的maskOffset，用于分段处理同一帧
+    size_t applyMask(char* dst, const char* src, size_t len, const char mask[4], size_t maskOffset);
+    // 当前使用的实现："avx2"、"sse2"或者"scalar"
+    const char* maskImplementation();
+
+    // 服务器发送的帧，不带掩码
+    void appendFrame(Buffer* output, Opcode opcode, const StringPiece& payload, bool fin = true);
+    // 编码好的帧，广播时只编码一次，所有连接共享
+    PayloadPtr makeFrame(Opcode opcode, const StringPiece& payload);
+    // 关闭帧的负载：2字节关闭码加上原因
+    void appendCloseFrame(Buffer* output, int code, const StringPiece& reason = StringPiece());
+    // 对方关闭帧中的关闭码是否合法（RFC 6455 7.4），1005、1006、1015只能在本地使用，不能出现在关闭帧中
+    bool isValidCloseCode(int code);
+}
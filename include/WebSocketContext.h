@@ -0,0 +1,65 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "WebSocket.h"
+#include "Buffer.h"
+#include "StringPiece.h"
+
+/**
+ * 每条WebSocket连接的帧解析状态，保存在TcpConnection的context中
+ * 增量解析：帧头完整以后，负载到达多少就去掉掩码多少，不需要等整个帧都收到，inputBuffer_中不会积压大帧
+ * 分片的消息拼接成一条完整的消息，消息之间穿插的控制帧单独交付
+ */
+class WebSocketContext : noncopyable{
+    public:
+        enum ParseResult{
+            kIncomplete,    // 需要更多数据
+            kMessage,       // message()是一条完整的文本或二进制消息
+            kControl,       // control()是一个ping、pong或者close帧的负载
+            kError,         // 协议错误，closeCode()是应该发给对方的关闭码
+        };
+
+        explicit WebSocketContext(size_t maxMessageSize);
+
+        // 解析buff中的数据，处理过的数据会从buff中取走
+        // 返回的消息、控制帧负载在下一次调用parse之前有效
+        ParseResult parse(Buffer* buff);
+
+        StringPiece message() const { return StringPiece(message_.peek(), message_.readableBytes()); }
+        bool binary() const { return messageOpcode_ == WebSocket::kBinary; }
+        WebSocket::Opcode controlOpcode() const { return controlOpcode_; }
+        StringPiece control() const { return StringPiece(control_.peek(), control_.readableBytes()); }
+        int closeCode() const { return closeCode_; }
+
+        // 已经发送过关闭帧，之后不再发送任何帧
+        bool closeSent() const { return closeSent_; }
+        void setCloseSent() { closeSent_ = true; }
+
+    private:
+        enum ParseState{
+            kExpectHeader,
+            kExpectPayload,
+        };
+
+        ParseResult fail(int code);
+        ParseResult parseHeader(Buffer* buff);
+        ParseResult frameDone();
+
+        const size_t maxMessageSize_;
+        ParseState state_;
+        ParseResult lastResult_;            // 上一次parse交付的是消息还是控制帧，这次先清空
+        // 当前帧
+        WebSocket::Opcode frameOpcode_;
+        bool frameFin_;
+        size_t frameRemaining_;             // 当前帧还没有收到的负载
+        char mask_[4];
+        size_t maskOffset_;
+        // 当前消息
+        bool inMessage_;                    // 收到了不是最后一片的数据帧，在等后面的分片
+        WebSocket::Opcode messageOpcode_;
+        Buffer message_;
+        WebSocket::Opcode controlOpcode_;
+        Buffer control_;
+        int closeCode_;
+        bool closeSent_;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "HttpServer.h"
+#include "WebSocket.h"
+#include "Payload.h"
+
+#include <functional>
+#include <string>
+#include <set>
+#include <mutex>
+
+/**
+ * WebSocket服务器，建立在HttpServer上：带Upgrade: websocket的请求完成握手以后切换成WebSocket帧，
+ * 其它请求仍然交给HttpCallback处理
+ * 自动回复ping，收到close帧时回复close并关闭连接，消息回调只收到完整的文本或二进制消息
+ */
+class WebSocketServer : noncopyable{
+    public:
+        // message指向连接内部的缓冲区，只在回调中有效
+        using WebSocketMessageCallback = std::function<void(const TcpConnectionPtr&, const StringPiece& message, bool binary, Timestamp)>;
+        // 收到握手请求时调用，可以检查路径、头部，返回false拒绝握手（403），这时101还没有发送，不能发送消息
+        using HandshakeCallback = std::function<bool(const TcpConnectionPtr&, const HttpRequest&)>;
+        // 握手完成，101响应已经发送，可以开始发送消息
+        using OpenCallback = std::function<void(const TcpConnectionPtr&)>;
+        using DisconnectCallback = std::function<void(const TcpConnectionPtr&)>;
+
+        WebSocketServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, TcpServer::Option option = TcpServer::kNoReusePort);
+
+        HttpServer* httpServer() { return &server_; }
+        // 不是WebSocket握手的普通HTTP请求
+        void setHttpCallback(const HttpServer::HttpCallback& cb){ server_.setHttpCallback(cb); }
+        void setHandshakeCallback(const HandshakeCallback& cb){ handshakeCallback_ = cb; }
+        void setOpenCallback(const OpenCallback& cb){ openCallback_ = cb; }
+        void setMessageCallback(const WebSocketMessageCallback& cb){ messageCallback_ = cb; }
+        void setDisconnectCallback(const DisconnectCallback& cb){ disconnectCallback_ = cb; }
+        // 一条消息（所有分片加起来）超过maxMessageSize时以1009关闭连接
+        void setMaxMessageSize(size_t bytes){ maxMessageSize_ = bytes; }
+
+        void setThreadNum(int numThreads){ server_.setThreadNum(numThreads); }
+        void start(){ server_.start(); }
+
+        // 发送一条消息，可以在任意线程调用
+        static void send(const TcpConnectionPtr& conn, const StringPiece& message, bool binary = false);
+        // 发送WebSocket::makeFrame编码好的帧
+        static void send(const TcpConnectionPtr& conn, const PayloadPtr& frame){ conn->send(frame); }
+        // 发送close帧并关闭连接，可以在任意线程调用
+        static void close(const TcpConnectionPtr& conn, int code = WebSocket::kNormalClosure, const std::string& reason = std::string());
+
+        // 发给所有已经完成握手的连接，帧只编码一次，所有连接共享同一份数据
+        void broadcast(const StringPiece& message, bool binary = false);
+        size_t connectionCount();
+
+    private:
+        MessageCallback onUpgrade(const TcpConnectionPtr& conn, const HttpRequest& request, HttpResponse* response);
+        void onConnection(const TcpConnectionPtr& conn);
+        void onWebSocketMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime);
+        static void closeInLoop(const TcpConnectionPtr& conn, int code, const std::string& reason);
+
+        HttpServer server_;
+        HandshakeCallback handshakeCallback_;
+        OpenCallback openCallback_;
+        WebSocketMessageCallback messageCallback_;
+        DisconnectCallback disconnectCallback_;
+        size_t maxMessageSize_;
+
+        std::mutex mutex_;
+        std::set<TcpConnectionPtr> connections_;           // 已经完成握手的连接，广播时使用
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <atomic>
+
+class EventLoop;
+
+/**
+ * 工作窃取线程池，用于计算密集、耗时差异很大的请求处理
+ * 每个工作线程有自己的任务队列和锁，subloop提交的任务放到绑定的工作线程队列中，没有全局的任务队列锁
+ * 工作线程自己的队列空了，就从其他工作线程的队列尾部窃取一半任务，避免少数很慢的请求把后面的请求都堵住
+ * IO线程（EventLoopThreadPool）和计算线程分开，计算结果通过loop->queueInLoop交回IO线程
+ */
+class WorkStealingPool : noncopyable{
+    public:
+        using Task = std::function<void()>;
+
+        explicit WorkStealingPool(const std::string& nameArg = std::string("WorkStealingPool"));
+        ~WorkStealingPool();
+
+        // 把IO线程的loop依次绑定到工作线程，从loop提交的任务优先放到绑定的工作线程的队列中，需要在start之前调用
+        void bindLoops(const std::vector<EventLoop*>& loops);
+
+        void start(int numWorkers);
+        // 等待所有任务执行完，然后结束所有工作线程
+        void stop();
+
+        // 在工作线程中提交的任务放到自己的队列，其他线程提交的任务轮询分配
+        // 线程池没有启动或者已经停止时返回false，任务不会执行；工作线程在stop期间提交的后续任务仍然会执行
+        bool submit(Task task);
+        // work在工作线程中执行，执行完后在loop中执行done（done可以为空），返回false时work和done都不会执行
+        bool submit(EventLoop* loop, Task work, Task done = Task());
+
+        const std::string& name() const { return name_; }
+        int numWorkers() const { return static_cast<int>(workers_.size()); }
+        size_t queueSize(int worker) const;
+        uint64_t executedTasks() const { return executedTasks_; }
+        uint64_t stolenTasks() const { return stolenTasks_; }
+
+    private:
+        struct Worker{
+            mutable std::mutex mutex;    // 只保护这个工作线程自己的队列
+            std::deque<Task> tasks;
+            std::unique_ptr<Thread> thread;
+        };
+
+        // 线程池停止以后不再接受其他线程提交的任务
+        bool accepting() const;
+        void push(size_t index, Task task);
+        bool popLocal(size_t index, Task* task);
+        // 从其他工作线程的队列尾部窃取一半任务，放到自己的队列中
+        bool steal(size_t index, Task* task);
+        void runInThread(size_t index);
+
+        std::string name_;
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::vector<EventLoop*> boundLoops_;
+        std::unordered_map<EventLoop*, size_t> loopToWorker_;  // start之后只读，不需要加锁
+        std::atomic<size_t> next_;                             // 非绑定线程提交任务时轮询的下标
+        std::atomic_bool running_;
+
+        std::atomic<int64_t> pending_;                         // 所有队列中还没有执行的任务数
+        std::atomic<int> sleepers_;                            // 没有任务可做、正在等待的工作线程数
+        std::mutex idleMutex_;                                 // 只在工作线程空闲等待时使用
+        std::condition_variable idleCond_;
+
+        std::atomic<uint64_t> executedTasks_;
+        std::atomic<uint64_t> stolenTasks_;
+};
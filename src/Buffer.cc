@@ -42,4 +42,12 @@ ssize_t Buffer::writeFd(int fd, int* saveErrno){
         *saveErrno = errno;
     }
     return n;
-}
\ No newline at end of file
+}
+
+ssize_t Buffer::writeFd(int fd, size_t maxBytes, int* saveErrno){
+    ssize_t n = ::write(fd, peek(), std::min(readableBytes(), maxBytes));
+    if (n < 0){
+        *saveErrno = errno;
+    }
+    return n;
+}
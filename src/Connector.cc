@@ -0,0 +1,203 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <algorithm>
+
+static int createNonblocking(){
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if(sockfd < 0){
+        LOG_FATAL("%s:%s:%d socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+    }
+    return sockfd;
+}
+
+// 非阻塞connect的结果需要通过SO_ERROR获取
+static int getSocketError(int sockfd){
+    int optval;
+    socklen_t optlen = static_cast<socklen_t>(sizeof(optval));
+    if(::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0){
+        return errno;
+    }
+    return optval;
+}
+
+// 连接本机的端口时，有可能源端口和目的端口相同，发生自连接
+static bool isSelfConnect(int sockfd){
+    sockaddr_in local, peer;
+    socklen_t len = sizeof(local);
+    memset(&local, 0, sizeof(local));
+    memset(&peer, 0, sizeof(peer));
+    ::getsockname(sockfd, (sockaddr*)&local, &len);
+    len = sizeof(peer);
+    ::getpeername(sockfd, (sockaddr*)&peer, &len);
+    return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+    : loop_(loop)
+    , serverAddr_(serverAddr)
+    , connect_(false)
+    , state_(kDisconnected)
+    , maxRetries_(-1)
+    , retries_(0)
+    , initRetryDelayMs_(kInitRetryDelayMs)
+    , maxRetryDelayMs_(kMaxRetryDelayMs)
+    , retryDelayMs_(kInitRetryDelayMs)
+{}
+
+Connector::~Connector(){}
+
+void Connector::start(){
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop(){
+    if(connect_ && state_ == kDisconnected){
+        connect();
+    }
+}
+
+void Connector::stop(){
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop(){
+    loop_->cancel(retryTimer_);
+    if(state_ == kConnecting){
+        int sockfd = removeAndResetChannel();
+        retry(sockfd, 0);  // connect_为false，只会关闭sockfd，不会重试
+    }
+}
+
+void Connector::restart(){
+    setState(kDisconnected);
+    retryDelayMs_ = initRetryDelayMs_;
+    retries_ = 0;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::connect(){
+    int sockfd = createNonblocking();
+    int ret = ::connect(sockfd, (sockaddr*)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch(savedErrno){
+        case 0:
+        case EINPROGRESS:  // 非阻塞connect正在进行
+        case EINTR:
+        case EISCONN:
+            connecting(sockfd);
+            break;
+
+        case EAGAIN:
+        case EADDRINUSE:
+        case EADDRNOTAVAIL:
+        case ECONNREFUSED:
+        case ENETUNREACH:
+            retry(sockfd, savedErrno);
+            break;
+
+        default:
+            // EACCES、EPERM、EBADF等，重试也不会成功
+            LOG_ERROR("Connector::connect %s error:%d \n", serverAddr_.toIpPort().c_str(), savedErrno);
+            ::close(sockfd);
+            setState(kDisconnected);
+            giveUp(savedErrno);
+            break;
+    }
+}
+
+void Connector::connecting(int sockfd){
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallBack(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallBack(std::bind(&Connector::handleError, this));
+    channel_->enableWriting();
+}
+
+// sockfd交给TcpConnection之前，需要把Channel从Poller中删除，TcpConnection会创建自己的Channel
+int Connector::removeAndResetChannel(){
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 现在还在Channel::handleEvent中，不能直接释放channel_
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel(){
+    channel_.reset();
+}
+
+void Connector::handleWrite(){
+    if(state_ == kConnecting){
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        if(err){
+            LOG_ERROR("Connector::handleWrite %s SO_ERROR:%d \n", serverAddr_.toIpPort().c_str(), err);
+            retry(sockfd, err);
+        }else if(isSelfConnect(sockfd)){
+            LOG_ERROR("Connector::handleWrite %s self connect \n", serverAddr_.toIpPort().c_str());
+            retry(sockfd, EADDRINUSE);
+        }else{
+            setState(kConnected);
+            retries_ = 0;
+            if(connect_ && newConnectionCallback_){
+                newConnectionCallback_(sockfd);
+            }else{
+                ::close(sockfd);
+            }
+        }
+    }
+}
+
+void Connector::handleError(){
+    if(state_ == kConnecting){
+        int sockfd = removeAndResetChannel();
+        int err = getSocketError(sockfd);
+        LOG_ERROR("Connector::handleError %s SO_ERROR:%d \n", serverAddr_.toIpPort().c_str(), err);
+        retry(sockfd, err);
+    }
+}
+
+void Connector::retry(int sockfd, int err){
+    ::close(sockfd);
+    setState(kDisconnected);
+    if(connect_ && maxRetries_ >= 0 && retries_ >= maxRetries_){
+        giveUp(err);
+        return;
+    }
+    if(connect_){
+        ++retries_;
+        LOG_INFO("Connector::retry connecting to %s in %d milliseconds \n", serverAddr_.toIpPort().c_str(), retryDelayMs_);
+        std::weak_ptr<Connector> weakConnector(shared_from_this());
+        retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weakConnector](){
+            ConnectorPtr connector = weakConnector.lock();
+            if(connector){
+                connector->startInLoop();
+            }
+        });
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+    }
+}
+
+// 可能在Connector自己的回调中调用，用户在connectFailedCallback_中释放Connector需要queueInLoop延后
+void Connector::giveUp(int err){
+    if(!connect_){
+        return;
+    }
+    LOG_ERROR("Connector::giveUp connecting to %s after %d retries, error:%d \n", serverAddr_.toIpPort().c_str(), retries_, err);
+    connect_ = false;
+    if(connectFailedCallback_){
+        connectFailedCallback_(err);
+    }
+}
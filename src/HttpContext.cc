@@ -0,0 +1,340 @@
+#include "HttpContext.h"
+#include "SimdSearch.h"
+
+#include <string.h>
+#include <algorithm>
+
+static const size_t kMaxHeaders = 100;
+static const size_t kMaxChunkSizeLine = 1024;      // chunk长度行，包括chunk扩展
+
+HttpContext::HttpContext(size_t maxHeaderSize, size_t maxBodySize)
+    : maxHeaderSize_(maxHeaderSize)
+    , maxBodySize_(maxBodySize)
+    , state_(kExpectHeaders)
+    , headerLength_(0)
+    , offset_(0)
+    , chunkRemaining_(0)
+    , requestLength_(0)
+    , expectContinue_(false)
+    , errorStatus_(0)
+    , chunkedBody_(0)           // 大量空闲的长连接时不占用内存，第一次使用时才分配
+    , output_(0)
+{}
+
+HttpContext::ParseResult HttpContext::fail(int status){
+    errorStatus_ = status;
+    return kError;
+}
+
+HttpContext::ParseResult HttpContext::parseRequest(Buffer* buff, Timestamp receiveTime){
+    if(state_ == kExpectHeaders){
+        // 请求之间多余的空行忽略
+        while(buff->readableBytes() >= 2 && buff->peek()[0] == '\r' && buff->peek()[1] == '\n'){
+            buff->retrieve(2);
+        }
+        // findDelimiter会记住查找过的位置，头部分多次到达时不会从头查找
+        const char* end = buff->findDelimiter("\r\n\r\n", 4);
+        if(end == nullptr){
+            return buff->readableBytes() > maxHeaderSize_ ? fail(HttpResponse::k431HeaderFieldsTooLarge) : kIncomplete;
+        }
+        headerLength_ = end + 4 - buff->peek();
+        if(headerLength_ > maxHeaderSize_){
+            return fail(HttpResponse::k431HeaderFieldsTooLarge);
+        }
+        if(!parseHeaders(buff->peek(), end + 2)){
+            return kError;
+        }
+
+        request_.base_ = buff->peek();
+        if(request_.chunked_){
+            chunkedBody_.retrieveAll();
+            offset_ = headerLength_;
+            state_ = kExpectChunkSize;
+        }else if(request_.contentLength_ > 0){
+            if(request_.contentLength_ > maxBodySize_){
+                return fail(HttpResponse::k413PayloadTooLarge);
+            }
+            state_ = kExpectBody;
+        }else{
+            requestLength_ = headerLength_;
+            state_ = kGotAll;
+        }
+        expectContinue_ = state_ != kGotAll && HttpRequest::hasToken(request_.getHeader("Expect"), "100-continue");
+    }
+
+    if(state_ == kExpectBody){
+        if(buff->readableBytes() < headerLength_ + request_.contentLength_){
+            return kIncomplete;
+        }
+        requestLength_ = headerLength_ + request_.contentLength_;
+        state_ = kGotAll;
+    }else if(state_ != kGotAll){
+        ParseResult result = parseChunked(buff);
+        if(result != kComplete){
+            return result;
+        }
+    }
+
+    complete(buff, receiveTime);
+    return kComplete;
+}
+
+void HttpContext::complete(Buffer* buff, Timestamp receiveTime){
+    request_.base_ = buff->peek();
+    if(request_.chunked_){
+        request_.body_ = StringPiece(chunkedBody_.peek(), chunkedBody_.readableBytes());
+    }else{
+        request_.body_ = StringPiece(buff->peek() + headerLength_, request_.contentLength_);
+    }
+    request_.receiveTime_ = receiveTime;
+}
+
+void HttpContext::finishRequest(Buffer* buff){
+    buff->retrieve(requestLength_);
+    state_ = kExpectHeaders;
+    headerLength_ = 0;
+    offset_ = 0;
+    chunkRemaining_ = 0;
+    requestLength_ = 0;
+    expectContinue_ = false;
+    request_.base_ = nullptr;
+    request_.method_ = HttpRequest::kInvalid;
+    request_.version_ = HttpRequest::kUnknown;
+    request_.headers_.clear();
+    request_.chunked_ = false;
+    request_.contentLength_ = 0;
+    request_.body_.clear();
+}
+
+bool HttpContext::takeExpectContinue(){
+    bool expect = expectContinue_;
+    expectContinue_ = false;
+    return expect;
+}
+
+// 请求行：method SP request-target SP HTTP-version
+bool HttpContext::parseRequestLine(const char* begin, const char* end){
+    const char* space = static_cast<const char*>(memchr(begin, ' ', end - begin));
+    if(space == nullptr || space == begin){
+        fail(HttpResponse::k400BadRequest);
+        return false;
+    }
+    StringPiece method(begin, space - begin);
+    if(method == "GET"){
+        request_.method_ = HttpRequest::kGet;
+    }else if(method == "POST"){
+        request_.method_ = HttpRequest::kPost;
+    }else if(method == "HEAD"){
+        request_.method_ = HttpRequest::kHead;
+    }else if(method == "PUT"){
+        request_.method_ = HttpRequest::kPut;
+    }else if(method == "DELETE"){
+        request_.method_ = HttpRequest::kDelete;
+    }else if(method == "OPTIONS"){
+        request_.method_ = HttpRequest::kOptions;
+    }else if(method == "PATCH"){
+        request_.method_ = HttpRequest::kPatch;
+    }else{
+        fail(HttpResponse::k501NotImplemented);
+        return false;
+    }
+    request_.methodRange_.offset = 0;
+    request_.methodRange_.length = static_cast<uint32_t>(method.size());
+
+    const char* target = space + 1;
+    space = static_cast<const char*>(memchr(target, ' ', end - target));
+    if(space == nullptr || space == target){
+        fail(HttpResponse::k400BadRequest);
+        return false;
+    }
+    const char* question = static_cast<const char*>(memchr(target, '?', space - target));
+    const char* pathEnd = question != nullptr ? question : space;
+    request_.pathRange_.offset = static_cast<uint32_t>(target - begin);
+    request_.pathRange_.length = static_cast<uint32_t>(pathEnd - target);
+    if(question != nullptr){
+        request_.queryRange_.offset = static_cast<uint32_t>(question + 1 - begin);
+        request_.queryRange_.length = static_cast<uint32_t>(space - question - 1);
+    }else{
+        request_.queryRange_.offset = static_cast<uint32_t>(space - begin);
+        request_.queryRange_.length = 0;
+    }
+
+    StringPiece version(space + 1, end - space - 1);
+    if(version == "HTTP/1.1"){
+        request_.version_ = HttpRequest::kHttp11;
+    }else if(version == "HTTP/1.0"){
+        request_.version_ = HttpRequest::kHttp10;
+    }else{
+        fail(version.starts_with("HTTP/") ? HttpResponse::k505VersionNotSupported : HttpResponse::k400BadRequest);
+        return false;
+    }
+    return true;
+}
+
+// [begin, end)是请求行和所有的头部字段，每一行都以\r\n结尾，不包括最后的空行
+bool HttpContext::parseHeaders(const char* begin, const char* end){
+    const char* crlf = SimdSearch::find(begin, end, "\r\n", 2);
+    if(!parseRequestLine(begin, crlf)){
+        return false;
+    }
+
+    bool hasContentLength = false;
+    bool hasTransferEncoding = false;
+    const char* line = crlf + 2;
+    while(line < end){
+        crlf = SimdSearch::find(line, end, "\r\n", 2);
+        // 不支持已经废弃的多行字段值
+        if(*line == ' ' || *line == '\t' || request_.headers_.size() >= kMaxHeaders){
+            fail(request_.headers_.size() >= kMaxHeaders ? HttpResponse::k431HeaderFieldsTooLarge : HttpResponse::k400BadRequest);
+            return false;
+        }
+        const char* colon = static_cast<const char*>(memchr(line, ':', crlf - line));
+        // 字段名中不能有空白，包括字段名和冒号之间
+        if(colon == nullptr || colon == line || memchr(line, ' ', colon - line) != nullptr || memchr(line, '\t', colon - line) != nullptr){
+            fail(HttpResponse::k400BadRequest);
+            return false;
+        }
+        const char* value = colon + 1;
+        const char* valueEnd = crlf;
+        while(value < valueEnd && (*value == ' ' || *value == '\t')){
+            ++value;
+        }
+        while(valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t')){
+            --valueEnd;
+        }
+
+        HttpRequest::Header header;
+        header.name.offset = static_cast<uint32_t>(line - begin);
+        header.name.length = static_cast<uint32_t>(colon - line);
+        header.value.offset = static_cast<uint32_t>(value - begin);
+        header.value.length = static_cast<uint32_t>(valueEnd - value);
+        request_.headers_.push_back(header);
+
+        StringPiece name(line, colon - line);
+        StringPiece fieldValue(value, valueEnd - value);
+        if(name.size() == 14 && strncasecmp(name.data(), "Content-Length", 14) == 0){
+            size_t length = 0;
+            if(fieldValue.empty()){
+                fail(HttpResponse::k400BadRequest);
+                return false;
+            }
+            for(char c : fieldValue){
+                if(c < '0' || c > '9' || length > maxBodySize_){
+                    fail(c < '0' || c > '9' ? HttpResponse::k400BadRequest : HttpResponse::k413PayloadTooLarge);
+                    return false;
+                }
+                length = length * 10 + (c - '0');
+            }
+            // 多个不一致的Content-Length可能是请求走私，拒绝
+            if(hasContentLength && length != request_.contentLength_){
+                fail(HttpResponse::k400BadRequest);
+                return false;
+            }
+            hasContentLength = true;
+            request_.contentLength_ = length;
+        }else if(name.size() == 17 && strncasecmp(name.data(), "Transfer-Encoding", 17) == 0){
+            if(!HttpRequest::hasToken(fieldValue, "chunked")){
+                fail(HttpResponse::k501NotImplemented);
+                return false;
+            }
+            hasTransferEncoding = true;
+            request_.chunked_ = true;
+        }
+        line = crlf + 2;
+    }
+    // 同时有Content-Length和Transfer-Encoding的请求也可能是请求走私
+    if(hasContentLength && hasTransferEncoding){
+        fail(HttpResponse::k400BadRequest);
+        return false;
+    }
+    return true;
+}
+
+HttpContext::ParseResult HttpContext::parseChunked(Buffer* buff){
+    const char* base = buff->peek();
+    const size_t readable = buff->readableBytes();
+    while(true){
+        switch(state_){
+            case kExpectChunkSize:{
+                const char* crlf = buff->findCRLF(base + offset_);
+                if(crlf == nullptr){
+                    return readable - offset_ > kMaxChunkSizeLine ? fail(HttpResponse::k400BadRequest) : kIncomplete;
+                }
+                size_t size = 0;
+                const char* p = base + offset_;
+                for(; p < crlf; ++p){
+                    int digit;
+                    if(*p >= '0' && *p <= '9'){
+                        digit = *p - '0';
+                    }else if(*p >= 'a' && *p <= 'f'){
+                        digit = *p - 'a' + 10;
+                    }else if(*p >= 'A' && *p <= 'F'){
+                        digit = *p - 'A' + 10;
+                    }else{
+                        break;  // chunk扩展忽略
+                    }
+                    size = size * 16 + digit;
+                    if(size > maxBodySize_){
+                        return fail(HttpResponse::k413PayloadTooLarge);
+                    }
+                }
+                if(p == base + offset_ || (p < crlf && *p != ';' && *p != ' ' && *p != '\t')){
+                    return fail(HttpResponse::k400BadRequest);
+                }
+                if(chunkedBody_.readableBytes() + size > maxBodySize_){
+                    return fail(HttpResponse::k413PayloadTooLarge);
+                }
+                offset_ = crlf + 2 - base;
+                if(size == 0){
+                    state_ = kExpectTrailers;
+                }else{
+                    chunkRemaining_ = size;
+                    state_ = kExpectChunkData;
+                }
+                break;
+            }
+            case kExpectChunkData:{
+                // 收到多少解码多少，下次从offset_继续
+                size_t n = std::min(chunkRemaining_, readable - offset_);
+                if(n == 0){
+                    return kIncomplete;
+                }
+                chunkedBody_.append(base + offset_, n);
+                offset_ += n;
+                chunkRemaining_ -= n;
+                if(chunkRemaining_ == 0){
+                    state_ = kExpectChunkDataCRLF;
+                }
+                break;
+            }
+            case kExpectChunkDataCRLF:{
+                if(readable - offset_ < 2){
+                    return kIncomplete;
+                }
+                if(base[offset_] != '\r' || base[offset_ + 1] != '\n'){
+                    return fail(HttpResponse::k400BadRequest);
+                }
+                offset_ += 2;
+                state_ = kExpectChunkSize;
+                break;
+            }
+            case kExpectTrailers:{
+                // 最后一个chunk后面的trailer字段忽略，直到空行
+                const char* crlf = buff->findCRLF(base + offset_);
+                if(crlf == nullptr){
+                    return readable - offset_ > maxHeaderSize_ ? fail(HttpResponse::k431HeaderFieldsTooLarge) : kIncomplete;
+                }
+                bool emptyLine = crlf == base + offset_;
+                offset_ = crlf + 2 - base;
+                if(emptyLine){
+                    requestLength_ = offset_;
+                    state_ = kGotAll;
+                    return kComplete;
+                }
+                break;
+            }
+            default:
+                return kComplete;
+        }
+    }
+}
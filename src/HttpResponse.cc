@@ -0,0 +1,129 @@
+#include "HttpResponse.h"
+
+#include <stdio.h>
+
+// 十进制写入buff，每个响应都要写状态码和长度，比snprintf快很多
+static void appendDecimal(Buffer* buff, size_t value){
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    do{
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }while(value != 0);
+    buff->append(p, digits + sizeof(digits) - p);
+}
+
+HttpResponse::HttpResponse(bool close)
+    : statusCode_(k200Ok)
+    , closeConnection_(close)
+    , chunked_(false)
+    , http10_(false)
+    , closeDelimited_(false)
+    , headers_(0)           // 大量空闲的长连接时不占用内存，第一次使用时才分配
+    , body_(0)
+{}
+
+void HttpResponse::reset(bool close, bool http10){
+    statusCode_ = k200Ok;
+    closeConnection_ = close;
+    chunked_ = false;
+    http10_ = http10;
+    closeDelimited_ = false;
+    headers_.retrieveAll();
+    body_.retrieveAll();
+}
+
+void HttpResponse::addHeader(const StringPiece& field, const StringPiece& value){
+    headers_.append(field);
+    headers_.append(": ", 2);
+    headers_.append(value);
+    headers_.append("\r\n", 2);
+}
+
+void HttpResponse::setChunked(bool on){
+    // HTTP/1.0的客户端不认识chunked，退回到用关闭连接表示响应体结束
+    chunked_ = on && !http10_;
+    closeDelimited_ = on && http10_;
+}
+
+void HttpResponse::appendChunk(const StringPiece& data){
+    if(closeDelimited_){
+        body_.append(data);
+        return;
+    }
+    if(data.empty()){
+        return;     // 长度为0的chunk表示结束，由appendToBuffer添加
+    }
+    char size[32];
+    int n = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    body_.append(size, n);
+    body_.append(data);
+    body_.append("\r\n", 2);
+}
+
+void HttpResponse::appendToBuffer(Buffer* output, bool includeBody) const{
+    output->append("HTTP/1.1 ", 9);
+    appendDecimal(output, statusCode_);
+    output->append(" ", 1);
+    output->append(statusMessage(statusCode_));
+    output->append("\r\n", 2);
+
+    if(statusCode_ == k101SwitchingProtocols){
+        // 协议升级的响应，Connection和Upgrade由用户添加
+    }else if(statusCode_ == k204NoContent || statusCode_ == 304){
+        // 这两种响应没有响应体，不能带Content-Length
+    }else if(chunked_){
+        output->append("Transfer-Encoding: chunked\r\n");
+    }else if(closeDelimited_){
+        // 没有长度，客户端读到连接关闭就是响应体结束
+    }else{
+        output->append("Content-Length: ", 16);
+        appendDecimal(output, body_.readableBytes());
+        output->append("\r\n", 2);
+    }
+    if(statusCode_ != k101SwitchingProtocols){
+        if(closeConnection()){
+            output->append("Connection: close\r\n");
+        }else{
+            // HTTP/1.0的客户端需要明确告诉它保持连接，HTTP/1.1的客户端会忽略
+            output->append("Connection: keep-alive\r\n");
+        }
+    }
+    output->append(headers_.peek(), headers_.readableBytes());
+    output->append("\r\n", 2);
+
+    if(includeBody && statusCode_ != k204NoContent && statusCode_ != 304){
+        output->append(body_.peek(), body_.readableBytes());
+        if(chunked_){
+            output->append("0\r\n\r\n", 5);
+        }
+    }
+}
+
+const char* HttpResponse::statusMessage(int code){
+    switch(code){
+        case 100: return "Continue";
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 206: return "Partial Content";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Payload Too Large";
+        case 426: return "Upgrade Required";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 505: return "HTTP Version Not Supported";
+        default: return "Unknown";
+    }
+}
@@ -0,0 +1,105 @@
+#include "HttpServer.h"
+#include "HttpContext.h"
+#include "Logger.h"
+
+static void defaultHttpCallback(const HttpRequest&, HttpResponse* resp){
+    resp->setStatusCode(HttpResponse::k404NotFound);
+}
+
+HttpServer::HttpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, TcpServer::Option option)
+    : loop_(loop)
+    , server_(loop, listenAddr, name, option)
+    , httpCallback_(defaultHttpCallback)
+    , maxHeaderSize_(64*1024)
+    , maxBodySize_(64*1024*1024)
+{
+    server_.setConnectionCallback(std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void HttpServer::start(){
+    LOG_INFO("HttpServer[%s] starts listening on %s \n", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn){
+    if(conn->connected()){
+        conn->setContext(std::make_shared<HttpContext>(maxHeaderSize_, maxBodySize_));
+    }
+    if(connectionCallback_){
+        connectionCallback_(conn);
+    }
+}
+
+// 升级以后的数据交给新的回调，在这一轮事件处理完以后再切换，不在messageCallback_执行的过程中给它赋值
+static void switchProtocol(const TcpConnectionPtr& conn, const MessageCallback& cb, Buffer* buff, Timestamp receiveTime){
+    conn->setMessageCallback(cb);
+    if(buff->readableBytes() > 0 && conn->connected()){
+        // 和升级请求一起到达的数据
+        cb(conn, buff, receiveTime);
+    }
+}
+
+void HttpServer::onMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime){
+    // 回调中可能会替换连接的context（比如协议升级），处理完之前持有一个引用
+    std::shared_ptr<void> holder = conn->getContext();
+    HttpContext* context = static_cast<HttpContext*>(holder.get());
+    if(context == nullptr || !conn->connected()){
+        // 已经决定关闭的连接，后面的请求不再处理
+        buff->retrieveAll();
+        return;
+    }
+
+    Buffer* output = context->output();
+    bool close = false;
+    while(!close){
+        HttpContext::ParseResult result = context->parseRequest(buff, receiveTime);
+        if(result == HttpContext::kIncomplete){
+            if(context->takeExpectContinue()){
+                output->append("HTTP/1.1 100 Continue\r\n\r\n");
+            }
+            break;
+        }
+        HttpResponse* response = context->response();
+        if(result == HttpContext::kError){
+            LOG_DEBUG("HttpServer::onMessage [%s] bad request, status %d\n", conn->name().c_str(), context->errorStatus());
+            response->reset(true);
+            response->setStatusCode(context->errorStatus());
+            response->appendToBuffer(output);
+            close = true;
+            break;
+        }
+
+        const HttpRequest& request = context->request();
+        response->reset(!request.keepAlive(), request.version() == HttpRequest::kHttp10);
+        if(upgradeCallback_ && !request.getHeader("Upgrade").empty()){
+            MessageCallback upgraded = upgradeCallback_(conn, request, response);
+            if(upgraded){
+                response->appendToBuffer(output, false);
+                context->finishRequest(buff);
+                conn->send(output);
+                // buff是连接的inputBuffer_，和conn的生命周期一样
+                conn->getLoop()->queueInLoop(std::bind(switchProtocol, conn, upgraded, buff, receiveTime));
+                return;
+            }
+            if(response->statusCode() == HttpResponse::k200Ok){
+                // 不认识要升级的协议，可以忽略Upgrade（RFC 9110 7.8），按普通请求处理
+                httpCallback_(request, response);
+            }
+        }else{
+            httpCallback_(request, response);
+        }
+        response->appendToBuffer(output, request.method() != HttpRequest::kHead);
+        close = response->closeConnection();
+        context->finishRequest(buff);
+    }
+
+    if(output->readableBytes() > 0){
+        // 在loop线程中send(Buffer*)会直接写socket，没写完时交换进outputBuffer_，都不拷贝
+        conn->send(output);
+    }
+    if(close){
+        buff->retrieveAll();
+        conn->shutdown();
+    }
+}
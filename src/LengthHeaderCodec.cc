@@ -0,0 +1,74 @@
+#include "LengthHeaderCodec.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+LengthHeaderCodec::LengthHeaderCodec(const FrameCallback& cb, size_t maxFrameSize)
+    : frameCallback_(cb)
+    , maxFrameSize_(maxFrameSize)
+{}
+
+LengthHeaderCodec::LengthHeaderCodec(const FrameBatchCallback& cb, size_t maxFrameSize)
+    : frameBatchCallback_(cb)
+    , maxFrameSize_(maxFrameSize)
+{}
+
+MessageCallback LengthHeaderCodec::messageCallback(){
+    return std::bind(&LengthHeaderCodec::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+}
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime){
+    // 先找出所有完整的帧，交付以后再一起从buff中取走，帧数据一直在inputBuffer_中，不拷贝
+    StringPiece frames[kMaxBatch];
+    int count = 0;
+    const char* start = buff->peek();
+    const char* end = start + buff->readableBytes();
+    while(static_cast<size_t>(end - start) >= kHeaderLen){
+        uint32_t be32 = 0;
+        memcpy(&be32, start, sizeof(be32));
+        const size_t len = be32toh(be32);
+        if(len > maxFrameSize_){
+            LOG_ERROR("LengthHeaderCodec::onMessage [%s] invalid frame length %zu, max %zu \n", conn->name().c_str(), len, maxFrameSize_);
+            buff->retrieveAll();
+            conn->forceClose();
+            return;
+        }
+        if(static_cast<size_t>(end - start) < kHeaderLen + len){
+            break;  // 这一帧还没有收完
+        }
+        frames[count++] = StringPiece(start + kHeaderLen, len);
+        start += kHeaderLen + len;
+        if(count == kMaxBatch){
+            deliver(conn, frames, count, receiveTime);
+            count = 0;
+        }
+    }
+    if(count > 0){
+        deliver(conn, frames, count, receiveTime);
+    }
+    buff->retrieveUntil(start);
+}
+
+void LengthHeaderCodec::deliver(const TcpConnectionPtr& conn, const StringPiece* frames, int count, Timestamp receiveTime){
+    if(frameBatchCallback_){
+        frameBatchCallback_(conn, frames, count, receiveTime);
+    }else{
+        for(int i = 0; i < count; ++i){
+            frameCallback_(conn, frames[i], receiveTime);
+        }
+    }
+}
+
+void LengthHeaderCodec::encode(Buffer* buff){
+    buff->prependInt32(static_cast<int32_t>(buff->readableBytes()));
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, Buffer* buff){
+    encode(buff);
+    conn->send(buff);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr& conn, const StringPiece& message){
+    Buffer buff(message.size());
+    buff.append(message);
+    send(conn, &buff);
+}
@@ -0,0 +1,374 @@
+#include "MemcacheServer.h"
+#include "Logger.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// 每条连接的状态，保存在TcpConnection的context中
+struct MemcacheServer::Context{
+    Buffer output;          // 一次收到的所有命令的响应
+    size_t swallow;         // 需要丢弃的数据，太大的数据项
+};
+
+static const size_t kMaxLineLen = 2048;
+static const int kMaxTokens = 8;
+
+// 按空格切分命令行，最多max个，返回个数；超过max个时返回max + 1
+static int tokenize(const StringPiece& line, StringPiece* tokens, int max){
+    int count = 0;
+    const char* p = line.begin();
+    const char* end = line.end();
+    while(p < end){
+        while(p < end && *p == ' '){
+            ++p;
+        }
+        if(p == end){
+            break;
+        }
+        const char* start = p;
+        while(p < end && *p != ' '){
+            ++p;
+        }
+        if(count == max){
+            return max + 1;
+        }
+        tokens[count++] = StringPiece(start, p - start);
+    }
+    return count;
+}
+
+static bool parseUint64(const StringPiece& s, uint64_t* out){
+    if(s.empty() || s.size() > 20){
+        return false;
+    }
+    uint64_t value = 0;
+    for(size_t i = 0; i < s.size(); ++i){
+        if(s[i] < '0' || s[i] > '9'){
+            return false;
+        }
+        uint64_t next = value * 10 + (s[i] - '0');
+        if(next / 10 != value){
+            return false;
+        }
+        value = next;
+    }
+    *out = value;
+    return true;
+}
+
+static bool parseUint32(const StringPiece& s, uint32_t* out){
+    uint64_t value = 0;
+    if(!parseUint64(s, &value) || value > 0xFFFFFFFFULL){
+        return false;
+    }
+    *out = static_cast<uint32_t>(value);
+    return true;
+}
+
+static bool parseInt64(const StringPiece& s, int64_t* out){
+    StringPiece digits(s);
+    bool negative = !digits.empty() && digits[0] == '-';
+    if(negative){
+        digits.remove_prefix(1);
+    }
+    uint64_t value = 0;
+    if(!parseUint64(digits, &value) || value > static_cast<uint64_t>(INT64_MAX)){
+        return false;
+    }
+    *out = negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+    return true;
+}
+
+static void appendReply(Buffer* output, const char* reply, bool noreply){
+    if(!noreply){
+        output->append(StringPiece(reply));
+    }
+}
+
+MemcacheServer::MemcacheServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, size_t memoryLimit, int shards, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , store_(memoryLimit, shards)
+    , startTime_(Timestamp::now())
+    , currConnections_(0)
+    , totalConnections_(0)
+    , cmdSet_(0)
+{
+    server_.setConnectionCallback(std::bind(&MemcacheServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(std::bind(&MemcacheServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+}
+
+void MemcacheServer::start(){
+    LOG_INFO("MemcacheServer[%s] starts listening on %s \n", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void MemcacheServer::onConnection(const TcpConnectionPtr& conn){
+    if(conn->connected()){
+        std::shared_ptr<Context> context = std::make_shared<Context>();
+        context->swallow = 0;
+        conn->setContext(context);
+        ++currConnections_;
+        ++totalConnections_;
+    }else{
+        --currConnections_;
+    }
+}
+
+void MemcacheServer::onMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp){
+    std::shared_ptr<void> holder = conn->getContext();
+    Context* context = static_cast<Context*>(holder.get());
+    if(context == nullptr || !conn->connected()){
+        buff->retrieveAll();
+        return;
+    }
+    bool close = false;
+    while(!close && buff->readableBytes() > 0){
+        if(context->swallow > 0){
+            size_t n = std::min(context->swallow, buff->readableBytes());
+            buff->retrieve(n);
+            context->swallow -= n;
+            continue;
+        }
+        if(!processCommand(context, buff, &close)){
+            break;  // 命令还没有收完
+        }
+    }
+    if(context->output.readableBytes() > 0){
+        conn->send(&context->output);
+    }
+    if(close){
+        buff->retrieveAll();
+        conn->shutdown();
+    }
+}
+
+bool MemcacheServer::processCommand(Context* context, Buffer* buff, bool* close){
+    Buffer* output = &context->output;
+    const char* eol = buff->findEOL();
+    if(eol == nullptr){
+        if(buff->readableBytes() > kMaxLineLen){
+            output->append("CLIENT_ERROR line too long\r\n");
+            *close = true;
+        }
+        return false;
+    }
+    const size_t lineLen = eol - buff->peek() + 1;
+    StringPiece line(buff->peek(), lineLen - 1);
+    if(!line.empty() && line[line.size() - 1] == '\r'){
+        line.remove_suffix(1);
+    }
+
+    // get的key可以有很多个，单独处理
+    StringPiece command;
+    tokenize(line, &command, 1);
+    if(command == "get" || command == "gets"){
+        StringPiece keys(line);
+        keys.remove_prefix(command.end() - line.begin());
+        StringPiece key;
+        int count = 0;
+        bool valid = true;
+        // 先检查所有的key，出错时不输出任何VALUE
+        for(StringPiece rest(keys); tokenize(rest, &key, 1) >= 1; rest.remove_prefix(key.end() - rest.begin())){
+            valid = valid && key.size() <= MemcacheStore::kMaxKeyLen;
+            ++count;
+        }
+        if(count == 0){
+            output->append("ERROR\r\n");
+        }else if(!valid){
+            output->append("CLIENT_ERROR bad command line format\r\n");
+        }else{
+            const bool withCas = command.size() == 4;
+            for(StringPiece rest(keys); tokenize(rest, &key, 1) >= 1; rest.remove_prefix(key.end() - rest.begin())){
+                store_.get(key, withCas, output);
+            }
+            output->append("END\r\n");
+        }
+        buff->retrieve(lineLen);
+        return true;
+    }
+
+    StringPiece tokens[kMaxTokens];
+    const int count = tokenize(line, tokens, kMaxTokens);
+    if(count > kMaxTokens){
+        output->append("ERROR\r\n");
+        buff->retrieve(lineLen);
+        return true;
+    }
+    const bool noreply = count > 1 && tokens[count - 1] == "noreply";
+    // 存储命令后面还有数据块，出错时也要跳过数据块，由processStorage处理
+    if(command == "set" || command == "add" || command == "replace" || command == "append" || command == "prepend" || command == "cas"){
+        return processStorage(tokens, count, noreply, context, buff, lineLen, close);
+    }
+    if(count > 1 && tokens[1].size() > MemcacheStore::kMaxKeyLen){
+        output->append("CLIENT_ERROR bad command line format\r\n");
+        buff->retrieve(lineLen);
+        return true;
+    }
+
+    if(command == "delete" && count >= 2 && count <= 4){
+        // 兼容旧版本的"delete key 0"
+        if(count - noreply > 3 || (count - noreply == 3 && tokens[2] != "0")){
+            output->append("CLIENT_ERROR bad command line format.  Usage: delete <key> [noreply]\r\n");
+        }else{
+            appendReply(output, store_.remove(tokens[1]) ? "DELETED\r\n" : "NOT_FOUND\r\n", noreply);
+        }
+    }else if((command == "incr" || command == "decr") && (count == 3 || (count == 4 && noreply))){
+        uint64_t amount = 0;
+        uint64_t result = 0;
+        if(!parseUint64(tokens[2], &amount)){
+            output->append("CLIENT_ERROR invalid numeric delta argument\r\n");
+        }else{
+            switch(store_.delta(tokens[1], command == "incr", amount, &result)){
+                case MemcacheStore::kDeltaOk:
+                    if(!noreply){
+                        char buf[32];
+                        int n = snprintf(buf, sizeof(buf), "%llu\r\n", static_cast<unsigned long long>(result));
+                        output->append(buf, n);
+                    }
+                    break;
+                case MemcacheStore::kDeltaNotFound:
+                    appendReply(output, "NOT_FOUND\r\n", noreply);
+                    break;
+                case MemcacheStore::kDeltaNonNumeric:
+                    output->append("CLIENT_ERROR cannot increment or decrement non-numeric value\r\n");
+                    break;
+                case MemcacheStore::kDeltaOutOfMemory:
+                    output->append("SERVER_ERROR out of memory\r\n");
+                    break;
+            }
+        }
+    }else if(command == "touch" && (count == 3 || (count == 4 && noreply))){
+        int64_t exptime = 0;
+        if(!parseInt64(tokens[2], &exptime)){
+            output->append("CLIENT_ERROR invalid exptime argument\r\n");
+        }else{
+            appendReply(output, store_.touch(tokens[1], exptime) ? "TOUCHED\r\n" : "NOT_FOUND\r\n", noreply);
+        }
+    }else if(command == "flush_all" && count - noreply <= 2){
+        int64_t delay = 0;
+        if(count - noreply == 2 && !parseInt64(tokens[1], &delay)){
+            output->append("CLIENT_ERROR bad command line format\r\n");
+        }else{
+            store_.flushAll(delay);
+            appendReply(output, "OK\r\n", noreply);
+        }
+    }else if(command == "stats" && count == 1){
+        appendStats(output);
+    }else if(command == "version" && count == 1){
+        output->append("VERSION 1.6.0-mymuduo\r\n");
+    }else if(command == "verbosity" && count >= 2){
+        appendReply(output, "OK\r\n", noreply);
+    }else if(command == "quit"){
+        *close = true;
+    }else{
+        output->append("ERROR\r\n");
+    }
+    buff->retrieve(lineLen);
+    return true;
+}
+
+// <command> <key> <flags> <exptime> <bytes> [cas unique] [noreply]\r\n<data>\r\n
+bool MemcacheServer::processStorage(const StringPiece* tokens, int count, bool noreply, Context* context, Buffer* buff, size_t lineLen, bool* close){
+    Buffer* output = &context->output;
+    const StringPiece& command = tokens[0];
+    const bool isCas = command == "cas";
+    const int expected = (isCas ? 6 : 5) + noreply;
+    uint32_t flags = 0;
+    int64_t exptime = 0;
+    uint32_t bytes = 0;
+    uint64_t casUnique = 0;
+    if(count != expected || tokens[1].size() > MemcacheStore::kMaxKeyLen || !parseUint32(tokens[2], &flags) || !parseInt64(tokens[3], &exptime)
+        || !parseUint32(tokens[4], &bytes) || (isCas && !parseUint64(tokens[5], &casUnique))){
+        output->append("CLIENT_ERROR bad command line format\r\n");
+        buff->retrieve(lineLen);
+        // 客户端还会发送数据块，不能把数据当成命令解析，数据块的长度都不知道时只能关闭连接
+        if(count >= 5 && parseUint32(tokens[4], &bytes)){
+            context->swallow = static_cast<size_t>(bytes) + 2;
+        }else{
+            *close = true;
+        }
+        return true;
+    }
+    if(bytes > store_.maxItemSize()){
+        // 数据还没有收到，不放进inputBuffer_，收到以后直接丢弃
+        output->append("SERVER_ERROR object too large for cache\r\n");
+        buff->retrieve(lineLen);
+        context->swallow = static_cast<size_t>(bytes) + 2;
+        return true;
+    }
+    if(buff->readableBytes() < lineLen + bytes + 2){
+        return false;
+    }
+
+    const char* data = buff->peek() + lineLen;
+    if(data[bytes] != '\r' || data[bytes + 1] != '\n'){
+        output->append("CLIENT_ERROR bad data chunk\r\n");
+        buff->retrieve(lineLen + bytes + 2);
+        return true;
+    }
+
+    MemcacheStore::StoreMode mode = MemcacheStore::kSet;
+    if(command == "add"){
+        mode = MemcacheStore::kAdd;
+    }else if(command == "replace"){
+        mode = MemcacheStore::kReplace;
+    }else if(command == "append"){
+        mode = MemcacheStore::kAppend;
+    }else if(command == "prepend"){
+        mode = MemcacheStore::kPrepend;
+    }else if(isCas){
+        mode = MemcacheStore::kCas;
+    }
+    ++cmdSet_;
+    // 数据直接从inputBuffer_拷贝进slab
+    switch(store_.store(mode, tokens[1], flags, exptime, StringPiece(data, bytes), casUnique)){
+        case MemcacheStore::kStored:
+            appendReply(output, "STORED\r\n", noreply);
+            break;
+        case MemcacheStore::kNotStored:
+            appendReply(output, "NOT_STORED\r\n", noreply);
+            break;
+        case MemcacheStore::kExists:
+            appendReply(output, "EXISTS\r\n", noreply);
+            break;
+        case MemcacheStore::kNotFound:
+            appendReply(output, "NOT_FOUND\r\n", noreply);
+            break;
+        case MemcacheStore::kTooLarge:
+            output->append("SERVER_ERROR object too large for cache\r\n");
+            break;
+        case MemcacheStore::kOutOfMemory:
+            output->append("SERVER_ERROR out of memory storing object\r\n");
+            break;
+    }
+    buff->retrieve(lineLen + bytes + 2);
+    return true;
+}
+
+void MemcacheServer::appendStats(Buffer* output){
+    MemcacheStore::Stats stats = store_.stats();
+    char buf[128];
+    auto stat = [&](const char* name, unsigned long long value){
+        int n = snprintf(buf, sizeof(buf), "STAT %s %llu\r\n", name, value);
+        output->append(buf, n);
+    };
+    stat("pid", static_cast<unsigned long long>(::getpid()));
+    stat("uptime", static_cast<unsigned long long>(timeDifference(Timestamp::now(), startTime_)));
+    stat("time", static_cast<unsigned long long>(::time(nullptr)));
+    output->append("STAT version 1.6.0-mymuduo\r\n");
+    stat("pointer_size", sizeof(void*) * 8);
+    stat("curr_connections", currConnections_.load());
+    stat("total_connections", totalConnections_.load());
+    stat("cmd_get", stats.getHits + stats.getMisses);
+    stat("cmd_set", cmdSet_.load());
+    stat("get_hits", stats.getHits);
+    stat("get_misses", stats.getMisses);
+    stat("curr_items", stats.currItems);
+    stat("total_items", stats.totalItems);
+    stat("bytes", stats.bytes);
+    stat("evictions", stats.evictions);
+    stat("limit_maxbytes", static_cast<unsigned long long>(stats.pageLimit) * stats.pageSize);
+    stat("total_malloced", static_cast<unsigned long long>(stats.pagesUsed) * stats.pageSize);
+    output->append("END\r\n");
+}
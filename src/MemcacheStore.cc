@@ -0,0 +1,519 @@
+#include "MemcacheStore.h"
+#include "Logger.h"
+
+#include <mutex>
+#include <algorithm>
+#include <time.h>
+#include <string.h>
+
+// 数据项的头部，后面紧跟着key和数据，数据后面是\r\n，get时数据和\r\n一起拷贝
+struct MemcacheStore::Item{
+    Item* hnext;            // 哈希桶中的下一项
+    Item* prev;             // LRU链表，空闲时next是空闲链表的下一项
+    Item* next;
+    uint64_t cas;
+    size_t hash;
+    uint32_t exptime;       // unix时间，0表示不过期
+    uint32_t setTime;       // 保存的时间，flush_all按这个时间判断是否失效
+    uint32_t flags;
+    uint32_t nbytes;        // 数据长度，不包括\r\n
+    uint8_t nkey;
+    uint8_t slabClass;
+
+    char* key(){ return reinterpret_cast<char*>(this + 1); }
+    char* value(){ return key() + nkey; }
+};
+
+struct MemcacheStore::SlabClass{
+    Item* freeList;
+    Item* lruHead;          // 最近访问的
+    Item* lruTail;          // 最久没有访问的，内存不够时先淘汰
+};
+
+struct MemcacheStore::Shard{
+    std::mutex mutex;
+    std::vector<Item*> buckets;                     // 大小是2的幂
+    size_t count;
+    std::vector<SlabClass> classes;
+    std::vector<std::unique_ptr<char[]>> pages;
+    // 统计
+    size_t bytes;
+    uint64_t totalItems;
+    uint64_t getHits;
+    uint64_t getMisses;
+    uint64_t evictions;
+};
+
+static const size_t kMinChunkSize = 96;
+static const double kGrowthFactor = 1.25;
+static const size_t kInitialBuckets = 1024;
+// 页不在shard之间流动，每个shard至少要能分到这么多页，否则内存很小时有的shard一页都拿不到
+static const size_t kMinPagesPerShard = 4;
+static const int64_t kMaxRelativeExptime = 60*60*24*30;
+
+static uint32_t currentTime(){
+    return static_cast<uint32_t>(::time(nullptr));
+}
+
+// FNV-1a，key一般只有几十个字节
+static size_t hashKey(const StringPiece& key){
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < key.size(); ++i){
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(h);
+}
+
+static void appendDecimal(Buffer* buff, uint64_t value){
+    char digits[24];
+    char* p = digits + sizeof(digits);
+    do{
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }while(value != 0);
+    buff->append(p, digits + sizeof(digits) - p);
+}
+
+MemcacheStore::MemcacheStore(size_t memoryLimit, int shards, size_t maxItemSize)
+    : maxItemSize_(maxItemSize)
+    , pageSize_(std::max(maxItemSize, static_cast<size_t>(1024*1024)))
+    , pageLimit_(std::max(memoryLimit / pageSize_, static_cast<size_t>(1)))
+    , pagesUsed_(0)
+    , nextCas_(1)
+    , flushTime_(0)
+    , flushCas_(0)
+{
+    // chunk大小按kGrowthFactor增长，按8字节对齐，最大的class一页只有一个chunk
+    size_t size = kMinChunkSize;
+    while(size < pageSize_ / kGrowthFactor){
+        classSizes_.push_back(size);
+        size = (static_cast<size_t>(size * kGrowthFactor) + 7) & ~static_cast<size_t>(7);
+    }
+    classSizes_.push_back(pageSize_);
+    if(classSizes_.size() > 255){
+        LOG_FATAL("MemcacheStore too many slab classes: %zu \n", classSizes_.size());
+    }
+
+    shards = static_cast<int>(std::min(static_cast<size_t>(std::max(shards, 1)), std::max(pageLimit_ / kMinPagesPerShard, static_cast<size_t>(1))));
+    for(int i = 0; i < shards; ++i){
+        std::unique_ptr<Shard> shard(new Shard);
+        shard->buckets.assign(kInitialBuckets, nullptr);
+        shard->count = 0;
+        SlabClass empty = { nullptr, nullptr, nullptr };
+        shard->classes.assign(classSizes_.size(), empty);
+        shard->bytes = 0;
+        shard->totalItems = 0;
+        shard->getHits = 0;
+        shard->getMisses = 0;
+        shard->evictions = 0;
+        shards_.push_back(std::move(shard));
+    }
+}
+
+MemcacheStore::~MemcacheStore() = default;
+
+int MemcacheStore::classFor(size_t itemSize) const {
+    return static_cast<int>(std::lower_bound(classSizes_.begin(), classSizes_.end(), itemSize) - classSizes_.begin());
+}
+
+bool MemcacheStore::expired(const Item* item, uint32_t now) const {
+    if(item->exptime != 0 && item->exptime <= now){
+        return true;
+    }
+    if(item->cas < flushCas_.load(std::memory_order_relaxed)){
+        return true;
+    }
+    uint32_t flushTime = flushTime_.load(std::memory_order_relaxed);
+    return flushTime != 0 && flushTime <= now && item->setTime < flushTime;
+}
+
+uint32_t MemcacheStore::convertExptime(int64_t exptime, uint32_t now) const {
+    if(exptime == 0){
+        return 0;
+    }
+    if(exptime < 0){
+        return 1;   // 已经过期
+    }
+    if(exptime <= kMaxRelativeExptime){
+        return now + static_cast<uint32_t>(exptime);
+    }
+    return static_cast<uint32_t>(exptime);
+}
+
+void MemcacheStore::lruRemove(Shard* shard, Item* item){
+    SlabClass& sc = shard->classes[item->slabClass];
+    if(item->prev){
+        item->prev->next = item->next;
+    }else{
+        sc.lruHead = item->next;
+    }
+    if(item->next){
+        item->next->prev = item->prev;
+    }else{
+        sc.lruTail = item->prev;
+    }
+    item->prev = item->next = nullptr;
+}
+
+void MemcacheStore::lruPushFront(Shard* shard, Item* item){
+    SlabClass& sc = shard->classes[item->slabClass];
+    item->prev = nullptr;
+    item->next = sc.lruHead;
+    if(sc.lruHead){
+        sc.lruHead->prev = item;
+    }else{
+        sc.lruTail = item;
+    }
+    sc.lruHead = item;
+}
+
+void MemcacheStore::linkItem(Shard* shard, Item* item){
+    if(shard->count >= shard->buckets.size() + shard->buckets.size() / 2){
+        // 扩容，链表中的项按保存的哈希值重新分配
+        std::vector<Item*> buckets(shard->buckets.size() * 2, nullptr);
+        const size_t mask = buckets.size() - 1;
+        for(Item* head : shard->buckets){
+            while(head){
+                Item* next = head->hnext;
+                Item*& bucket = buckets[head->hash & mask];
+                head->hnext = bucket;
+                bucket = head;
+                head = next;
+            }
+        }
+        shard->buckets.swap(buckets);
+    }
+    Item*& bucket = shard->buckets[item->hash & (shard->buckets.size() - 1)];
+    item->hnext = bucket;
+    bucket = item;
+    ++shard->count;
+    shard->bytes += sizeof(Item) + item->nkey + item->nbytes + 2;
+    ++shard->totalItems;
+    lruPushFront(shard, item);
+}
+
+void MemcacheStore::unlinkItem(Shard* shard, Item* item){
+    Item** pp = &shard->buckets[item->hash & (shard->buckets.size() - 1)];
+    while(*pp != item){
+        pp = &(*pp)->hnext;
+    }
+    *pp = item->hnext;
+    item->hnext = nullptr;
+    --shard->count;
+    shard->bytes -= sizeof(Item) + item->nkey + item->nbytes + 2;
+    lruRemove(shard, item);
+}
+
+void MemcacheStore::freeItem(Shard* shard, Item* item){
+    SlabClass& sc = shard->classes[item->slabClass];
+    item->next = sc.freeList;
+    sc.freeList = item;
+}
+
+// 从共享的预算中拿一页，切成这个class的chunk放进空闲链表
+bool MemcacheStore::grabPage(Shard* shard, int classId){
+    if(pagesUsed_.fetch_add(1) >= pageLimit_){
+        --pagesUsed_;
+        return false;
+    }
+    const size_t chunkSize = classSizes_[classId];
+    std::unique_ptr<char[]> page(new char[pageSize_]);
+    SlabClass& sc = shard->classes[classId];
+    for(size_t offset = 0; offset + chunkSize <= pageSize_; offset += chunkSize){
+        Item* item = reinterpret_cast<Item*>(page.get() + offset);
+        item->slabClass = static_cast<uint8_t>(classId);
+        item->next = sc.freeList;
+        sc.freeList = item;
+    }
+    shard->pages.push_back(std::move(page));
+    return true;
+}
+
+MemcacheStore::Item* MemcacheStore::allocItem(Shard* shard, size_t itemSize, uint32_t now){
+    const int classId = classFor(itemSize);
+    SlabClass& sc = shard->classes[classId];
+    if(sc.freeList == nullptr && !grabPage(shard, classId)){
+        // 没有内存了，淘汰这个class中最久没有访问的数据项
+        Item* victim = sc.lruTail;
+        if(victim == nullptr){
+            return nullptr;
+        }
+        if(!expired(victim, now)){
+            ++shard->evictions;
+        }
+        unlinkItem(shard, victim);
+        freeItem(shard, victim);
+    }
+    Item* item = sc.freeList;
+    sc.freeList = item->next;
+    item->hnext = item->prev = item->next = nullptr;
+    item->slabClass = static_cast<uint8_t>(classId);
+    return item;
+}
+
+// 过期的数据项在查找时顺便释放
+MemcacheStore::Item* MemcacheStore::find(Shard* shard, size_t hash, const StringPiece& key, uint32_t now){
+    Item* item = shard->buckets[hash & (shard->buckets.size() - 1)];
+    while(item){
+        if(item->hash == hash && item->nkey == key.size() && memcmp(item->key(), key.data(), key.size()) == 0){
+            if(expired(item, now)){
+                unlinkItem(shard, item);
+                freeItem(shard, item);
+                return nullptr;
+            }
+            return item;
+        }
+        item = item->hnext;
+    }
+    return nullptr;
+}
+
+bool MemcacheStore::get(const StringPiece& key, bool withCas, Buffer* output){
+    const size_t hash = hashKey(key);
+    Shard* shard = shardFor(hash >> 32);
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    Item* item = find(shard, hash, key, currentTime());
+    if(item == nullptr){
+        ++shard->getMisses;
+        return false;
+    }
+    ++shard->getHits;
+    lruRemove(shard, item);
+    lruPushFront(shard, item);
+
+    output->append("VALUE ", 6);
+    output->append(item->key(), item->nkey);
+    output->append(" ", 1);
+    appendDecimal(output, item->flags);
+    output->append(" ", 1);
+    appendDecimal(output, item->nbytes);
+    if(withCas){
+        output->append(" ", 1);
+        appendDecimal(output, item->cas);
+    }
+    output->append("\r\n", 2);
+    output->append(item->value(), item->nbytes + 2);
+    return true;
+}
+
+MemcacheStore::StoreResult MemcacheStore::store(StoreMode mode, const StringPiece& key, uint32_t flags, int64_t exptime, const StringPiece& value, uint64_t casUnique){
+    if(sizeof(Item) + key.size() + value.size() + 2 > maxItemSize_){
+        return kTooLarge;
+    }
+    const size_t hash = hashKey(key);
+    Shard* shard = shardFor(hash >> 32);
+    const uint32_t now = currentTime();
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    Item* old = find(shard, hash, key, now);
+    switch(mode){
+        case kAdd:
+            if(old){
+                // 和memcached一样，add失败也算一次访问
+                lruRemove(shard, old);
+                lruPushFront(shard, old);
+                return kNotStored;
+            }
+            break;
+        case kReplace:
+        case kAppend:
+        case kPrepend:
+            if(old == nullptr){
+                return kNotStored;
+            }
+            break;
+        case kCas:
+            if(old == nullptr){
+                return kNotFound;
+            }
+            if(old->cas != casUnique){
+                return kExists;
+            }
+            break;
+        case kSet:
+            break;
+    }
+
+    size_t nbytes = value.size();
+    if(mode == kAppend || mode == kPrepend){
+        nbytes += old->nbytes;
+        if(sizeof(Item) + key.size() + nbytes + 2 > maxItemSize_){
+            return kTooLarge;
+        }
+    }
+    // 分配时可能淘汰同一个class的数据项，先把旧的数据项从LRU中摘下来，避免被淘汰
+    if(old){
+        lruRemove(shard, old);
+    }
+    Item* item = allocItem(shard, sizeof(Item) + key.size() + nbytes + 2, now);
+    if(item == nullptr){
+        if(old){
+            lruPushFront(shard, old);
+        }
+        return kOutOfMemory;
+    }
+
+    item->hash = hash;
+    item->nkey = static_cast<uint8_t>(key.size());
+    item->nbytes = static_cast<uint32_t>(nbytes);
+    item->cas = nextCas_++;
+    item->setTime = now;
+    memcpy(item->key(), key.data(), key.size());
+    char* data = item->value();
+    if(mode == kAppend){
+        memcpy(data, old->value(), old->nbytes);
+        memcpy(data + old->nbytes, value.data(), value.size());
+    }else if(mode == kPrepend){
+        memcpy(data, value.data(), value.size());
+        memcpy(data + value.size(), old->value(), old->nbytes);
+    }else{
+        memcpy(data, value.data(), value.size());
+    }
+    memcpy(data + nbytes, "\r\n", 2);
+    if(mode == kAppend || mode == kPrepend){
+        // append、prepend不改变flags和过期时间
+        item->flags = old->flags;
+        item->exptime = old->exptime;
+    }else{
+        item->flags = flags;
+        item->exptime = convertExptime(exptime, now);
+    }
+
+    if(old){
+        // old已经不在LRU中，unlinkItem中的lruRemove要求它在链表中，先放回去
+        lruPushFront(shard, old);
+        unlinkItem(shard, old);
+        freeItem(shard, old);
+    }
+    linkItem(shard, item);
+    return kStored;
+}
+
+bool MemcacheStore::remove(const StringPiece& key){
+    const size_t hash = hashKey(key);
+    Shard* shard = shardFor(hash >> 32);
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    Item* item = find(shard, hash, key, currentTime());
+    if(item == nullptr){
+        return false;
+    }
+    unlinkItem(shard, item);
+    freeItem(shard, item);
+    return true;
+}
+
+MemcacheStore::DeltaResult MemcacheStore::delta(const StringPiece& key, bool incr, uint64_t amount, uint64_t* result){
+    const size_t hash = hashKey(key);
+    Shard* shard = shardFor(hash >> 32);
+    const uint32_t now = currentTime();
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    Item* item = find(shard, hash, key, now);
+    if(item == nullptr){
+        return kDeltaNotFound;
+    }
+    // 最多20位十进制数
+    if(item->nbytes == 0 || item->nbytes > 20){
+        return kDeltaNonNumeric;
+    }
+    uint64_t value = 0;
+    const char* digits = item->value();
+    for(uint32_t i = 0; i < item->nbytes; ++i){
+        if(digits[i] < '0' || digits[i] > '9'){
+            return kDeltaNonNumeric;
+        }
+        uint64_t next = value * 10 + (digits[i] - '0');
+        if(next / 10 != value){
+            return kDeltaNonNumeric;
+        }
+        value = next;
+    }
+    if(incr){
+        value += amount;
+    }else{
+        value = value > amount ? value - amount : 0;
+    }
+    *result = value;
+
+    char digitsBuf[24];
+    char* p = digitsBuf + sizeof(digitsBuf);
+    do{
+        *--p = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }while(value != 0);
+    const size_t len = digitsBuf + sizeof(digitsBuf) - p;
+
+    if(sizeof(Item) + item->nkey + len + 2 <= classSizes_[item->slabClass]){
+        // 原来的chunk放得下，直接改写
+        shard->bytes = shard->bytes - item->nbytes + len;
+    }else{
+        // 换一个更大的chunk
+        lruRemove(shard, item);
+        Item* bigger = allocItem(shard, sizeof(Item) + item->nkey + len + 2, now);
+        if(bigger == nullptr){
+            lruPushFront(shard, item);
+            return kDeltaOutOfMemory;
+        }
+        bigger->hash = item->hash;
+        bigger->nkey = item->nkey;
+        bigger->flags = item->flags;
+        bigger->exptime = item->exptime;
+        bigger->setTime = item->setTime;
+        bigger->nbytes = 0;
+        memcpy(bigger->key(), item->key(), item->nkey);
+        lruPushFront(shard, item);
+        unlinkItem(shard, item);
+        freeItem(shard, item);
+        item = bigger;
+        linkItem(shard, item);
+        shard->bytes += len;
+    }
+    item->nbytes = static_cast<uint32_t>(len);
+    item->cas = nextCas_++;
+    memcpy(item->value(), p, len);
+    memcpy(item->value() + len, "\r\n", 2);
+    return kDeltaOk;
+}
+
+bool MemcacheStore::touch(const StringPiece& key, int64_t exptime){
+    const size_t hash = hashKey(key);
+    Shard* shard = shardFor(hash >> 32);
+    const uint32_t now = currentTime();
+    std::unique_lock<std::mutex> lock(shard->mutex);
+    Item* item = find(shard, hash, key, now);
+    if(item == nullptr){
+        return false;
+    }
+    item->exptime = convertExptime(exptime, now);
+    lruRemove(shard, item);
+    lruPushFront(shard, item);
+    return true;
+}
+
+void MemcacheStore::flushAll(int64_t delay){
+    // 不遍历数据项，查找和淘汰时判断是否失效
+    // 立即flush按cas值判断，同一秒内flush之后保存的数据项仍然有效；延迟flush只能按保存时间判断
+    if(delay <= 0){
+        flushTime_ = 0;
+        flushCas_ = nextCas_.load();
+        return;
+    }
+    flushTime_ = static_cast<uint32_t>(currentTime() + delay);
+}
+
+MemcacheStore::Stats MemcacheStore::stats(){
+    Stats result;
+    memset(&result, 0, sizeof(result));
+    for(const std::unique_ptr<Shard>& shard : shards_){
+        std::unique_lock<std::mutex> lock(shard->mutex);
+        result.currItems += shard->count;
+        result.totalItems += shard->totalItems;
+        result.bytes += shard->bytes;
+        result.getHits += shard->getHits;
+        result.getMisses += shard->getMisses;
+        result.evictions += shard->evictions;
+    }
+    result.pagesUsed = std::min(pagesUsed_.load(), pageLimit_);
+    result.pageLimit = pageLimit_;
+    result.pageSize = pageSize_;
+    return result;
+}
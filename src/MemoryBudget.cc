@@ -0,0 +1,56 @@
+#include "MemoryBudget.h"
+#include "TcpConnection.h"
+
+MemoryBudget::MemoryBudget(size_t limit, Policy policy)
+    : limit_(limit)
+    , resumeThreshold_(limit - limit / 10)  // 降到预算的90%以下才恢复
+    , policy_(policy)
+    , usage_(0)
+    , connections_(0)
+    , rejectedSends_(0)
+    , closedConnections_(0)
+    , pausedConnections_(0)
+    , hasPaused_(false)
+{}
+
+MemoryBudget::~MemoryBudget(){}
+
+size_t MemoryBudget::fairShare() const{
+    size_t n = connections_;
+    return n == 0 ? limit_ : limit_ / n;
+}
+
+void MemoryBudget::charge(size_t bytes){
+    usage_ += bytes;
+}
+
+void MemoryBudget::release(size_t bytes){
+    size_t now = (usage_ -= bytes);
+    if(hasPaused_ && now < resumeThreshold_){
+        resumePausedConnections();
+    }
+}
+
+void MemoryBudget::addPausedConnection(const std::weak_ptr<TcpConnection>& conn){
+    std::unique_lock<std::mutex> lock(mutex_);
+    paused_.push_back(conn);
+    hasPaused_ = true;
+    ++pausedConnections_;
+}
+
+void MemoryBudget::resumePausedConnections(){
+    std::vector<std::weak_ptr<TcpConnection>> paused;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        paused.swap(paused_);
+        hasPaused_ = false;
+    }
+
+    for(const std::weak_ptr<TcpConnection>& weakConn : paused){
+        TcpConnectionPtr conn = weakConn.lock();
+        if(conn){
+            // 连接可能属于其他的subloop，恢复读需要在连接所在的loop中执行
+            conn->resumeReadingByBudget();
+        }
+    }
+}
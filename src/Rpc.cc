@@ -0,0 +1,46 @@
+#include "Rpc.h"
+
+namespace Rpc{
+    const char* statusString(int status){
+        switch(status){
+            case kOk: return "ok";
+            case kNoSuchMethod: return "no such method";
+            case kBadRequest: return "bad request";
+            case kDeadlineExceeded: return "deadline exceeded";
+            case kCancelled: return "cancelled";
+            case kConnectionClosed: return "connection closed";
+            case kInternalError: return "internal error";
+            default: return status >= kUserError ? "user error" : "unknown";
+        }
+    }
+
+    size_t beginFrame(Buffer* buff, FrameKind kind, uint64_t id){
+        size_t frameStart = buff->readableBytes();
+        buff->appendInt32(0);
+        buff->appendInt8(static_cast<int8_t>(kind));
+        buff->appendInt64(static_cast<int64_t>(id));
+        return frameStart;
+    }
+
+    void endFrame(Buffer* buff, size_t frameStart){
+        // 帧开始以后写入的数据可能导致Buffer扩容，按偏移重新计算长度头的位置
+        size_t frameLen = buff->readableBytes() - frameStart;
+        char* header = buff->beginWrite() - frameLen;
+        uint32_t be32 = htobe32(static_cast<uint32_t>(frameLen - kLengthLen));
+        memcpy(header, &be32, sizeof(be32));
+    }
+
+    void appendRequest(Buffer* buff, uint64_t id, const StringPiece& method, uint32_t timeoutMs, const StringPiece& request){
+        size_t frameStart = beginFrame(buff, kRequest, id);
+        buff->appendInt32(static_cast<int32_t>(timeoutMs));
+        buff->appendInt8(static_cast<int8_t>(method.size()));
+        buff->append(method);
+        buff->append(request);
+        endFrame(buff, frameStart);
+    }
+
+    void appendCancel(Buffer* buff, uint64_t id){
+        size_t frameStart = beginFrame(buff, kCancel, id);
+        endFrame(buff, frameStart);
+    }
+}
@@ -0,0 +1,163 @@
+#include "RpcClient.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <vector>
+#include <math.h>
+
+// 超时时间按毫秒发给服务端，不足1毫秒按1毫秒
+static uint32_t timeoutToMs(double timeout){
+    if(timeout <= 0){
+        return 0;
+    }
+    double ms = ceil(timeout * 1000);
+    return ms > 0xFFFFFFFF ? 0xFFFFFFFF : static_cast<uint32_t>(ms);
+}
+
+RpcClient::RpcClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& name)
+    : loop_(loop)
+    , client_(loop, serverAddr, name)
+    , codec_(LengthHeaderCodec::FrameBatchCallback(std::bind(&RpcClient::onFrames, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4)))
+    , nextId_(1)
+    , flushQueued_(false)
+{
+    client_.setConnectionCallback(std::bind(&RpcClient::onConnection, this, std::placeholders::_1));
+    client_.setMessageCallback(codec_.messageCallback());
+}
+
+RpcClient::~RpcClient(){
+    // TcpClient析构时不会回调onConnection，还没有完成的调用在这里回调，不能悄悄丢掉
+    std::unordered_map<uint64_t, PendingCall> pending;
+    pending.swap(pending_);
+    for(auto& entry : pending){
+        if(entry.second.hasTimer){
+            loop_->cancel(entry.second.timer);
+        }
+    }
+    for(auto& entry : pending){
+        entry.second.cb(Rpc::kConnectionClosed, StringPiece());
+    }
+}
+
+uint64_t RpcClient::call(const StringPiece& method, const StringPiece& request, double timeout, const ResponseCallback& cb){
+    uint64_t id = nextId_++;
+    if(method.size() > Rpc::kMaxMethodLen){
+        LOG_ERROR("RpcClient::call method name too long: %s \n", method.as_string().c_str());
+        loop_->queueInLoop(std::bind(cb, static_cast<int>(Rpc::kBadRequest), StringPiece()));
+        return id;
+    }
+    if(loop_->isInLoopThread()){
+        // 直接写进发送缓冲区，不经过临时的Buffer
+        addPending(id, timeout, cb);
+        Rpc::appendRequest(&output_, id, method, timeoutToMs(timeout), request);
+        scheduleFlush();
+    }else{
+        Buffer frame(Rpc::kCancelFrameLen + 5 + method.size() + request.size());
+        Rpc::appendRequest(&frame, id, method, timeoutToMs(timeout), request);
+        loop_->runInLoop(std::bind(&RpcClient::callInLoop, this, id, frame.retrieveAllAsString(), timeout, cb));
+    }
+    return id;
+}
+
+void RpcClient::callInLoop(uint64_t id, const std::string& frame, double timeout, const ResponseCallback& cb){
+    addPending(id, timeout, cb);
+    output_.append(frame.data(), frame.size());
+    scheduleFlush();
+}
+
+void RpcClient::addPending(uint64_t id, double timeout, const ResponseCallback& cb){
+    PendingCall& call = pending_[id];
+    call.cb = cb;
+    call.hasTimer = timeout > 0;
+    if(call.hasTimer){
+        call.timer = loop_->runAfter(timeout, std::bind(&RpcClient::cancelInLoop, this, id, static_cast<int>(Rpc::kDeadlineExceeded)));
+    }
+}
+
+// 这一轮事件处理中的所有请求在处理完以后一次发送
+void RpcClient::scheduleFlush(){
+    if(!flushQueued_){
+        flushQueued_ = true;
+        loop_->queueInLoop(std::bind(&RpcClient::flush, this));
+    }
+}
+
+void RpcClient::flush(){
+    flushQueued_ = false;
+    if(conn_ && output_.readableBytes() > 0){
+        conn_->send(&output_);
+    }
+}
+
+bool RpcClient::takePending(uint64_t id, ResponseCallback* cb){
+    auto it = pending_.find(id);
+    if(it == pending_.end()){
+        return false;
+    }
+    if(it->second.hasTimer){
+        loop_->cancel(it->second.timer);
+    }
+    cb->swap(it->second.cb);
+    pending_.erase(it);
+    return true;
+}
+
+void RpcClient::cancel(uint64_t id){
+    loop_->runInLoop(std::bind(&RpcClient::cancelInLoop, this, id, static_cast<int>(Rpc::kCancelled)));
+}
+
+// 主动取消或者超时，通知服务端不用再处理了
+void RpcClient::cancelInLoop(uint64_t id, int status){
+    ResponseCallback cb;
+    if(takePending(id, &cb)){
+        Rpc::appendCancel(&output_, id);
+        scheduleFlush();
+        cb(status, StringPiece());
+    }
+}
+
+void RpcClient::onConnection(const TcpConnectionPtr& conn){
+    if(conn->connected()){
+        conn_ = conn;
+        flush();
+        return;
+    }
+    // 连接断开，已经发出去的请求不会再有响应；发送缓冲区中的都是这些调用的请求，一起丢弃
+    conn_.reset();
+    output_.retrieveAll();
+    std::vector<ResponseCallback> callbacks;
+    callbacks.reserve(pending_.size());
+    for(auto& entry : pending_){
+        if(entry.second.hasTimer){
+            loop_->cancel(entry.second.timer);
+        }
+        callbacks.push_back(std::move(entry.second.cb));
+    }
+    pending_.clear();
+    for(const ResponseCallback& cb : callbacks){
+        cb(Rpc::kConnectionClosed, StringPiece());
+    }
+}
+
+void RpcClient::onFrames(const TcpConnectionPtr& conn, const StringPiece* frames, int count, Timestamp){
+    for(int i = 0; i < count; ++i){
+        Rpc::Reader reader(frames[i]);
+        uint8_t kind = 0;
+        uint64_t id = 0;
+        uint8_t status = 0;
+        reader.field(kind);
+        reader.field(id);
+        reader.field(status);
+        if(!reader.ok() || kind != Rpc::kResponse){
+            LOG_ERROR("RpcClient::onFrames [%s] malformed frame \n", conn->name().c_str());
+            conn->forceClose();
+            return;
+        }
+        // 已经超时或者取消的调用，响应直接丢弃
+        ResponseCallback cb;
+        if(takePending(id, &cb)){
+            cb(status, reader.remaining());
+        }
+    }
+}
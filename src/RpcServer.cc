@@ -0,0 +1,239 @@
+#include "RpcServer.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <vector>
+
+// 每条连接的状态，保存在TcpConnection的context中，只在连接所在的loop线程中访问
+struct RpcServerContext{
+    Buffer output;                                          // 同步方法的响应，一批请求处理完以后一次发送
+    std::unordered_map<uint64_t, RpcCallPtr> calls;         // 还没有回复的异步调用，按id取消
+};
+
+RpcCall::RpcCall(const TcpConnectionPtr& conn, uint64_t id, Timestamp deadline)
+    : conn_(conn)
+    , loop_(conn->getLoop())
+    , id_(id)
+    , deadline_(deadline)
+    , finished_(false)
+    , cancelled_(false)
+    , hasTimer_(false)
+{}
+
+double RpcCall::remainingSeconds() const {
+    if(!deadline_.valid()){
+        return 0;
+    }
+    double remaining = timeDifference(deadline_, Timestamp::now());
+    return remaining > 1e-6 ? remaining : 1e-6;
+}
+
+void RpcCall::setCancelCallback(const std::function<void()>& cb){
+    if(cancelled_){
+        cb();
+    }else{
+        cancelCallback_ = cb;
+    }
+}
+
+void RpcCall::reply(const StringPiece& response, int status){
+    if(finished_.exchange(true)){
+        return;
+    }
+    Buffer frame(Rpc::kResponseHeaderLen + response.size());
+    size_t frameStart = Rpc::beginFrame(&frame, Rpc::kResponse, id_);
+    frame.appendInt8(static_cast<int8_t>(status));
+    frame.append(response);
+    Rpc::endFrame(&frame, frameStart);
+    sendReply(&frame);
+}
+
+void RpcCall::sendReply(Buffer* frame){
+    TcpConnectionPtr conn = conn_.lock();
+    if(conn){
+        // 不在loop线程时send(Buffer*)把frame交换给loop线程，不拷贝
+        conn->send(frame);
+        loop_->runInLoop(std::bind(&RpcCall::finishInLoop, shared_from_this()));
+    }
+}
+
+// 从连接的调用表中删除，取消截止时间的定时器
+void RpcCall::finishInLoop(){
+    if(hasTimer_){
+        loop_->cancel(timer_);
+        hasTimer_ = false;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if(conn){
+        RpcServerContext* context = static_cast<RpcServerContext*>(conn->getContext().get());
+        if(context != nullptr){
+            auto it = context->calls.find(id_);
+            if(it != context->calls.end() && it->second.get() == this){
+                context->calls.erase(it);
+            }
+        }
+    }
+}
+
+void RpcCall::cancelInLoop(){
+    if(hasTimer_){
+        loop_->cancel(timer_);
+        hasTimer_ = false;
+    }
+    if(finished_.exchange(true)){
+        return;
+    }
+    cancelled_ = true;
+    if(cancelCallback_){
+        std::function<void()> cb;
+        cb.swap(cancelCallback_);
+        cb();
+    }
+}
+
+void RpcCall::onDeadline(const std::weak_ptr<RpcCall>& weakCall){
+    RpcCallPtr call = weakCall.lock();
+    if(call){
+        call->hasTimer_ = false;
+        call->finishInLoop();
+        call->cancelInLoop();
+    }
+}
+
+RpcServer::RpcServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , codec_(LengthHeaderCodec::FrameBatchCallback(std::bind(&RpcServer::onFrames, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, std::placeholders::_4)))
+{
+    server_.setConnectionCallback(std::bind(&RpcServer::onConnection, this, std::placeholders::_1));
+    server_.setMessageCallback(codec_.messageCallback());
+}
+
+void RpcServer::registerMethod(const std::string& method, const SyncHandler& handler){
+    if(method.size() > Rpc::kMaxMethodLen){
+        LOG_FATAL("RpcServer::registerMethod method name too long: %s \n", method.c_str());
+    }
+    Method& entry = methods_[method];
+    entry.sync = handler;
+    entry.async = AsyncHandler();
+}
+
+void RpcServer::registerAsyncMethod(const std::string& method, const AsyncHandler& handler){
+    if(method.size() > Rpc::kMaxMethodLen){
+        LOG_FATAL("RpcServer::registerAsyncMethod method name too long: %s \n", method.c_str());
+    }
+    Method& entry = methods_[method];
+    entry.sync = SyncHandler();
+    entry.async = handler;
+}
+
+void RpcServer::start(){
+    LOG_INFO("RpcServer[%s] starts listening on %s \n", server_.name().c_str(), server_.ipPort().c_str());
+    server_.start();
+}
+
+void RpcServer::onConnection(const TcpConnectionPtr& conn){
+    if(conn->connected()){
+        conn->setContext(std::make_shared<RpcServerContext>());
+        return;
+    }
+    std::shared_ptr<void> holder = conn->getContext();
+    RpcServerContext* context = static_cast<RpcServerContext*>(holder.get());
+    if(context == nullptr){
+        return;
+    }
+    // 连接断开，取消所有还没有回复的调用；先取出来，取消回调中可能会访问调用表
+    std::vector<RpcCallPtr> calls;
+    calls.reserve(context->calls.size());
+    for(auto& entry : context->calls){
+        calls.push_back(entry.second);
+    }
+    context->calls.clear();
+    for(const RpcCallPtr& call : calls){
+        call->cancelInLoop();
+    }
+}
+
+void RpcServer::onFrames(const TcpConnectionPtr& conn, const StringPiece* frames, int count, Timestamp receiveTime){
+    std::shared_ptr<void> holder = conn->getContext();
+    RpcServerContext* context = static_cast<RpcServerContext*>(holder.get());
+    if(context == nullptr || !conn->connected()){
+        return;
+    }
+    Buffer* output = &context->output;
+    for(int i = 0; i < count; ++i){
+        Rpc::Reader reader(frames[i]);
+        uint8_t kind = 0;
+        uint64_t id = 0;
+        reader.field(kind);
+        reader.field(id);
+        bool ok = reader.ok();
+        if(ok && kind == Rpc::kRequest){
+            ok = handleRequest(conn, reader, id, output, receiveTime);
+        }else if(ok && kind == Rpc::kCancel){
+            auto it = context->calls.find(id);
+            if(it != context->calls.end()){
+                RpcCallPtr call = it->second;
+                context->calls.erase(it);
+                call->cancelInLoop();
+            }
+        }else{
+            ok = false;
+        }
+        if(!ok){
+            LOG_ERROR("RpcServer::onFrames [%s] malformed frame \n", conn->name().c_str());
+            output->retrieveAll();
+            conn->forceClose();
+            return;
+        }
+    }
+    if(output->readableBytes() > 0){
+        conn->send(output);
+    }
+}
+
+bool RpcServer::handleRequest(const TcpConnectionPtr& conn, Rpc::Reader& reader, uint64_t id, Buffer* output, Timestamp receiveTime){
+    uint32_t timeoutMs = 0;
+    uint8_t methodLen = 0;
+    reader.field(timeoutMs);
+    reader.field(methodLen);
+    StringPiece rest = reader.remaining();
+    if(!reader.ok() || rest.size() < methodLen){
+        return false;
+    }
+    StringPiece method(rest.data(), methodLen);
+    StringPiece request(rest.data() + methodLen, rest.size() - methodLen);
+
+    auto it = methods_.find(method.as_string());
+    if(it == methods_.end()){
+        size_t frameStart = Rpc::beginFrame(output, Rpc::kResponse, id);
+        output->appendInt8(Rpc::kNoSuchMethod);
+        Rpc::endFrame(output, frameStart);
+        return true;
+    }
+
+    const Method& handler = it->second;
+    if(handler.sync){
+        // 响应消息直接写在发送缓冲区中帧头的后面，写完以后回填状态码和长度
+        size_t frameStart = Rpc::beginFrame(output, Rpc::kResponse, id);
+        output->appendInt8(Rpc::kOk);
+        int status = handler.sync(request, output);
+        if(status != Rpc::kOk){
+            output->unwrite(output->readableBytes() - frameStart - Rpc::kResponseHeaderLen);
+            *(output->beginWrite() - 1) = static_cast<char>(status);
+        }
+        Rpc::endFrame(output, frameStart);
+        return true;
+    }
+
+    RpcServerContext* context = static_cast<RpcServerContext*>(conn->getContext().get());
+    Timestamp deadline = timeoutMs > 0 ? addTime(receiveTime, timeoutMs / 1000.0) : Timestamp::invalid();
+    RpcCallPtr call = std::make_shared<RpcCall>(conn, id, deadline);
+    context->calls[id] = call;
+    if(timeoutMs > 0){
+        call->timer_ = conn->getLoop()->runAt(deadline, std::bind(&RpcCall::onDeadline, std::weak_ptr<RpcCall>(call)));
+        call->hasTimer_ = true;
+    }
+    handler.async(request, call);
+    return true;
+}
@@ -0,0 +1,134 @@
+#include "SimdSearch.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SIMD 1
+#endif
+
+namespace SimdSearch{
+    // 标量实现：memchr找到pattern的首字节，再比较剩下的字节
+    static const char* findScalar(const char* begin, const char* end, const char* pattern, size_t len){
+        if(len == 0){
+            return begin;
+        }
+        if(static_cast<size_t>(end - begin) < len){
+            return nullptr;
+        }
+        const char* last = end - len;  // pattern可能出现的最后一个起始位置
+        const char* p = begin;
+        while(p <= last){
+            p = static_cast<const char*>(memchr(p, pattern[0], last - p + 1));
+            if(p == nullptr){
+                return nullptr;
+            }
+            if(memcmp(p + 1, pattern + 1, len - 1) == 0){
+                return p;
+            }
+            ++p;
+        }
+        return nullptr;
+    }
+
+#ifdef MYMUDUO_X86_SIMD
+    // 同时比较每个候选位置的首字节和尾字节，两者都相等的位置才需要memcmp，
+    // \r\n这类短分隔符只需要比较两个字节，基本不会走到memcmp
+    static const char* findSse2(const char* begin, const char* end, const char* pattern, size_t len){
+        if(len < 2 || static_cast<size_t>(end - begin) < len){
+            return findScalar(begin, end, pattern, len);
+        }
+        const __m128i first = _mm_set1_epi8(pattern[0]);
+        const __m128i lastByte = _mm_set1_epi8(pattern[len - 1]);
+        const char* last = end - len;
+        const char* p = begin;
+        for(; p + 16 <= last + 1; p += 16){
+            __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + len - 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, lastByte)));
+            while(mask != 0){
+                int bit = __builtin_ctz(mask);
+                if(memcmp(p + bit + 1, pattern + 1, len - 2) == 0){
+                    return p + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        // 剩下不足16个候选位置
+        return findScalar(p, end, pattern, len);
+    }
+
+    __attribute__((target("avx2")))
+    static const char* findAvx2(const char* begin, const char* end, const char* pattern, size_t len){
+        if(len < 2 || static_cast<size_t>(end - begin) < len){
+            return findScalar(begin, end, pattern, len);
+        }
+        const __m256i first = _mm256_set1_epi8(pattern[0]);
+        const __m256i lastByte = _mm256_set1_epi8(pattern[len - 1]);
+        const char* last = end - len;
+        const char* p = begin;
+        for(; p + 32 <= last + 1; p += 32){
+            __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + len - 1));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, lastByte))));
+            while(mask != 0){
+                int bit = __builtin_ctz(mask);
+                if(memcmp(p + bit + 1, pattern + 1, len - 2) == 0){
+                    return p + bit;
+                }
+                mask &= mask - 1;
+            }
+        }
+        return findSse2(p, end, pattern, len);
+    }
+#endif
+
+    static SearchFunc selectImpl(const char** name){
+#ifdef MYMUDUO_X86_SIMD
+        // 可能在全局对象初始化阶段调用，需要先初始化CPU特性信息
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            *name = "avx2";
+            return findAvx2;
+        }
+        *name = "sse2";     // x86_64的基本指令集包含SSE2
+        return findSse2;
+#else
+        *name = "scalar";
+        return findScalar;
+#endif
+    }
+
+    static const char* g_implName = nullptr;
+
+    // 第一次调用时选择一次，之后每次查找只是一次间接调用；
+    // 用局部静态变量而不是全局变量，其它全局对象初始化时调用也是安全的
+    static SearchFunc dispatch(){
+        static const SearchFunc impl = selectImpl(&g_implName);
+        return impl;
+    }
+
+    const char* find(const char* begin, const char* end, const char* pattern, size_t len){
+        return dispatch()(begin, end, pattern, len);
+    }
+
+    const char* implementation(){
+        dispatch();
+        return g_implName;
+    }
+
+    SearchFunc findImpl(const char* name){
+        if(strcmp(name, "scalar") == 0){
+            return findScalar;
+        }
+#ifdef MYMUDUO_X86_SIMD
+        if(strcmp(name, "sse2") == 0){
+            return findSse2;
+        }
+        if(strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")){
+            return findAvx2;
+        }
+#endif
+        return nullptr;
+    }
+}
@@ -6,8 +6,11 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
+#include <errno.h>
 
 Socket::~Socket(){
     ::close(sockfd_);
@@ -70,3 +73,56 @@ void Socket::setKeepAlive(bool on){
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
 }
+
+// SO_MAX_PACING_RATE的单位是字节/秒，老的内核只接受32位的值
+bool Socket::setMaxPacingRate(uint64_t bytesPerSecond){
+    uint32_t rate = bytesPerSecond > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(bytesPerSecond);
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) < 0){
+        LOG_ERROR("Socket::setMaxPacingRate sockfd:%d error:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setNotSentLowat(uint32_t bytes){
+    if(::setsockopt(sockfd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &bytes, sizeof(bytes)) < 0){
+        LOG_ERROR("Socket::setNotSentLowat sockfd:%d error:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::getNotSentBytes(size_t* bytes){
+    int unsent = 0;
+    if(::ioctl(sockfd_, SIOCOUTQNSD, &unsent) < 0){
+        return false;
+    }
+    *bytes = static_cast<size_t>(unsent);
+    return true;
+}
+
+bool Socket::setRecvBufferSize(int bytes){
+    // 内核会把值翻倍，超过net.core.rmem_max时被截断
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(bytes)) < 0){
+        LOG_ERROR("Socket::setRecvBufferSize sockfd:%d error:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setSendBufferSize(int bytes){
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(bytes)) < 0){
+        LOG_ERROR("Socket::setSendBufferSize sockfd:%d error:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
+
+bool Socket::setZeroCopy(bool on){
+    int optval = on ? 1 : 0;
+    if(::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) < 0){
+        LOG_ERROR("Socket::setZeroCopy sockfd:%d error:%d \n", sockfd_, errno);
+        return false;
+    }
+    return true;
+}
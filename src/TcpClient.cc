@@ -0,0 +1,126 @@
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/socket.h>
+#include <string.h>
+#include <stdio.h>
+
+static EventLoop* CheckLoopNotNull(EventLoop* loop){
+    if(loop == nullptr){
+        LOG_FATAL("%s:%s%d TcpClient Loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+// TcpClient析构后，连接关闭时不能再回调TcpClient::removeConnection
+static void removeConnectionDetached(EventLoop* loop, const TcpConnectionPtr& conn){
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+static void defaultConnectionCallback(const TcpConnectionPtr& conn){
+    LOG_INFO("TcpClient connection %s -> %s is %s \n", conn->localAddress().toIpPort().c_str(), conn->peerAddress().toIpPort().c_str(), conn->connected() ? "UP" : "DOWN");
+}
+
+static void defaultMessageCallback(const TcpConnectionPtr&, Buffer* buff, Timestamp){
+    buff->retrieveAll();
+}
+
+TcpClient::TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    : loop_(CheckLoopNotNull(loop))
+    , connector_(new Connector(loop, serverAddr))
+    , name_(nameArg)
+    , connectionCallback_(defaultConnectionCallback)
+    , messageCallback_(defaultMessageCallback)
+    , retry_(false)
+    , connect_(true)
+    , nextConnId_(1)
+{
+    connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO("TcpClient::TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+}
+
+TcpClient::~TcpClient(){
+    LOG_INFO("TcpClient::~TcpClient[%s] - connector %p \n", name_.c_str(), connector_.get());
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        unique = connection_.unique();
+        conn = connection_;
+    }
+    if(conn){
+        // 连接还在，之后关闭时不能再调用本对象的removeConnection
+        CloseCallback cb = std::bind(&removeConnectionDetached, loop_, std::placeholders::_1);
+        loop_->runInLoop(std::bind(&TcpConnection::setCloseCallback, conn, cb));
+        if(unique){
+            conn->forceClose();
+        }
+    }else{
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect(){
+    LOG_INFO("TcpClient::connect[%s] - connecting to %s \n", name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect(){
+    connect_ = false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(connection_){
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop(){
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd){
+    sockaddr_in peer, local;
+    socklen_t addrLen = sizeof(peer);
+    memset(&peer, 0, sizeof(peer));
+    memset(&local, 0, sizeof(local));
+    if(::getpeername(sockfd, (sockaddr*)&peer, &addrLen) < 0){
+        LOG_ERROR("sockets::getPeerAddr \n");
+    }
+    addrLen = sizeof(local);
+    if(::getsockname(sockfd, (sockaddr*)&local, &addrLen) < 0){
+        LOG_ERROR("sockets::getLocalAddr \n");
+    }
+    InetAddress peerAddr(peer);
+    InetAddress localAddr(local);
+
+    char buff[64];
+    snprintf(buff, sizeof(buff), ":%s#%d", peerAddr.toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    std::string connName = name_ + buff;
+
+    TcpConnectionPtr conn(new TcpConnection(loop_, connName, sockfd, localAddr, peerAddr));
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback_(writeCompleteCallback_);
+    conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn){
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    if(retry_ && connect_){
+        LOG_INFO("TcpClient::removeConnection[%s] - reconnecting to %s \n", name_.c_str(), connector_->serverAddress().toIpPort().c_str());
+        connector_->restart();
+    }
+}
@@ -3,13 +3,23 @@
 #include "Logger.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "MemoryBudget.h"
+#include "TokenBucket.h"
 
 #include <functional>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
+#include <linux/errqueue.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <algorithm>
 
 // static表示本文件可见
 static EventLoop* CheckLoopNotNull(EventLoop* loop){
@@ -29,7 +39,37 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg, int so
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64*1024*1024)         // 64M
+    , lowWaterMark_(0)
+    , flowControl_(false)
+    , aboveHighWaterMark_(false)
+    , readPauseReasons_(0)
+    , readPauseCount_(0)
+    , readResumeCount_(0)
+    , budgetCharged_(0)
+    , sendThrottled_(false)
+    , zeroCopyThreshold_(0)
+    , zeroCopyNextSeq_(0)
+    , zeroCopyCompleted_(0)
+    , zeroCopySends_(0)
+    , zeroCopyCopied_(0)
+    , zeroCopyRegion_(nullptr)
+    , zeroCopyRegionSize_(0)
+    , zeroCopyReceivedBytes_(0)
+    , autoCork_(false)
+    , corkFlushPending_(false)
+    , notSentLowWaterMark_(0)
+    , priorityBytes_(0)
+    , priorityInProgress_(0)
+    , priorityOffset_(0)
+    , normalQueued_(0)
+    , normalSent_(0)
+    , lastBoundary_(0)
+    , splicedBytes_(0)
 {
+    for(int i = 0; i <= kMaxPriority; ++i){
+        priorityDepth_[i] = 0;
+        priorityBytesByClass_[i] = 0;
+    }
     // 我们muduo用户把这些操作注册给TcpServer，TcpServer传递给TcpConnection，TcpConnection给Channel设置回调函数，这些方法都是Poller监听到事件后，Channel需要调用的函数
     channel_->setReadCallBack(
         std::bind(&TcpConnection::handleRead, this, std::placeholders::_1)
@@ -52,6 +92,24 @@ TcpConnection::TcpConnection(EventLoop* loop, const std::string& nameArg, int so
 TcpConnection::~TcpConnection(){
     // 析构函数不需要做什么，只有socket_、channel_是new出来的，这俩用智能指针管理会自动释放
     LOG_INFO("TcpConnection::~TcpConnection[%s] as fd=%d state=%d \n", name_.c_str(), socket_->fd(), (int)state_);
+    if(budget_){
+        // 连接析构后inputBuffer_和outputBuffer_的内存才真正释放
+        budget_->release(budgetCharged_);
+        budget_->removeConnection();
+    }
+    releaseZeroCopyRegion();
+    cancelStreams();
+    // 还没发送完、或者还在等待内核通知的用户内存，内核持有的页面有自己的引用计数，这时候release不会导致内存错误
+    for(OutputChunk& chunk : outputChunks_){
+        if(chunk.type == OutputChunk::kPinned && chunk.release){
+            chunk.release();
+        }
+    }
+    for(auto& pending : zeroCopyPending_){
+        if(pending.second){
+            pending.second();
+        }
+    }
 }
 
 void TcpConnection::send(const std::string& buff){
@@ -59,16 +117,336 @@ void TcpConnection::send(const std::string& buff){
     if(state_ == kConnected){
         if(loop_->isInLoopThread()){
             sendInLoop(buff.c_str(), buff.size());
+        }else{
+            // 调用者的buff在回调执行之前可能已经析构了，拷贝一份，同时持有TcpConnection的引用
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), buff)
+            );
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& buff){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendInLoop(buff.c_str(), buff.size());
+        }else{
+            // 移动到回调对象中，不拷贝数据
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendStringInLoop, shared_from_this(), std::move(buff))
+            );
+        }
+    }
+}
+
+void TcpConnection::send(Buffer* buff){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendInLoop(buff->peek(), buff->readableBytes(), buff);
+            buff->retrieveAll();
+        }else{
+            // 交换到新的Buffer中再交给loop线程，不拷贝数据
+            std::shared_ptr<Buffer> owned(new Buffer);
+            owned->swap(*buff);
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendBufferInLoop, shared_from_this(), owned)
+            );
+        }
+    }
+}
+
+void TcpConnection::send(const PayloadPtr& payload){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendPayloadInLoop(payload);
+        }else{
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendPayloadInLoop, shared_from_this(), payload)
+            );
+        }
+    }
+}
+
+void TcpConnection::sendv(const std::vector<SendSegment>& segments){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendvInLoop(segments);
+        }else{
+            // 没有payload的片段在回调执行之前可能已经失效了，相邻的几个拷贝到同一个Payload中
+            std::vector<SendSegment> owned;
+            std::string pending;
+            for(const SendSegment& seg : segments){
+                if(seg.payload){
+                    if(!pending.empty()){
+                        owned.push_back(SendSegment(std::make_shared<Payload>(std::move(pending))));
+                        pending.clear();
+                    }
+                    owned.push_back(seg);
+                }else{
+                    pending.append(seg.data, seg.length);
+                }
+            }
+            if(!pending.empty()){
+                owned.push_back(SendSegment(std::make_shared<Payload>(std::move(pending))));
+            }
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendvInLoop, shared_from_this(), std::move(owned))
+            );
+        }
+    }
+}
+
+// 和sendInLoop一样，没有待发送的数据时直接发送，只是用writev一次写多个片段
+void TcpConnection::sendvInLoop(const std::vector<SendSegment>& segments){
+    size_t total = 0;
+    for(const SendSegment& seg : segments){
+        total += seg.length;
+    }
+    if(state_ == kDisconnected){
+        LOG_ERROR("TcpConnection::sendvInLoop TcpConnection Disconnected, give up writing!\n");
+        return;
+    }
+    if(budget_ && budget_->policy() == MemoryBudget::kRejectSend && budget_->exceeded()){
+        budget_->countRejectedSend();
+        LOG_DEBUG("TcpConnection::sendvInLoop [%s] memory budget exceeded, reject %lu bytes\n", name_.c_str(), total);
+        return;
+    }
+    markMessageBoundary(total);
+
+    size_t written = 0;
+    if(canWriteDirectly()){
+        size_t quota = writeQuota();
+        struct iovec vec[kMaxIovecs];
+        int count = 0;
+        size_t bytes = 0;
+        for(size_t i = 0; i < segments.size() && count < kMaxIovecs && bytes < quota; ++i){
+            if(segments[i].length == 0){
+                continue;
+            }
+            size_t len = std::min(segments[i].length, quota - bytes);
+            vec[count].iov_base = const_cast<char*>(segments[i].data);
+            vec[count].iov_len = len;
+            ++count;
+            bytes += len;
+        }
+        ssize_t n = count > 0 ? ::writev(channel_->fd(), vec, count) : 0;
+        if(n >= 0){
+            consumeSendQuota(n);
+            normalSent_ += n;
+            written = n;
+            if(written == total && writeCompleteCallback_){
+                loop_->queueInLoop(
+                    std::bind(writeCompleteCallback_, shared_from_this())
+                );
+            }
+        }else if(errno != EWOULDBLOCK){
+            LOG_ERROR("TcpConnection::sendvInLoop \n");
+            if(errno == EPIPE || errno == ECONNRESET){
+                // 数据被丢弃，按已经发送计算，后面的消息边界才不会错位
+                normalSent_ += total;
+                return;
+            }
+        }
+    }
+    if(written == total){
+        return;
+    }
+
+    // 只把没发送完的部分放入发送队列，有payload的片段只保存引用
+    size_t oldLen = queuedOutputBytes();
+    size_t remaining = total - written;
+    if(oldLen < highWaterMark_ && oldLen + remaining >= highWaterMark_ && highWaterMarkCallback_){
+        loop_->queueInLoop(
+            std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining)
+        );
+    }
+    size_t skip = written;
+    for(const SendSegment& seg : segments){
+        if(skip >= seg.length){
+            skip -= seg.length;
+            continue;
+        }
+        const char* data = seg.data + skip;
+        size_t len = seg.length - skip;
+        skip = 0;
+        if(seg.payload && len >= kPayloadCopyThreshold){
+            OutputChunk chunk(OutputChunk::kPinned);
+            chunk.data = data;
+            chunk.remaining = len;
+            chunk.payload = seg.payload;
+            chunk.zeroCopy = zeroCopyThreshold_ > 0 && len >= zeroCopyThreshold_;
+            outputChunks_.push_back(std::move(chunk));
+        }else{
+            appendOutput(data, len);
+        }
+    }
+    onOutputChanged();
+    if(!channel_->isWritingEvent()){
+        startWriting();
+    }
+}
+
+void TcpConnection::sendWithPriority(const std::string& message, int priority){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendWithPriorityInLoop(message, priority);
         }else{
             loop_->runInLoop(
-                std::bind(&TcpConnection::sendInLoop, this, buff.c_str(), buff.size())
+                std::bind(&TcpConnection::sendWithPriorityInLoop, shared_from_this(), message, priority)
             );
         }
     }
 }
 
+void TcpConnection::sendWithPriorityInLoop(const std::string& message, int priority){
+    if(message.empty()){
+        // 空消息不会经过writePriority，排进队列就永远不会出队
+        return;
+    }
+    if(priority <= 0 || canWriteDirectly()){
+        // 前面没有排队的数据，和普通发送一样直接写
+        sendInLoop(message.data(), message.size());
+        return;
+    }
+    if(state_ == kDisconnected){
+        LOG_ERROR("TcpConnection::sendWithPriorityInLoop TcpConnection Disconnected, give up writing!\n");
+        return;
+    }
+    if(priority > kMaxPriority){
+        priority = kMaxPriority;
+    }
+    priorityQueues_[priority].push_back(message);
+    priorityBytes_ += message.size();
+    ++priorityDepth_[priority];
+    priorityBytesByClass_[priority] += message.size();
+    onOutputChanged();
+    if(!channel_->isWritingEvent()){
+        startWriting();
+    }
+}
+
+void TcpConnection::markMessageBoundary(size_t len){
+    if(hasPendingNormalOutput()){
+        // 新消息的开头就是前面所有普通数据的结尾，已经发送过的边界顺便删掉
+        popSentBoundaries();
+        messageBoundaries_.push_back(normalQueued_);
+    }else{
+        // 前面的数据都发送完了，当前位置就是边界，丢弃过的数据也一起对齐
+        messageBoundaries_.clear();
+        normalQueued_ = normalSent_;
+        lastBoundary_ = normalSent_;
+    }
+    normalQueued_ += len;
+}
+
+bool TcpConnection::atMessageBoundary(){
+    if(!hasPendingNormalOutput()){
+        return true;
+    }
+    resyncNormalSent();
+    popSentBoundaries();
+    if(lastBoundary_ != normalSent_){
+        return false;
+    }
+    if(outputBuffer_.readableBytes() == 0 && !outputChunks_.empty() && outputChunks_.front().type == OutputChunk::kStream){
+        // 正在流式发送，生产者产生的数据发送完才是边界
+        return outputChunks_.front().buffer.readableBytes() == 0;
+    }
+    return true;
+}
+
+void TcpConnection::popSentBoundaries(){
+    while(!messageBoundaries_.empty() && messageBoundaries_.front() <= normalSent_){
+        lastBoundary_ = messageBoundaries_.front();
+        messageBoundaries_.pop_front();
+    }
+}
+
+// 只在有高优先级消息等待时调用，需要遍历排队的数据块
+void TcpConnection::resyncNormalSent(){
+    uint64_t pending = outputBuffer_.readableBytes();
+    for(const OutputChunk& chunk : outputChunks_){
+        if(chunk.type == OutputChunk::kBuffer){
+            pending += chunk.buffer.readableBytes();
+        }else if(chunk.type != OutputChunk::kStream){
+            // 流式数据不计入normalQueued_
+            pending += chunk.remaining;
+        }
+    }
+    if(pending <= normalQueued_ && normalQueued_ - pending > normalSent_){
+        normalSent_ = normalQueued_ - pending;
+    }
+}
+
+// 优先级高的队列先发送，同一个队列中的多条消息用writev一起发送
+ssize_t TcpConnection::writePriority(size_t maxBytes, int* saveErrno){
+    int priority = priorityInProgress_;
+    for(int i = kMaxPriority; priority == 0 && i > 0; --i){
+        if(!priorityQueues_[i].empty()){
+            priority = i;
+        }
+    }
+    std::deque<std::string>& queue = priorityQueues_[priority];
+    struct iovec vec[kMaxIovecs];
+    int count = 0;
+    size_t bytes = 0;
+    size_t offset = priorityOffset_;
+    for(size_t i = 0; i < queue.size() && count < kMaxIovecs && bytes < maxBytes; ++i){
+        size_t len = std::min(queue[i].size() - offset, maxBytes - bytes);
+        vec[count].iov_base = const_cast<char*>(queue[i].data() + offset);
+        vec[count].iov_len = len;
+        ++count;
+        bytes += len;
+        offset = 0;
+    }
+    ssize_t n = ::writev(channel_->fd(), vec, count);
+    if(n < 0){
+        *saveErrno = errno;
+        return n;
+    }
+    size_t left = n;
+    priorityBytes_ -= left;
+    priorityBytesByClass_[priority] -= left;
+    while(left > 0){
+        size_t rest = queue.front().size() - priorityOffset_;
+        if(left < rest){
+            priorityOffset_ += left;
+            break;
+        }
+        left -= rest;
+        priorityOffset_ = 0;
+        queue.pop_front();
+        --priorityDepth_[priority];
+    }
+    // 消息没有发送完之前，其他数据都不能插进来
+    priorityInProgress_ = priorityOffset_ > 0 ? priority : 0;
+    return n;
+}
+
+void TcpConnection::sendStringInLoop(const std::string& buff){
+    sendInLoop(buff.c_str(), buff.size());
+}
+
+void TcpConnection::sendBufferInLoop(const std::shared_ptr<Buffer>& buff){
+    sendInLoop(buff->peek(), buff->readableBytes(), buff.get());
+}
+
+void TcpConnection::sendPayloadInLoop(const PayloadPtr& payload){
+    if(state_ == kDisconnected || payload->size() < kPayloadCopyThreshold){
+        // 小消息拷贝到outputBuffer_，和前后的数据一起发送，比单独作为一个数据块少系统调用
+        sendInLoop(payload->data(), payload->size());
+        return;
+    }
+    OutputChunk chunk(OutputChunk::kPinned);
+    chunk.data = payload->data();
+    chunk.remaining = payload->size();
+    chunk.payload = payload;
+    chunk.zeroCopy = zeroCopyThreshold_ > 0 && payload->size() >= zeroCopyThreshold_;
+    queueMemoryChunk(std::move(chunk));
+}
+
 // 应用写的快，而内核发送数据快，需要把待发送数据写入outputBuffer_缓冲区，并设置了水位回调
-void TcpConnection::sendInLoop(const void* data, size_t len){
+void TcpConnection::sendInLoop(const void* data, size_t len, Buffer* owner){
     ssize_t nwriten = 0;              // 已发送的数据
     size_t remaining = len;          // 没发送的数据
     bool faultError = false;
@@ -77,10 +455,21 @@ void TcpConnection::sendInLoop(const void* data, size_t len){
         LOG_ERROR("TcpConnection::sendInLoop TcpConnection Disconnected, give up writing!\n");
         return;
     }
-    if(!channel_->isWritingEvent() && outputBuffer_.readableBytes() == 0){
+    if(budget_ && budget_->policy() == MemoryBudget::kRejectSend && budget_->exceeded()){
+        // 服务器的内存预算已经超限，拒绝新的发送，过载时日志太多会拖慢服务器，只记录次数
+        budget_->countRejectedSend();
+        LOG_DEBUG("TcpConnection::sendInLoop [%s] memory budget exceeded, reject %lu bytes\n", name_.c_str(), len);
+        return;
+    }
+    markMessageBoundary(len);
+    if(canWriteDirectly()){
         // channel_第一次写数据时，对写事件不感兴趣开始写数据 && 缓冲区没有待发送的数据
-        nwriten = ::write(channel_->fd(), data, len);
+        // 开启了发送限速时，最多只能写令牌桶允许的字节数，令牌为0时不写，全部放入outputBuffer_
+        size_t quota = writeQuota();
+        nwriten = quota > 0 ? ::write(channel_->fd(), data, std::min(len, quota)) : 0;
         if(nwriten >= 0){
+            consumeSendQuota(nwriten);
+            normalSent_ += nwriten;
             remaining = len - nwriten;
             if(remaining == 0 && writeCompleteCallback_){
                 // 如果数据刚好发送完了 && 用户注册过发送完成的回调writeCompleteCallback_
@@ -97,31 +486,305 @@ void TcpConnection::sendInLoop(const void* data, size_t len){
                 LOG_ERROR("TcpConnection::sendInLoop \n");
                 if(errno == EPIPE || errno == ECONNRESET){
                     faultError = true;
+                    // 数据被丢弃，按已经发送计算，后面的消息边界才不会错位
+                    normalSent_ += len;
                 }
             }
         }
+    }
+
+    // 说明当前这一次write，并没有把数据全部发送出去，剩余的数据需要保存到缓冲区当中，
+    // 然后给channel注册epollout事件，一旦poller发现tcp的发送缓冲区有空间，会通知相应的Channel，调用writeCallback_回调方法
+    // Channel调用的writeCallback_就是TcpConnection注册的handleWrite，继续往TCP的发送缓冲区中写入outputBuffer_的数据
+    if(!faultError && remaining > 0){
+        // 目前outputBuffer_中积攒的待发送的数据
+        size_t oldLen = queuedOutputBytes();
+        if(oldLen < highWaterMark_ && oldLen + remaining >= highWaterMark_ &&  highWaterMarkCallback_){
+            // 如果以前积攒的数据不足水位 && 以前积攒的加上本次需要写入outputBuffer_的数据大于水位 && 注册了highWaterMarkCallback_
+            // 调用highWaterMarkCallback_
+            loop_->queueInLoop(
+                std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining)
+            );
+        }
+        // 剩余没发送完的数据写入outputBuffer_
+        if(owner != nullptr && !hasPendingOutput()){
+            // outputBuffer_是空的，直接交换，owner换回来的是空的outputBuffer_
+            owner->retrieve(nwriten);
+            outputBuffer_.swap(*owner);
+        }else{
+            appendOutput(static_cast<const char*>(data) + nwriten, remaining);
+        }
+        onOutputChanged();
+        if(!channel_->isWritingEvent()){
+            // 给Channel注册EPOLLOUT写事件，否则当内核的TCP发送缓冲区没有数据时，Poller不会给Channel通知，Channel就不会调用writeCallback_，即TcpConnection::handleWrite
+            startWriting();
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t length){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendFileInLoop(fd, offset, length);
+        }else{
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fd, offset, length)
+            );
+        }
+    }
+}
 
-        // 说明当前这一次write，并没有把数据全部发送出去，剩余的数据需要保存到缓冲区当中，
-        // 然后给channel注册epollout事件，一旦poller发现tcp的发送缓冲区有空间，会通知相应的Channel，调用writeCallback_回调方法
-        // Channel调用的writeCallback_就是TcpConnection注册的handleWrite，继续往TCP的发送缓冲区中写入outputBuffer_的数据
-        if(!faultError && remaining > 0){
-            // 目前outputBuffer_中积攒的待发送的数据
-            size_t oldLen = outputBuffer_.readableBytes();  
-            if(oldLen < highWaterMark_ && oldLen + remaining >= highWaterMark_ &&  highWaterMarkCallback_){
-                // 如果以前积攒的数据不足水位 && 以前积攒的加上本次需要写入outputBuffer_的数据大于水位 && 注册了highWaterMarkCallback_
-                // 调用highWaterMarkCallback_
+// 和sendInLoop类似，前面没有待发送的数据时直接sendfile，没发送完的部分作为文件块排队，由handleWrite继续发送
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t length){
+    size_t remaining = length;
+    if(state_ == kDisconnected){
+        LOG_ERROR("TcpConnection::sendFileInLoop TcpConnection Disconnected, give up writing!\n");
+        return;
+    }
+    markMessageBoundary(length);
+    if(canWriteDirectly()){
+        size_t quota = writeQuota();
+        ssize_t n = quota > 0 ? ::sendfile(channel_->fd(), fd, &offset, std::min(length, quota)) : 0;
+        if(n >= 0){
+            consumeSendQuota(n);
+            normalSent_ += n;
+            remaining = length - n;
+            if(remaining == 0 && writeCompleteCallback_){
                 loop_->queueInLoop(
-                    std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining)
+                    std::bind(writeCompleteCallback_, shared_from_this())
                 );
             }
-            // 剩余没发送完的数据写入outputBuffer_
-            outputBuffer_.append(static_cast<const char*>(data) + nwriten, remaining);
-            if(!channel_->isWritingEvent()){
-                // 给Channel注册EPOLLOUT写事件，否则当内核的TCP发送缓冲区没有数据时，Poller不会给Channel通知，Channel就不会调用writeCallback_，即TcpConnection::handleWrite
-                channel_->enableWriting();
+        }else if(errno != EWOULDBLOCK){
+            LOG_ERROR("TcpConnection::sendFileInLoop \n");
+            if(errno == EPIPE || errno == ECONNRESET){
+                normalSent_ += length;
+                return;
+            }
+        }
+    }
+
+    if(remaining > 0){
+        // 文件数据不占用内存，不参与水位线和内存预算的计算
+        OutputChunk chunk(OutputChunk::kFile);
+        chunk.fd = fd;
+        chunk.offset = offset;
+        chunk.remaining = remaining;
+        outputChunks_.push_back(std::move(chunk));
+        if(!channel_->isWritingEvent()){
+            startWriting();
+        }
+    }
+}
+
+void TcpConnection::appendOutput(const char* data, size_t len){
+    if(outputChunks_.empty()){
+        outputBuffer_.append(data, len);
+        return;
+    }
+    // 前面还有文件块没发送完，数据要排在文件块后面
+    if(outputChunks_.back().type != OutputChunk::kBuffer){
+        outputChunks_.push_back(OutputChunk(OutputChunk::kBuffer));
+    }
+    outputChunks_.back().buffer.append(data, len);
+}
+
+size_t TcpConnection::queuedOutputBytes() const{
+    size_t bytes = outputBuffer_.readableBytes() + priorityBytes_;
+    for(const OutputChunk& chunk : outputChunks_){
+        if(chunk.type == OutputChunk::kBuffer || chunk.type == OutputChunk::kStream){
+            bytes += chunk.buffer.readableBytes();
+        }
+    }
+    return bytes;
+}
+
+void TcpConnection::promoteOutputChunk(){
+    while(outputBuffer_.readableBytes() == 0 && !outputChunks_.empty() && outputChunks_.front().type == OutputChunk::kBuffer){
+        // outputBuffer_已经空了，直接交换，不拷贝数据
+        outputBuffer_.swap(outputChunks_.front().buffer);
+        outputChunks_.pop_front();
+    }
+}
+
+ssize_t TcpConnection::sendFileChunk(size_t maxBytes, int* saveErrno){
+    OutputChunk& chunk = outputChunks_.front();
+    ssize_t n = ::sendfile(channel_->fd(), chunk.fd, &chunk.offset, std::min(chunk.remaining, maxBytes));
+    if(n > 0){
+        chunk.remaining -= n;
+        if(chunk.remaining == 0){
+            outputChunks_.pop_front();
+        }
+    }else if(n == 0){
+        // 文件比要求发送的长度短，后面的数据已经无法按顺序发送了
+        LOG_ERROR("TcpConnection::sendFileChunk [%s] fd=%d reached end of file with %lu bytes left\n", name_.c_str(), chunk.fd, chunk.remaining);
+        // 没发送的部分按已经发送计算，后面的消息边界才不会错位
+        normalSent_ += chunk.remaining;
+        outputChunks_.pop_front();
+        forceClose();
+    }else{
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+void TcpConnection::sendPinned(const void* data, size_t len, const ReleaseCallback& release){
+    if(state_ == kConnected){
+        if(loop_->isInLoopThread()){
+            sendPinnedInLoop(data, len, release);
+        }else{
+            // data由用户保证在release之前有效，可以直接跨线程传递
+            loop_->runInLoop(
+                std::bind(&TcpConnection::sendPinnedInLoop, shared_from_this(), data, len, release)
+            );
+        }
+    }else if(release){
+        release();
+    }
+}
+
+void TcpConnection::sendPinnedInLoop(const void* data, size_t len, const ReleaseCallback& release){
+    if(state_ == kDisconnected || zeroCopyThreshold_ == 0 || len < zeroCopyThreshold_){
+        // 小数据走原来的路径，拷贝以后用户内存就可以释放了
+        sendInLoop(data, len);
+        if(release){
+            release();
+        }
+        return;
+    }
+
+    OutputChunk chunk(OutputChunk::kPinned);
+    chunk.data = static_cast<const char*>(data);
+    chunk.remaining = len;
+    chunk.release = release;
+    chunk.zeroCopy = true;
+    queueMemoryChunk(std::move(chunk));
+}
+
+void TcpConnection::queueMemoryChunk(OutputChunk&& chunk){
+    markMessageBoundary(chunk.remaining);
+    bool idle = canWriteDirectly();
+    outputChunks_.push_back(std::move(chunk));
+
+    if(idle){
+        // 前面没有待发送的数据，直接发送
+        size_t quota = writeQuota();
+        int saveErrno = 0;
+        ssize_t n = quota > 0 ? sendPinnedChunk(quota, &saveErrno) : 0;
+        if(n > 0){
+            consumeSendQuota(n);
+            normalSent_ += n;
+            if(!hasPendingOutput()){
+                if(writeCompleteCallback_){
+                    loop_->queueInLoop(
+                        std::bind(writeCompleteCallback_, shared_from_this())
+                    );
+                }
+                return;
+            }
+        }else if(n < 0 && saveErrno != EWOULDBLOCK){
+            LOG_ERROR("TcpConnection::queueMemoryChunk \n");
+            if(saveErrno == EPIPE || saveErrno == ECONNRESET){
+                // 内存块留在队列中，连接析构时release
+                return;
+            }
+        }
+    }
+    if(!channel_->isWritingEvent()){
+        startWriting();
+    }
+}
+
+ssize_t TcpConnection::sendPinnedChunk(size_t maxBytes, int* saveErrno){
+    OutputChunk& chunk = outputChunks_.front();
+    size_t len = std::min(chunk.remaining, maxBytes);
+    bool zeroCopy = chunk.zeroCopy;
+    ssize_t n = ::send(channel_->fd(), chunk.data, len, zeroCopy ? MSG_ZEROCOPY : 0);
+    if(n < 0 && zeroCopy && errno == ENOBUFS){
+        // 超过了optmem_max的限制，这一次退回到普通发送
+        zeroCopy = false;
+        n = ::send(channel_->fd(), chunk.data, len, 0);
+    }
+    if(n > 0){
+        if(zeroCopy){
+            // 每次成功的MSG_ZEROCOPY发送，内核都会分配一个序号，完成通知中带的就是序号的范围
+            chunk.zeroCopied = true;
+            chunk.lastSeq = zeroCopyNextSeq_++;
+            ++zeroCopySends_;
+        }
+        chunk.data += n;
+        chunk.remaining -= n;
+        if(chunk.remaining == 0){
+            ReleaseCallback release;
+            release.swap(chunk.release);
+            if(chunk.zeroCopied){
+                if(chunk.payload){
+                    // 内核通知完成之前都要持有Payload的引用
+                    PayloadPtr payload = chunk.payload;
+                    release = [payload](){};
+                }
+                zeroCopyPending_.push_back(std::make_pair(chunk.lastSeq, release));
+                release = ReleaseCallback();
+            }
+            outputChunks_.pop_front();
+            if(release){
+                release();
             }
         }
+    }else if(n < 0){
+        *saveErrno = errno;
     }
+    return n;
+}
+
+void TcpConnection::handleZeroCopyCompletion(){
+    char control[128];
+    while(true){
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if(::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE) < 0){
+            // EAGAIN，错误队列已经读完了
+            break;
+        }
+        for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)){
+            bool recvErr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                        || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            if(!recvErr){
+                continue;
+            }
+            const struct sock_extended_err* serr = reinterpret_cast<const struct sock_extended_err*>(CMSG_DATA(cmsg));
+            if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY){
+                continue;
+            }
+            // 序号在[ee_info, ee_data]范围内的发送都完成了，TCP的完成通知是按顺序的
+            if(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED){
+                zeroCopyCopied_ += serr->ee_data - serr->ee_info + 1;
+            }
+            uint32_t next = serr->ee_data + 1;
+            if(static_cast<int32_t>(next - zeroCopyCompleted_) > 0){
+                zeroCopyCompleted_ = next;
+            }
+        }
+    }
+
+    while(!zeroCopyPending_.empty() && static_cast<int32_t>(zeroCopyCompleted_ - zeroCopyPending_.front().first) > 0){
+        ReleaseCallback release;
+        release.swap(zeroCopyPending_.front().second);
+        zeroCopyPending_.pop_front();
+        if(release){
+            release();
+        }
+    }
+}
+
+bool TcpConnection::setZeroCopyThreshold(size_t threshold){
+    if(threshold > 0 && zeroCopyThreshold_ == 0 && !socket_->setZeroCopy(true)){
+        return false;
+    }
+    // 关闭时不取消SO_ZEROCOPY，之前发送的数据还会有完成通知
+    zeroCopyThreshold_ = threshold;
+    return true;
 }
 
 // 客户端断开，或者有其他特殊情况，关闭当前TcpConnection
@@ -135,9 +798,26 @@ void TcpConnection::shutdown(){
     }
 }
 
+void TcpConnection::forceClose(){
+    if(state_ == kConnected || state_ == kDisconnecting){
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this())
+        );
+    }
+}
+
+void TcpConnection::forceCloseInLoop(){
+    if(state_ == kConnected || state_ == kDisconnecting){
+        // 和对端关闭连接的处理一样
+        handleClose();
+    }
+}
+
 void TcpConnection::shutdownInLoop(){
     // 有可能数据还没发送完就调用了shutdown，先等待数据发送完，发送完后handleWrite内会调用shutdownInLoop
-    if(!channel_->isWritingEvent()){
+    // 发送限速时可能暂时没有关注写事件，但outputBuffer_中还有数据
+    if(!channel_->isWritingEvent() && !hasPendingOutput()){
         // channel_对写事件不感兴趣，说明当前outputBuffer_中没有待发送的数据
         // 关闭写端
         socket_->shutdownWrite();
@@ -148,7 +828,11 @@ void TcpConnection::shutdownInLoop(){
 void TcpConnection::connectEstablished(){
     setState(kConnected);
     channel_->tie(shared_from_this());
-    channel_->enableReading();               // 向Poller注册读事件
+    if(readPauseReasons_ == 0){
+        channel_->enableReading();           // 向Poller注册读事件
+    }else{
+        reading_ = false;                    // 建立连接之前就被要求暂停读了
+    }
 
     connectionCallback_(shared_from_this()); // 用户传入的建立连接的回调on_connection
 }
@@ -165,14 +849,28 @@ void TcpConnection::connectDestroyed(){
 
 // 有读事件到来，将数据写入inputBuffer_
 void TcpConnection::handleRead(Timestamp receiveTime){
+    if(spliceOut_){
+        handleSpliceRead();
+        return;
+    }
+    if(zeroCopyReadCallback_){
+        handleZeroCopyRead(receiveTime);
+        return;
+    }
     int saveErrno = 0;
     // 发生了读事件，从channel_的fd中读取数据，存到inputBuffer_
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
     if(n > 0){
+        chargeRecvQuota(n);
         // 读取完成后，需要调用用户传入的回调操作，就是我们给TcpServer传入的on_message函数
         // 把当前TcpConnection对象给用户定义的on_message函数，是因为用户需要利用TcpConnection对象给客户端发数据，inputBuffer_就是客户端发来的数据，也传入on_message函数给用户
         // shared_from_this就是获取了当前TcpConnection对象的一个shared_ptr
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        if(inputBuffer_.readableBytes() == 0 && budget_ && inputBuffer_.internalCapacity() > kShrinkThreshold){
+            // 和outputBuffer_一样，突发的大请求处理完以后释放扩容出来的内存
+            inputBuffer_.shrink(0);
+        }
+        updateMemoryUsage();  // 用户没有取走的数据还积压在inputBuffer_中
     }else if(n == 0){
         // readv返回0，说明客户端关闭了
         handleClose();
@@ -184,32 +882,232 @@ void TcpConnection::handleRead(Timestamp receiveTime){
     }
 }
 
+bool TcpConnection::enableZeroCopyReceive(size_t regionSize){
+    releaseZeroCopyRegion();
+    size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    regionSize = (regionSize + pageSize - 1) / pageSize * pageSize;
+    if(regionSize == 0){
+        return false;
+    }
+    // 映射socket本身，TCP_ZEROCOPY_RECEIVE会把接收队列中的页面插入到这块地址空间
+    void* region = ::mmap(nullptr, regionSize, PROT_READ, MAP_SHARED, channel_->fd(), 0);
+    if(region == MAP_FAILED){
+        LOG_ERROR("TcpConnection::enableZeroCopyReceive [%s] mmap error:%d \n", name_.c_str(), errno);
+        return false;
+    }
+    zeroCopyRegion_ = region;
+    zeroCopyRegionSize_ = regionSize;
+    return true;
+}
+
+void TcpConnection::releaseZeroCopyRegion(){
+    if(zeroCopyRegion_ != nullptr){
+        ::munmap(zeroCopyRegion_, zeroCopyRegionSize_);
+        zeroCopyRegion_ = nullptr;
+        zeroCopyRegionSize_ = 0;
+    }
+}
+
+// 先把整页的数据映射到zeroCopyRegion_，映射不了的部分（不足一页、或者没有按页对齐）再用readv拷贝到inputBuffer_
+// 映射的数据在前，拷贝的数据在后，按顺序交给zeroCopyReadCallback_
+void TcpConnection::handleZeroCopyRead(Timestamp receiveTime){
+    size_t before = inputBuffer_.readableBytes();   // 开启零拷贝接收之前没有取走的数据
+    size_t mapped = 0;
+    size_t skip = 0;
+    if(zeroCopyRegion_ != nullptr){
+        struct tcp_zerocopy_receive zc;
+        memset(&zc, 0, sizeof(zc));
+        zc.address = reinterpret_cast<uint64_t>(zeroCopyRegion_);
+        zc.length = static_cast<uint32_t>(zeroCopyRegionSize_);
+        socklen_t zcLen = static_cast<socklen_t>(sizeof(zc));
+        if(::getsockopt(channel_->fd(), IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zcLen) == 0){
+            mapped = zc.length;
+            skip = zc.recv_skip_hint;
+        }else{
+            // 内核或者网卡不支持，之后都用readv
+            LOG_ERROR("TcpConnection::handleZeroCopyRead [%s] TCP_ZEROCOPY_RECEIVE error:%d, fall back to readv\n", name_.c_str(), errno);
+            releaseZeroCopyRegion();
+        }
+    }
+
+    if(mapped == 0 || skip > 0){
+        int saveErrno = 0;
+        ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+        if(n == 0 && mapped == 0){
+            handleClose();
+            return;
+        }else if(n < 0 && saveErrno != EAGAIN){
+            errno = saveErrno;
+            LOG_ERROR("TcpConnection::handleZeroCopyRead\n");
+            handleError();
+            return;
+        }
+    }
+    size_t copied = inputBuffer_.readableBytes() - before;
+    if(mapped + copied == 0){
+        return;
+    }
+    zeroCopyReceivedBytes_ += mapped;
+    chargeRecvQuota(mapped + copied);
+
+    ReadSpan spans[3];
+    int count = 0;
+    if(before > 0){
+        spans[count].data = inputBuffer_.peek();
+        spans[count].length = before;
+        ++count;
+    }
+    if(mapped > 0){
+        spans[count].data = static_cast<const char*>(zeroCopyRegion_);
+        spans[count].length = mapped;
+        ++count;
+    }
+    if(copied > 0){
+        spans[count].data = inputBuffer_.peek() + before;
+        spans[count].length = copied;
+        ++count;
+    }
+    zeroCopyReadCallback_(shared_from_this(), spans, count, receiveTime);
+
+    inputBuffer_.retrieveAll();
+    if(mapped > 0 && zeroCopyRegion_ != nullptr){
+        // 解除映射，让内核回收这些页面
+        ::madvise(zeroCopyRegion_, zeroCopyRegionSize_, MADV_DONTNEED);
+    }
+    updateMemoryUsage();
+}
+
+TcpConnection::SplicePipe::~SplicePipe(){
+    ::close(readFd);
+    ::close(writeFd);
+}
+
+bool TcpConnection::startSplice(const TcpConnectionPtr& peer, size_t pipeSize){
+    if(spliceOut_ || peer->spliceIn_ || peer.get() == this){
+        return false;
+    }
+    if(peer->getLoop() != loop_){
+        // 跨线程时两边的事件在不同的loop中处理，管道的读写没法配合，由调用者拷贝转发
+        LOG_ERROR("TcpConnection::startSplice [%s] peer %s is in another loop \n", name_.c_str(), peer->name().c_str());
+        return false;
+    }
+    int fds[2];
+    if(::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0){
+        LOG_ERROR("TcpConnection::startSplice [%s] pipe2 error:%d \n", name_.c_str(), errno);
+        return false;
+    }
+    if(pipeSize > 0 && ::fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(pipeSize)) < 0){
+        // 超过了/proc/sys/fs/pipe-max-size，使用默认大小
+        LOG_ERROR("TcpConnection::startSplice [%s] F_SETPIPE_SZ %lu error:%d \n", name_.c_str(), pipeSize, errno);
+    }
+    int capacity = ::fcntl(fds[1], F_GETPIPE_SZ);
+    std::shared_ptr<SplicePipe> pipe(new SplicePipe(fds[0], fds[1], capacity > 0 ? capacity : 64*1024));
+    pipe->source = shared_from_this();
+
+    if(inputBuffer_.readableBytes() > 0){
+        // 开启之前已经读到用户态的数据，排在管道的数据前面
+        peer->send(&inputBuffer_);
+    }
+    spliceOut_ = pipe;
+    spliceTarget_ = peer;
+    peer->spliceIn_ = pipe;
+    return true;
+}
+
+// 数据从socket移动到管道，再从管道移动到对端的socket，只在内核中移动页面的引用
+// 管道中的数据没有发送完时暂停读，等对端写空管道以后再读，内存占用不超过管道的大小
+void TcpConnection::handleSpliceRead(){
+    SplicePipe* pipe = spliceOut_.get();
+    if(pipe->bytes < pipe->capacity){
+        ssize_t n = ::splice(channel_->fd(), nullptr, pipe->writeFd, nullptr, pipe->capacity - pipe->bytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(n > 0){
+            pipe->bytes += n;
+            splicedBytes_ += n;
+            chargeRecvQuota(n);
+        }else if(n == 0){
+            pipe->eof = true;
+        }else if(errno != EAGAIN){
+            LOG_ERROR("TcpConnection::handleSpliceRead [%s] splice error:%d \n", name_.c_str(), errno);
+            handleError();
+            return;
+        }
+    }
+
+    TcpConnectionPtr peer = spliceTarget_.lock();
+    if(!peer || peer->state_ == kDisconnected){
+        // 对端关闭时一般已经调用过stopSpliceOut了
+        bool eof = pipe->eof;
+        stopSpliceOut();
+        if(eof){
+            handleClose();
+        }
+        return;
+    }
+    peer->flushSpliceInput();
+    if(pipe->eof && pipe->bytes == 0){
+        // 数据都转发完了，把EOF传给对端
+        peer->shutdown();
+        handleClose();
+    }else if(pipe->bytes > 0){
+        pipe->sourcePaused = true;
+        pauseReadingInLoop(kPauseBySplice);
+    }
+}
+
+void TcpConnection::flushSpliceInput(){
+    if(canWriteDirectly()){
+        int saveErrno = 0;
+        ssize_t n = writeOutput(&saveErrno);
+        if(n < 0 && saveErrno != EWOULDBLOCK){
+            LOG_ERROR("TcpConnection::flushSpliceInput [%s] error:%d \n", name_.c_str(), saveErrno);
+            return;
+        }
+        if(hasPendingOutput() && !channel_->isWritingEvent() && !sendThrottled_){
+            channel_->enableWriting();
+        }
+    }else if(!channel_->isWritingEvent()){
+        startWriting();
+    }
+}
+
+ssize_t TcpConnection::writeSpliceInput(size_t maxBytes, int* saveErrno){
+    SplicePipe* pipe = spliceIn_.get();
+    ssize_t n = ::splice(pipe->readFd, nullptr, channel_->fd(), nullptr, std::min(pipe->bytes, maxBytes), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if(n < 0){
+        *saveErrno = errno;
+        return n;
+    }
+    pipe->bytes -= n;
+    if(pipe->bytes == 0){
+        TcpConnectionPtr source = pipe->source.lock();
+        if(pipe->eof){
+            // 对端已经读到EOF，数据都转发完了，关闭本连接的写端，把EOF传下去
+            shutdown();
+            if(source){
+                // 再关闭对端，不在本连接的写事件处理中回调用户
+                loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, source));
+            }
+        }else if(source && pipe->sourcePaused){
+            pipe->sourcePaused = false;
+            source->resumeReadingInLoop(kPauseBySplice);
+        }
+    }
+    return n;
+}
+
+void TcpConnection::stopSpliceOut(){
+    spliceOut_.reset();
+    spliceTarget_.reset();
+    resumeReadingInLoop(kPauseBySplice);
+}
+
 // TcpConnection::sendInLoop一次write没有发送完数据，将剩余的数据写入outputBuffer_后，然后Channel调用writeCallback_
 // Channel调用的writeCallback_就是TcpConnection注册的handleWrite，handleWrite用于继续发送outputBuffer_中的数据到TCP缓冲区，直到outputBuffer_可读区间没有数据
 void TcpConnection::handleWrite(){
     if(channel_->isWritingEvent()){
         int saveErrno = 0;
-        // 往fd上写outputBuffer_可读区间的数据，写了n个字节，即发送数据
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &saveErrno);
-        if(n > 0){
-            outputBuffer_.retrieve(n);  // readerIndex_复位
-            if(outputBuffer_.readableBytes() == 0){
-                // outputBuffer_的可读区间为0，已经发送完了，将Channel封装的events置为不可写，底层还是调用的epoll_ctl
-                // // Channel调用update remove ==> EventLoop updateChannel removeChannel ==> Poller updateChannel removeChannel
-                channel_->disableWriting();
-                if(writeCompleteCallback_){
-                    // 唤醒loop_所在线程，执行数据发送完成以后的回调函数
-                    loop_->queueInLoop(
-                        std::bind(writeCompleteCallback_, shared_from_this())
-                    );
-                }
-                if(state_ == kDisconnecting){
-                    // 读完数据时，如果发现已经调用了shutdown方法，state_会被置为kDisconnecting，则会调用shutdownInLoop，在当前所属的loop里面删除当前TcpConnection对象
-                    shutdownInLoop();
-                }
-            }
-        }else{
-            // n <= 0
+        ssize_t n = writeOutput(&saveErrno);
+        if(n < 0){
             LOG_ERROR("TcpConnection::handleWrite \n");
         }
     }else{
@@ -218,17 +1116,238 @@ void TcpConnection::handleWrite(){
     }
 }
 
+// 发送一次待发送的数据：outputBuffer_，或者outputBuffer_发送完以后队首的数据块
+ssize_t TcpConnection::writeOutput(int* saveErrno){
+    ssize_t n = 0;
+    size_t quota = SIZE_MAX;
+    // 应用可能通过outputBuffer()丢弃了待发送的数据，流式发送的生产者也可能刚好结束，这时候直接按发送完成处理
+    if(hasPendingOutput()){
+        quota = sendQuota();
+        if(quota == 0){
+            throttleWriting();
+            return 0;
+        }
+        size_t limit = std::min(quota, notSentRoom());
+        if(limit == 0){
+            // 内核中未发送的数据还没降到TCP_NOTSENT_LOWAT以下，等待EPOLLOUT
+            if(!channel_->isWritingEvent()){
+                channel_->enableWriting();
+            }
+            return 0;
+        }
+        if(priorityInProgress_ > 0 || (priorityBytes_ > 0 && atMessageBoundary())){
+            // 普通数据刚好在消息边界上，先发送高优先级的消息
+            n = writePriority(limit, saveErrno);
+        }else if(!hasPendingNormalOutput()){
+            // 普通数据都发送完了，再发送对端通过splice转发过来的数据
+            n = writeSpliceInput(limit, saveErrno);
+        }else{
+            promoteOutputChunk();
+            if(outputBuffer_.readableBytes() == 0 && outputChunks_.front().type == OutputChunk::kStream){
+                // 流式数据不计入normalSent_，每次从生产者取到的数据发送完就是一个消息边界
+                n = writeStreamChunk(limit, saveErrno);
+            }else{
+                if(priorityBytes_ > 0){
+                    // 有高优先级的消息在等待，这次只发送到下一个消息边界
+                    resyncNormalSent();
+                    popSentBoundaries();
+                    if(!messageBoundaries_.empty()){
+                        limit = std::min(limit, static_cast<size_t>(messageBoundaries_.front() - normalSent_));
+                    }
+                }
+                if(outputBuffer_.readableBytes() > 0){
+                    // 往fd上写outputBuffer_可读区间的数据，写了n个字节，即发送数据
+                    n = outputBuffer_.writeFd(channel_->fd(), limit, saveErrno);
+                    if(n > 0){
+                        outputBuffer_.retrieve(n);  // readerIndex_复位
+                        if(outputBuffer_.readableBytes() == 0 && budget_ && outputBuffer_.internalCapacity() > kShrinkThreshold){
+                            // 开启了内存预算时，发送完后释放outputBuffer_扩容出来的内存，否则vector的容量只增不减
+                            outputBuffer_.shrink(0);
+                        }
+                    }
+                }else if(outputChunks_.front().type == OutputChunk::kFile){
+                    // outputBuffer_发送完了，队首是文件块
+                    n = sendFileChunk(limit, saveErrno);
+                }else{
+                    n = sendPinnedChunk(limit, saveErrno);
+                }
+                if(n > 0){
+                    normalSent_ += n;
+                }
+            }
+        }
+        if(n > 0){
+            consumeSendQuota(n);
+            onOutputChanged();
+        }
+    }
+    if(n >= 0 && !hasPendingOutput()){
+        // outputBuffer_的可读区间为0，已经发送完了，将Channel封装的events置为不可写，底层还是调用的epoll_ctl
+        // // Channel调用update remove ==> EventLoop updateChannel removeChannel ==> Poller updateChannel removeChannel
+        if(channel_->isWritingEvent()){
+            channel_->disableWriting();
+        }
+        if(writeCompleteCallback_){
+            // 唤醒loop_所在线程，执行数据发送完成以后的回调函数
+            loop_->queueInLoop(
+                std::bind(writeCompleteCallback_, shared_from_this())
+            );
+        }
+        if(state_ == kDisconnecting){
+            // 读完数据时，如果发现已经调用了shutdown方法，state_会被置为kDisconnecting，则会调用shutdownInLoop，在当前所属的loop里面删除当前TcpConnection对象
+            shutdownInLoop();
+        }
+    }else if(n > 0 && static_cast<size_t>(n) == quota){
+        // 令牌用完了，等令牌补充后再写，否则EPOLLOUT会一直触发
+        throttleWriting();
+    }
+    return n;
+}
+
+void TcpConnection::sendStream(const StreamProducer& producer, const ReleaseCallback& onCancel){
+    loop_->runInLoop(
+        std::bind(&TcpConnection::sendStreamInLoop, shared_from_this(), producer, onCancel)
+    );
+}
+
+void TcpConnection::sendStreamInLoop(const StreamProducer& producer, const ReleaseCallback& onCancel){
+    if(state_ != kConnected){
+        LOG_ERROR("TcpConnection::sendStreamInLoop TcpConnection not connected, give up writing!\n");
+        if(onCancel){
+            onCancel();
+        }
+        return;
+    }
+    // 流的长度事先不知道，流后面的普通数据的消息边界不包括流的数据
+    markMessageBoundary(0);
+    OutputChunk chunk(OutputChunk::kStream);
+    chunk.producer = producer;
+    chunk.release = onCancel;
+    outputChunks_.push_back(std::move(chunk));
+    if(!channel_->isWritingEvent()){
+        startWriting();
+    }
+}
+
+void TcpConnection::resumeStream(){
+    loop_->runInLoop(std::bind(&TcpConnection::resumeStreamInLoop, shared_from_this()));
+}
+
+void TcpConnection::resumeStreamInLoop(){
+    if((state_ == kConnected || state_ == kDisconnecting) && hasPendingOutput() && !channel_->isWritingEvent()){
+        startWriting();
+    }
+}
+
+ssize_t TcpConnection::writeStreamChunk(size_t maxBytes, int* saveErrno){
+    OutputChunk& chunk = outputChunks_.front();
+    Buffer& buffer = chunk.buffer;
+    // 缓冲的数据少于kStreamLowWaterMark时才向生产者要数据，内存占用不超过kStreamLowWaterMark加上生产者一次产生的数据
+    // 有高优先级的消息在等待时，先把已经产生的数据发送完，让高优先级的消息插在这里
+    while(!chunk.streamDone && buffer.readableBytes() < kStreamLowWaterMark && (buffer.readableBytes() == 0 || priorityBytes_ == 0)){
+        size_t before = buffer.readableBytes();
+        if(!chunk.producer(&buffer)){
+            chunk.streamDone = true;
+        }else if(buffer.readableBytes() == before){
+            // 生产者暂时没有数据，等resumeStream
+            break;
+        }
+    }
+
+    ssize_t n = 0;
+    if(buffer.readableBytes() > 0){
+        n = buffer.writeFd(channel_->fd(), maxBytes, saveErrno);
+        if(n > 0){
+            buffer.retrieve(n);
+        }
+    }else if(!chunk.streamDone && channel_->isWritingEvent()){
+        channel_->disableWriting();
+    }
+    if(chunk.streamDone && buffer.readableBytes() == 0){
+        outputChunks_.pop_front();
+    }
+    return n;
+}
+
+// 连接关闭时还没发送完的流都取消，同时释放生产者，生产者中可能持有TcpConnectionPtr
+void TcpConnection::cancelStreams(){
+    for(OutputChunk& chunk : outputChunks_){
+        if(chunk.type == OutputChunk::kStream && chunk.producer){
+            chunk.producer = StreamProducer();
+            ReleaseCallback onCancel;
+            onCancel.swap(chunk.release);
+            if(onCancel){
+                onCancel();
+            }
+        }
+    }
+}
+
+bool TcpConnection::canWriteDirectly() const{
+    return !autoCork_ && !channel_->isWritingEvent() && !sendThrottled_ && !hasPendingOutput();
+}
+
+// 本轮事件循环中的发送都只追加到发送队列，在loop处理完所有事件之后一起发送
+void TcpConnection::flushCorkedOutput(){
+    corkFlushPending_ = false;
+    if(!(state_ == kConnected || state_ == kDisconnecting) || channel_->isWritingEvent() || sendThrottled_ || !hasPendingOutput()){
+        return;
+    }
+    int saveErrno = 0;
+    ssize_t n = writeOutput(&saveErrno);
+    if(n < 0 && saveErrno != EWOULDBLOCK){
+        LOG_ERROR("TcpConnection::flushCorkedOutput \n");
+        if(saveErrno == EPIPE || saveErrno == ECONNRESET){
+            return;
+        }
+    }
+    if(hasPendingOutput() && !channel_->isWritingEvent() && !sendThrottled_){
+        // 一次没有写完，剩下的等EPOLLOUT
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::setAutoCork(bool on){
+    autoCork_ = on;
+}
+
 void TcpConnection::handleClose(){
     LOG_INFO("TcpConnection::handleClose fd=%d state=%d \n", channel_->fd(), (int)state_);
     setState(kDisconnected);
     channel_->disableAll();  // 对任何事件都不感兴趣，从epoll红黑树中删除
 
+    if(aboveHighWaterMark_){
+        // 连接关闭后不会再发送outputBuffer_中的数据了，不能让对端一直暂停读
+        aboveHighWaterMark_ = false;
+        notifyPeerWaterMark(false);
+    }
+
+    if(spliceIn_){
+        // 转发给本连接的数据发不出去了，对端不能一直暂停读
+        TcpConnectionPtr source = spliceIn_->source.lock();
+        if(source && source->spliceOut_ == spliceIn_){
+            source->stopSpliceOut();
+        }
+        spliceIn_.reset();
+    }
+
+    TcpConnectionPtr peer = peer_.lock();
+    if(peer){
+        // 拷贝转发时本连接不会再有数据转发给对端了，对端发送完已经转发的数据后关闭写端
+        peer->shutdown();
+    }
+
     TcpConnectionPtr connPtr(shared_from_this());
+    cancelStreams();
     connectionCallback_(connPtr);                  // 执行关闭连接（用户传入的）
     closeCallback_(connPtr);                       // 执行连接关闭以后的回调，即TcpServer::removeConnection
 }
 
 void TcpConnection::handleError(){
+    if(zeroCopyThreshold_ > 0 || !zeroCopyPending_.empty()){
+        // 零拷贝发送完成的通知也是通过EPOLLERR报告的
+        handleZeroCopyCompletion();
+    }
     int optval;
     socklen_t optlen = static_cast<socklen_t>(sizeof((optval)));
     int err = 0;
@@ -238,5 +1357,308 @@ void TcpConnection::handleError(){
     }else{
         err = optval;
     }
-    LOG_ERROR("TcpConnection::handleError name : %s - SO_ERROR: %d \n", name_.c_str(), err);
+    if(err != 0 || zeroCopySends_ == 0){
+        LOG_ERROR("TcpConnection::handleError name : %s - SO_ERROR: %d \n", name_.c_str(), err);
+    }
+}
+
+void TcpConnection::startRead(){
+    loop_->runInLoop(std::bind(&TcpConnection::resumeReadingInLoop, shared_from_this(), static_cast<int>(kPauseByUser)));
+}
+
+void TcpConnection::stopRead(){
+    loop_->runInLoop(std::bind(&TcpConnection::pauseReadingInLoop, shared_from_this(), static_cast<int>(kPauseByUser)));
+}
+
+// 记录暂停原因，第一次暂停时才调用disableReading，从epoll中去掉读事件，内核接收缓冲区满了以后，TCP的滑动窗口会让对方停止发送
+void TcpConnection::pauseReadingInLoop(int reason){
+    readPauseReasons_ |= reason;
+    if(reading_ && channel_->isReadingEvent()){
+        channel_->disableReading();
+        reading_ = false;
+        if(reason != kPauseByUser){
+            ++readPauseCount_;
+        }
+    }
+}
+
+// 清除暂停原因，所有的暂停原因都清除了，才重新注册读事件
+void TcpConnection::resumeReadingInLoop(int reason){
+    readPauseReasons_ &= ~reason;
+    if(readPauseReasons_ == 0 && !reading_ && (state_ == kConnected || state_ == kDisconnecting)){
+        channel_->enableReading();
+        reading_ = true;
+        if(reason != kPauseByUser){
+            ++readResumeCount_;
+        }
+    }
+}
+
+void TcpConnection::linkPeer(const TcpConnectionPtr& peer){
+    // peer_只在所属loop线程中访问，两边各自在自己的loop中设置
+    loop_->runInLoop(std::bind(&TcpConnection::setPeerInLoop, shared_from_this(), std::weak_ptr<TcpConnection>(peer)));
+    peer->getLoop()->runInLoop(std::bind(&TcpConnection::setPeerInLoop, peer, std::weak_ptr<TcpConnection>(shared_from_this())));
+}
+
+void TcpConnection::unlinkPeer(){
+    loop_->runInLoop(std::bind(&TcpConnection::unlinkPeerInLoop, shared_from_this()));
+}
+
+void TcpConnection::unlinkPeerInLoop(){
+    TcpConnectionPtr peer = peer_.lock();
+    if(peer){
+        peer->getLoop()->runInLoop(std::bind(&TcpConnection::setPeerInLoop, peer, std::weak_ptr<TcpConnection>()));
+    }
+    setPeerInLoop(std::weak_ptr<TcpConnection>());
+}
+
+void TcpConnection::setPeerInLoop(const std::weak_ptr<TcpConnection>& peer){
+    peer_ = peer;
+    // 旧的对端导致的暂停不再有效
+    resumeReadingInLoop(kPauseByPeer);
+    if(aboveHighWaterMark_){
+        notifyPeerWaterMark(true);
+    }
+}
+
+// 通知对端自己的outputBuffer_越过了高水位（above为true），或者降到了低水位（above为false）
+void TcpConnection::notifyPeerWaterMark(bool above){
+    TcpConnectionPtr peer = peer_.lock();
+    if(peer){
+        if(above){
+            peer->getLoop()->runInLoop(std::bind(&TcpConnection::pauseReadingInLoop, peer, static_cast<int>(kPauseByPeer)));
+        }else{
+            peer->getLoop()->runInLoop(std::bind(&TcpConnection::resumeReadingInLoop, peer, static_cast<int>(kPauseByPeer)));
+        }
+    }
+}
+
+void TcpConnection::onOutputChanged(){
+    priorityBytesByClass_[0] = queuedOutputBytes() - priorityBytes_;
+    checkWaterMarks();
+    updateMemoryUsage();
+}
+
+// outputBuffer_积压的数据超过高水位时暂停自己和对端的读，降到低水位以下再恢复，避免outputBuffer_无限增长
+void TcpConnection::checkWaterMarks(){
+    if(!flowControl_){
+        return;
+    }
+    size_t pending = queuedOutputBytes();
+    if(!aboveHighWaterMark_ && pending >= highWaterMark_){
+        aboveHighWaterMark_ = true;
+        pauseReadingInLoop(kPauseBySelf);
+        notifyPeerWaterMark(true);
+    }else if(aboveHighWaterMark_ && pending <= lowWaterMark_){
+        aboveHighWaterMark_ = false;
+        resumeReadingInLoop(kPauseBySelf);
+        notifyPeerWaterMark(false);
+    }
+}
+
+void TcpConnection::setMemoryBudget(const std::shared_ptr<MemoryBudget>& budget){
+    budget_ = budget;
+    budget_->addConnection();
+}
+
+void TcpConnection::resumeReadingByBudget(){
+    loop_->runInLoop(std::bind(&TcpConnection::resumeReadingInLoop, shared_from_this(), static_cast<int>(kPauseByBudget)));
+}
+
+void TcpConnection::updateMemoryUsage(){
+    if(!budget_){
+        return;
+    }
+    // 两个Buffer按实际分配的内存计算，扩容以后即使数据取走了也还占着内存
+    size_t usage = inputBuffer_.internalCapacity() + outputBuffer_.internalCapacity() + queuedOutputBytes() - outputBuffer_.readableBytes();
+    if(usage > budgetCharged_){
+        budget_->charge(usage - budgetCharged_);
+    }else if(usage < budgetCharged_){
+        budget_->release(budgetCharged_ - usage);
+    }
+    budgetCharged_ = usage;
+
+    // 只处理占用超过平均值的连接，占用少的连接不受影响
+    if(!budget_->exceeded() || usage <= budget_->fairShare()){
+        return;
+    }
+    switch(budget_->policy()){
+        case MemoryBudget::kPauseReading:
+            if(!(readPauseReasons_ & kPauseByBudget)){
+                pauseReadingInLoop(kPauseByBudget);
+                budget_->addPausedConnection(shared_from_this());
+            }
+            break;
+        case MemoryBudget::kCloseConnection:
+            if(state_ == kConnected){
+                LOG_ERROR("TcpConnection::updateMemoryUsage [%s] memory budget exceeded, close connection holding %lu bytes\n", name_.c_str(), usage);
+                budget_->countClosedConnection();
+                forceClose();
+            }
+            break;
+        case MemoryBudget::kRejectSend:
+            // 在sendInLoop中处理
+            break;
+    }
+}
+
+void TcpConnection::setSendRateLimit(double bytesPerSecond, double burst){
+    if(bytesPerSecond > 0.0){
+        sendLimiter_.reset(new TokenBucket(bytesPerSecond, burst));
+    }else{
+        sendLimiter_.reset();
+    }
+}
+
+void TcpConnection::setRecvRateLimit(double bytesPerSecond, double burst){
+    if(bytesPerSecond > 0.0){
+        recvLimiter_.reset(new TokenBucket(bytesPerSecond, burst));
+    }else{
+        recvLimiter_.reset();
+    }
+}
+
+void TcpConnection::setSharedRateLimiters(const std::shared_ptr<TokenBucket>& sendLimiter, const std::shared_ptr<TokenBucket>& recvLimiter){
+    sharedSendLimiter_ = sendLimiter;
+    sharedRecvLimiter_ = recvLimiter;
+}
+
+bool TcpConnection::setKernelPacingRate(double bytesPerSecond){
+    return socket_->setMaxPacingRate(static_cast<uint64_t>(bytesPerSecond));
+}
+
+size_t TcpConnection::writeQuota(){
+    size_t quota = sendQuota();
+    return quota > 0 ? std::min(quota, notSentRoom()) : 0;
+}
+
+size_t TcpConnection::notSentRoom(){
+    size_t unsent = 0;
+    if(notSentLowWaterMark_ == 0 || !socket_->getNotSentBytes(&unsent)){
+        return SIZE_MAX;
+    }
+    return unsent < notSentLowWaterMark_ ? notSentLowWaterMark_ - unsent : 0;
+}
+
+bool TcpConnection::setNotSentLowWaterMark(size_t bytes){
+    // 0会让内核使用sysctl net.ipv4.tcp_notsent_lowat的值，默认不限制
+    if(!socket_->setNotSentLowat(static_cast<uint32_t>(std::min<size_t>(bytes, UINT32_MAX)))){
+        return false;
+    }
+    notSentLowWaterMark_ = bytes;
+    return true;
+}
+
+size_t TcpConnection::sendQuota(){
+    size_t quota = SIZE_MAX;
+    if(!sendLimiter_ && !sharedSendLimiter_){
+        return quota;
+    }
+    Timestamp now(Timestamp::now());
+    if(sendLimiter_){
+        quota = std::min(quota, sendLimiter_->available(now));
+    }
+    if(sharedSendLimiter_){
+        quota = std::min(quota, sharedSendLimiter_->available(now));
+    }
+    return quota;
+}
+
+void TcpConnection::consumeSendQuota(size_t bytes){
+    if(!sendLimiter_ && !sharedSendLimiter_){
+        return;
+    }
+    Timestamp now(Timestamp::now());
+    if(sendLimiter_){
+        sendLimiter_->consume(bytes, now);
+    }
+    if(sharedSendLimiter_){
+        sharedSendLimiter_->consume(bytes, now);
+    }
+}
+
+void TcpConnection::startWriting(){
+    if(sendThrottled_){
+        // 定时器到期后会重新关注写事件
+        return;
+    }
+    if(autoCork_){
+        // 每轮事件循环最多发送一次，不关注写事件
+        if(!corkFlushPending_){
+            corkFlushPending_ = true;
+            loop_->queueInLoop(std::bind(&TcpConnection::flushCorkedOutput, shared_from_this()));
+        }
+        return;
+    }
+    if(sendQuota() == 0){
+        throttleWriting();
+    }else{
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::throttleWriting(){
+    if(sendThrottled_){
+        return;
+    }
+    sendThrottled_ = true;
+    if(channel_->isWritingEvent()){
+        channel_->disableWriting();
+    }
+
+    Timestamp now(Timestamp::now());
+    double delay = 0.001;
+    if(sendLimiter_){
+        delay = std::max(delay, sendLimiter_->delayFor(kRateLimitQuantum, now));
+    }
+    if(sharedSendLimiter_){
+        delay = std::max(delay, sharedSendLimiter_->delayFor(kRateLimitQuantum, now));
+    }
+    // 定时器回调执行时连接可能已经销毁了，用weak_ptr判断
+    std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+    loop_->runAfter(delay, [weakConn](){
+        TcpConnectionPtr conn = weakConn.lock();
+        if(conn){
+            conn->resumeWriting();
+        }
+    });
+}
+
+void TcpConnection::resumeWriting(){
+    sendThrottled_ = false;
+    if((state_ == kConnected || state_ == kDisconnecting) && hasPendingOutput() && !channel_->isWritingEvent()){
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::chargeRecvQuota(size_t bytes){
+    if(!recvLimiter_ && !sharedRecvLimiter_){
+        return;
+    }
+    Timestamp now(Timestamp::now());
+    double delay = 0.0;
+    if(recvLimiter_){
+        recvLimiter_->consume(bytes, now);
+        if(recvLimiter_->available(now) == 0){
+            delay = std::max(delay, recvLimiter_->delayFor(kRateLimitQuantum, now));
+        }
+    }
+    if(sharedRecvLimiter_){
+        sharedRecvLimiter_->consume(bytes, now);
+        if(sharedRecvLimiter_->available(now) == 0){
+            delay = std::max(delay, sharedRecvLimiter_->delayFor(kRateLimitQuantum, now));
+        }
+    }
+
+    if(delay > 0.0 && !(readPauseReasons_ & kPauseByRate)){
+        // 令牌用完了，暂停读，内核接收缓冲区满了以后对方就会停止发送
+        pauseReadingInLoop(kPauseByRate);
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        loop_->runAfter(delay, [weakConn](){
+            TcpConnectionPtr conn = weakConn.lock();
+            if(conn){
+                conn->resumeReadingInLoop(kPauseByRate);
+            }
+        });
+    }
 }
@@ -17,6 +17,16 @@ TcpServer::TcpServer(EventLoop* loop, const InetAddress& listenAddr, const std::
     , threadPool_(new EventLoopThreadPool(loop, name_))                         // EventLoopThreadPool线程池
     , connectionCallback_()                                                     // 
     , messageCallback_()
+    , zeroCopyRegionSize_(0)
+    , highWaterMark_(64*1024*1024)                                              // 64M，和TcpConnection的默认值一致
+    , lowWaterMark_(0)
+    , flowControl_(false)
+    , connSendRate_(0.0)
+    , connRecvRate_(0.0)
+    , kernelPacing_(false)
+    , zeroCopyThreshold_(0)
+    , autoCork_(false)
+    , notSentLowWaterMark_(0)
     , nextConnId_(1)
     , started_(0)
 {   
@@ -40,6 +50,17 @@ TcpServer::~TcpServer(){
 }
 
  
+void TcpServer::setServerRateLimit(double sendBytesPerSecond, double recvBytesPerSecond){
+    serverSendLimiter_.reset();
+    serverRecvLimiter_.reset();
+    if(sendBytesPerSecond > 0.0){
+        serverSendLimiter_ = std::make_shared<TokenBucket>(sendBytesPerSecond);
+    }
+    if(recvBytesPerSecond > 0.0){
+        serverRecvLimiter_ = std::make_shared<TokenBucket>(recvBytesPerSecond);
+    }
+}
+
 //设置底层subloop的个数
 void TcpServer::setThreadNum(int numThreads)
 {
@@ -90,7 +111,36 @@ void TcpServer::newConnection(int connfd, const InetAddress& peerAddr){
     // TcpConnection会把handleRead设置到Channel的readCallBack_，而handleRead就包括了TcpConnection::messageCallback_（on_message）
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
+    if(zeroCopyReadCallback_){
+        conn->setZeroCopyReadCallback(zeroCopyReadCallback_);
+        conn->enableZeroCopyReceive(zeroCopyRegionSize_);
+    }
     conn->setWriteCompleteCallback_(writeCompleteCallback_);
+    conn->setHighWaterMarkCallback_(highWaterMarkCallback_, highWaterMark_);
+    if(flowControl_){
+        conn->setWaterMarks(lowWaterMark_, highWaterMark_);
+    }
+    if(memoryBudget_){
+        conn->setMemoryBudget(memoryBudget_);
+    }
+    if(connSendRate_ > 0.0 && !(kernelPacing_ && conn->setKernelPacingRate(connSendRate_))){
+        conn->setSendRateLimit(connSendRate_);
+    }
+    if(connRecvRate_ > 0.0){
+        conn->setRecvRateLimit(connRecvRate_);
+    }
+    if(serverSendLimiter_ || serverRecvLimiter_){
+        conn->setSharedRateLimiters(serverSendLimiter_, serverRecvLimiter_);
+    }
+    if(zeroCopyThreshold_ > 0){
+        conn->setZeroCopyThreshold(zeroCopyThreshold_);
+    }
+    if(autoCork_){
+        conn->setAutoCork(true);
+    }
+    if(notSentLowWaterMark_ > 0){
+        conn->setNotSentLowWaterMark(notSentLowWaterMark_);
+    }
     // 设置了如何关闭连接的回调   conn->shutDown()
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
 
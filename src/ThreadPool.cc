@@ -0,0 +1,260 @@
+#include "ThreadPool.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(const std::string& nameArg)
+    : name_(nameArg)
+    , maxQueueSize_(0)
+    , orderedWaiting_(0)
+    , running_(false)
+    , peakQueueSize_(0)
+    , completedTasks_(0)
+    , totalWaitMicroSeconds_(0)
+    , maxWaitMicroSeconds_(0)
+{}
+
+ThreadPool::~ThreadPool(){
+    if(running_){
+        stop();
+    }
+}
+
+void ThreadPool::start(int numThreads){
+    running_ = true;
+    threads_.reserve(numThreads);
+    for(int i = 0; i < numThreads; ++i){
+        char buff[name_.size() + 32];  // 用“线程池的名字 + 下标”作为底层线程的名字
+        snprintf(buff, sizeof(buff), "%s%d", name_.c_str(), i);
+        threads_.emplace_back(new Thread(std::bind(&ThreadPool::runInThread, this), buff));
+        threads_[i]->start();
+    }
+    if(numThreads == 0 && threadInitCallback_){
+        threadInitCallback_();
+    }
+}
+
+void ThreadPool::stop(){
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        running_ = false;
+        notEmpty_.notify_all();
+        notFull_.notify_all();
+    }
+    for(std::unique_ptr<Thread>& thread : threads_){
+        thread->join();
+    }
+    // 剩下的有序任务不会再执行了，释放它们持有的连接
+    std::unordered_map<TcpConnection*, OrderedTasks> dropped;
+    {
+        std::unique_lock<std::mutex> lock(orderedMutex_);
+        dropped.swap(ordered_);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        orderedWaiting_ = 0;
+    }
+    if(!dropped.empty()){
+        LOG_ERROR("ThreadPool::stop [%s] drop ordered tasks of %lu connections \n", name_.c_str(), dropped.size());
+    }
+}
+
+size_t ThreadPool::queueSize() const{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return queue_.size() + orderedWaiting_;
+}
+
+// 需要持有mutex_
+void ThreadPool::updatePeakQueueSize(){
+    size_t size = queue_.size() + orderedWaiting_;
+    if(size > peakQueueSize_){
+        peakQueueSize_ = size;
+    }
+}
+
+int64_t ThreadPool::averageWaitMicroSeconds() const{
+    uint64_t completed = completedTasks_;
+    return completed == 0 ? 0 : totalWaitMicroSeconds_ / static_cast<int64_t>(completed);
+}
+
+void ThreadPool::run(Task task){
+    put(std::move(task), true);
+}
+
+bool ThreadPool::tryRun(Task task){
+    return put(std::move(task), false);
+}
+
+bool ThreadPool::put(Task task, bool block){
+    if(threads_.empty()){
+        // 没有工作线程，直接在当前线程执行
+        task();
+        ++completedTasks_;
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(maxQueueSize_ > 0 && queue_.size() + orderedWaiting_ >= maxQueueSize_ && running_){
+        if(!block){
+            return false;
+        }
+        notFull_.wait(lock);
+    }
+    if(!running_){
+        LOG_ERROR("ThreadPool::put [%s] thread pool is stopped, drop the task \n", name_.c_str());
+        return false;
+    }
+
+    queue_.push_back(QueuedTask{std::move(task), Timestamp::now()});
+    updatePeakQueueSize();
+    notEmpty_.notify_one();
+    return true;
+}
+
+bool ThreadPool::take(QueuedTask* task){
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(queue_.empty() && running_){
+        notEmpty_.wait(lock);
+    }
+    if(queue_.empty()){
+        // stop之后队列中的任务都执行完了
+        return false;
+    }
+    *task = std::move(queue_.front());
+    queue_.pop_front();
+    notFull_.notify_one();
+    return true;
+}
+
+void ThreadPool::runInThread(){
+    if(threadInitCallback_){
+        threadInitCallback_();
+    }
+    QueuedTask task;
+    while(take(&task)){
+        int64_t wait = Timestamp::now().microSecondsSinceEpoch() - task.enqueueTime.microSecondsSinceEpoch();
+        totalWaitMicroSeconds_ += wait;
+        int64_t maxWait = maxWaitMicroSeconds_;
+        while(wait > maxWait && !maxWaitMicroSeconds_.compare_exchange_weak(maxWait, wait)){
+        }
+
+        task.task();
+        task.task = Task();  // 及时释放任务捕获的资源
+        ++completedTasks_;
+    }
+}
+
+void ThreadPool::runInOrder(const TcpConnectionPtr& conn, Task work, Task done){
+    putOrdered(conn, std::move(work), std::move(done), true);
+}
+
+bool ThreadPool::tryRunInOrder(const TcpConnectionPtr& conn, Task work, Task done){
+    return putOrdered(conn, std::move(work), std::move(done), false);
+}
+
+bool ThreadPool::putOrdered(const TcpConnectionPtr& conn, Task work, Task done, bool block){
+    TcpConnection* key = conn.get();
+    if(!threads_.empty()){
+        // 先预留队列中的名额，排在连接后面的任务也不能超过队列上限
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(maxQueueSize_ > 0 && queue_.size() + orderedWaiting_ >= maxQueueSize_ && running_){
+            if(!block){
+                return false;
+            }
+            notFull_.wait(lock);
+        }
+        if(!running_){
+            LOG_ERROR("ThreadPool::putOrdered [%s] thread pool is stopped, drop the task \n", name_.c_str());
+            return false;
+        }
+        ++orderedWaiting_;
+        updatePeakQueueSize();
+    }
+    {
+        std::unique_lock<std::mutex> lock(orderedMutex_);
+        auto it = ordered_.find(key);
+        if(it != ordered_.end()){
+            // 这条连接已经有任务在排队或者正在执行，排在后面，由前一个任务执行完后提交
+            it->second.tasks.emplace_back(std::move(work), std::move(done));
+            return true;
+        }
+        OrderedTasks& entry = ordered_[key];
+        entry.conn = conn;
+        entry.tasks.emplace_back(std::move(work), std::move(done));
+    }
+    scheduleOrdered(key);
+    return true;
+}
+
+void ThreadPool::scheduleOrdered(TcpConnection* key){
+    if(threads_.empty()){
+        // 没有工作线程，直接在当前线程执行
+        runOrdered(key);
+        return;
+    }
+    bool queued = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        --orderedWaiting_;
+        if(running_){
+            // 名额已经预留过，不再检查队列上限，工作线程提交后续任务时也不会阻塞在自己的队列上
+            queue_.push_back(QueuedTask{std::bind(&ThreadPool::runOrdered, this, key), Timestamp::now()});
+            notEmpty_.notify_one();
+            queued = true;
+        }
+    }
+    if(!queued){
+        // 线程池已经停止，这条连接剩下的任务都不会执行了，删除记录，释放连接
+        size_t rest = 0;
+        {
+            std::unique_lock<std::mutex> lock(orderedMutex_);
+            auto it = ordered_.find(key);
+            if(it != ordered_.end()){
+                rest = it->second.tasks.size() - 1;
+                ordered_.erase(it);
+            }
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            orderedWaiting_ -= std::min(rest, orderedWaiting_);
+        }
+        LOG_ERROR("ThreadPool::scheduleOrdered [%s] thread pool is stopped, drop %lu ordered tasks \n", name_.c_str(), rest + 1);
+    }
+}
+
+// 执行一条连接最早提交的任务，执行完后如果还有任务，再提交到队列尾部，让其他连接的任务也有机会执行
+void ThreadPool::runOrdered(TcpConnection* key){
+    TcpConnectionPtr conn;
+    std::pair<Task, Task> task;
+    {
+        std::unique_lock<std::mutex> lock(orderedMutex_);
+        OrderedTasks& entry = ordered_[key];
+        conn = entry.conn;
+        task = std::move(entry.tasks.front());
+        entry.tasks.pop_front();
+    }
+
+    if(task.first){
+        task.first();
+    }
+    if(task.second){
+        // 同一条连接的done按顺序进入loop的pendingFunctors_，执行顺序和提交顺序一致
+        conn->getLoop()->queueInLoop(std::move(task.second));
+    }
+
+    bool more = false;
+    {
+        std::unique_lock<std::mutex> lock(orderedMutex_);
+        auto it = ordered_.find(key);
+        if(it->second.tasks.empty()){
+            ordered_.erase(it);
+        }else{
+            more = true;
+        }
+    }
+    if(more){
+        scheduleOrdered(key);
+    }
+}
@@ -1,5 +1,7 @@
 #include "Timestamp.h"
 
+#include <sys/time.h>
+
 Timestamp::Timestamp()
     :microSecondsSinceEpoch_(0)
 {}
@@ -9,13 +11,16 @@ Timestamp::Timestamp(int64_t microSecondsSinceEpoch)
 {}
 
 Timestamp Timestamp::now(){
-    // 用time_t类型构造Timestamp类型，并返回Timestamp对象
-    return Timestamp(time(NULL));
+    // 定时器需要微秒级的精度，time(NULL)只能精确到秒
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return Timestamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string Timestamp::toString() const{
     char buff[128] = {0};
-    tm* tm_time = localtime(&microSecondsSinceEpoch_); // 时间戳转换为结构体tm类型
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm* tm_time = localtime(&seconds); // 时间戳转换为结构体tm类型
     snprintf(buff, 128, "%4d-%02d-%02d %02d:%02d:%02d", 
         tm_time->tm_year + 1900,
         tm_time->tm_mon + 1,
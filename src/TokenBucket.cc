@@ -0,0 +1,39 @@
+#include "TokenBucket.h"
+
+#include <algorithm>
+
+static const double kMinBurst = 16 * 1024;
+
+TokenBucket::TokenBucket(double bytesPerSecond, double burst)
+    : rate_(bytesPerSecond)
+    , burst_(burst > 0.0 ? burst : std::max(bytesPerSecond / 10, kMinBurst))
+    , tokens_(burst_)                       // 初始时桶是满的
+    , lastRefill_(Timestamp::now())
+{}
+
+size_t TokenBucket::available(Timestamp now){
+    std::unique_lock<std::mutex> lock(mutex_);
+    refill(now);
+    return tokens_ > 0.0 ? static_cast<size_t>(tokens_) : 0;
+}
+
+void TokenBucket::consume(size_t bytes, Timestamp now){
+    std::unique_lock<std::mutex> lock(mutex_);
+    refill(now);
+    tokens_ -= static_cast<double>(bytes);
+}
+
+double TokenBucket::delayFor(size_t bytes, Timestamp now){
+    std::unique_lock<std::mutex> lock(mutex_);
+    refill(now);
+    double need = std::min(static_cast<double>(bytes), burst_) - tokens_;
+    return need > 0.0 ? need / rate_ : 0.0;
+}
+
+void TokenBucket::refill(Timestamp now){
+    double elapsed = timeDifference(now, lastRefill_);
+    if(elapsed > 0.0){
+        tokens_ = std::min(burst_, tokens_ + elapsed * rate_);
+        lastRefill_ = now;
+    }
+}
@@ -0,0 +1,96 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "Socket.h"
+#include "Logger.h"
+
+#include <functional>
+
+static EventLoop* CheckLoopNotNull(EventLoop* loop){
+    if(loop == nullptr){
+        LOG_FATAL("%s:%s%d mainloop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg, Option option)
+    : loop_(CheckLoopNotNull(loop))
+    , listenAddr_(listenAddr)
+    , name_(nameArg)
+    , reusePort_(option == kReusePort)
+    , threadPool_(new EventLoopThreadPool(loop, nameArg))
+    , batchSize_(64)
+    , maxDatagramSize_(2048)
+    , recvBufferSize_(0)
+    , gso_(false)
+    , gro_(false)
+    , started_(0)
+{
+}
+
+UdpServer::~UdpServer(){
+    for(UdpSocketPtr& socket : sockets_){
+        // 在socket所在的loop中注销Channel，回调持有shared_ptr，执行完以后才析构
+        socket->getLoop()->runInLoop(std::bind(&UdpSocket::stop, socket));
+    }
+}
+
+void UdpServer::setThreadNum(int numThreads){
+    threadPool_->setThreadNum(numThreads);
+}
+
+void UdpServer::start(){
+    if(started_++ != 0){
+        return;
+    }
+    threadPool_->start(threadInitCallback_);
+    // 没有subloop时getAllLoops返回baseloop
+    std::vector<EventLoop*> loops = reusePort_ ? threadPool_->getAllLoops() : std::vector<EventLoop*>(1, threadPool_->getNextLoop());
+    for(size_t i = 0; i < loops.size(); ++i){
+        int sockfd = UdpSocket::createBound(listenAddr_, reusePort_);
+        if(sockfd < 0){
+            LOG_FATAL("UdpServer::start [%s] bind %s fail \n", name_.c_str(), listenAddr_.toIpPort().c_str());
+        }
+        char buff[64];
+        snprintf(buff, sizeof(buff), "-%s#%lu", listenAddr_.toIpPort().c_str(), i);
+        UdpSocketPtr socket(new UdpSocket(loops[i], name_ + buff, sockfd, batchSize_, maxDatagramSize_));
+        if(recvBufferSize_ > 0){
+            socket->socket()->setRecvBufferSize(recvBufferSize_);
+        }
+        // socket还没有注册到loop中，可以在当前线程设置
+        if(gro_){
+            socket->enableGro();
+        }
+        if(gso_){
+            socket->enableGso();
+        }
+        socket->setMessageCallback(messageCallback_);
+        sockets_.push_back(socket);
+        loops[i]->runInLoop(std::bind(&UdpSocket::start, socket));
+    }
+    LOG_INFO("UdpServer::start [%s] - %lu socket(s) on %s \n", name_.c_str(), sockets_.size(), listenAddr_.toIpPort().c_str());
+}
+
+uint64_t UdpServer::receivedDatagrams() const {
+    uint64_t total = 0;
+    for(const UdpSocketPtr& socket : sockets_){
+        total += socket->receivedDatagrams();
+    }
+    return total;
+}
+
+uint64_t UdpServer::sentDatagrams() const {
+    uint64_t total = 0;
+    for(const UdpSocketPtr& socket : sockets_){
+        total += socket->sentDatagrams();
+    }
+    return total;
+}
+
+uint64_t UdpServer::droppedDatagrams() const {
+    uint64_t total = 0;
+    for(const UdpSocketPtr& socket : sockets_){
+        total += socket->droppedDatagrams();
+    }
+    return total;
+}
@@ -0,0 +1,421 @@
+#include "UdpSocket.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <functional>
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+// 老版本的头文件中没有，内核4.18开始支持UDP_SEGMENT，5.0开始支持UDP_GRO
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+// 内核合并以后的缓冲区最大是一个IP包的大小
+static const size_t kMaxGroBuffer = 65535;
+// 接收UDP_GRO控制消息（一个int）需要的空间
+static const size_t kGroControlSpace = CMSG_SPACE(sizeof(int));
+
+static EventLoop* CheckLoopNotNull(EventLoop* loop){
+    if(loop == nullptr){
+        LOG_FATAL("%s:%s%d UdpSocket Loop is null! \n", __FILE__, __FUNCTION__, __LINE__);
+    }
+    return loop;
+}
+
+// 一个消息对应的数据报个数，segmentSize为0表示没有切分
+static size_t segmentCount(size_t length, size_t segmentSize){
+    if(segmentSize == 0 || length <= segmentSize){
+        return 1;
+    }
+    return (length + segmentSize - 1) / segmentSize;
+}
+
+UdpSocket::UdpSocket(EventLoop* loop, const std::string& nameArg, int sockfd, int batchSize, size_t maxDatagramSize)
+    : loop_(CheckLoopNotNull(loop))
+    , name_(nameArg)
+    , socket_(new Socket(sockfd))
+    , channel_(new Channel(loop, sockfd))
+    , batchSize_(std::max(batchSize, 1))
+    , maxDatagramSize_(std::max(maxDatagramSize, static_cast<size_t>(1)))
+    , recvSlotSize_(0)
+    , recvMsgs_(batchSize_)
+    , recvIovecs_(batchSize_)
+    , recvAddrs_(batchSize_)
+    , gso_(false)
+    , gro_(false)
+    , sendHead_(0)
+    , maxQueuedBytes_(4*1024*1024)
+    , inReceiveBatch_(false)
+    , flushQueued_(false)
+    , receivedDatagrams_(0)
+    , receiveCalls_(0)
+    , truncatedDatagrams_(0)
+    , sentDatagrams_(0)
+    , sendCalls_(0)
+    , droppedDatagrams_(0)
+    , coalescedReceives_(0)
+{
+    setupReceiveArena(maxDatagramSize_);
+    channel_->setReadCallBack(std::bind(&UdpSocket::handleRead, this, std::placeholders::_1));
+    channel_->setWriteCallBack(std::bind(&UdpSocket::handleWrite, this));
+    channel_->setErrorCallBack(std::bind(&UdpSocket::handleError, this));
+    LOG_INFO("UdpSocket::UdpSocket[%s] as fd=%d \n", name_.c_str(), sockfd);
+}
+
+UdpSocket::~UdpSocket(){
+    LOG_INFO("UdpSocket::~UdpSocket[%s] as fd=%d \n", name_.c_str(), socket_->fd());
+}
+
+int UdpSocket::createBound(const InetAddress& addr, bool reusePort){
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if(sockfd < 0){
+        LOG_ERROR("%s:%s:%d udp socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
+        return -1;
+    }
+    int on = 1;
+    ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if(reusePort){
+        // 每个loop一个socket，内核按四元组的哈希把数据报分给不同的socket
+        ::setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+    if(::bind(sockfd, (const sockaddr*)addr.getSockAddr(), sizeof(sockaddr_in)) < 0){
+        LOG_ERROR("%s:%s:%d udp bind %s err:%d \n", __FILE__, __FUNCTION__, __LINE__, addr.toIpPort().c_str(), errno);
+        ::close(sockfd);
+        return -1;
+    }
+    return sockfd;
+}
+
+int UdpSocket::fd() const {
+    return socket_->fd();
+}
+
+// iovec、地址和控制消息的指针只设置一次，每次recvmmsg之前只需要重置长度
+void UdpSocket::setupReceiveArena(size_t slotSize){
+    recvSlotSize_ = slotSize;
+    std::vector<char>(batchSize_ * slotSize).swap(recvArena_);
+    std::vector<char>(gro_ ? batchSize_ * kGroControlSpace : 0).swap(recvControl_);
+    for(int i = 0; i < batchSize_; ++i){
+        recvIovecs_[i].iov_base = recvArena_.data() + i * slotSize;
+        recvIovecs_[i].iov_len = slotSize;
+        memset(&recvMsgs_[i], 0, sizeof(mmsghdr));
+        recvMsgs_[i].msg_hdr.msg_iov = &recvIovecs_[i];
+        recvMsgs_[i].msg_hdr.msg_iovlen = 1;
+        recvMsgs_[i].msg_hdr.msg_name = &recvAddrs_[i];
+        if(gro_){
+            recvMsgs_[i].msg_hdr.msg_control = recvControl_.data() + i * kGroControlSpace;
+        }
+    }
+}
+
+// 设置为0不改变socket的默认行为，只用来探测内核是否支持，切分大小由每个消息的控制消息指定
+bool UdpSocket::enableGso(){
+    int segmentSize = 0;
+    if(::setsockopt(socket_->fd(), SOL_UDP, UDP_SEGMENT, &segmentSize, sizeof(segmentSize)) < 0){
+        LOG_ERROR("UdpSocket::enableGso [%s] UDP_SEGMENT not supported err:%d \n", name_.c_str(), errno);
+        gso_ = false;
+        return false;
+    }
+    gso_ = true;
+    return true;
+}
+
+bool UdpSocket::enableGro(){
+    if(gro_){
+        return true;
+    }
+    int on = 1;
+    if(::setsockopt(socket_->fd(), SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0){
+        LOG_ERROR("UdpSocket::enableGro [%s] UDP_GRO not supported err:%d \n", name_.c_str(), errno);
+        return false;
+    }
+    gro_ = true;
+    setupReceiveArena(std::max(maxDatagramSize_, kMaxGroBuffer));
+    return true;
+}
+
+void UdpSocket::start(){
+    // UdpServer析构时在loop线程中stop，tie保证处理事件期间UdpSocket不会被析构
+    channel_->tie(shared_from_this());
+    channel_->enableReading();
+}
+
+void UdpSocket::stop(){
+    channel_->disableAll();
+    channel_->remove();
+}
+
+// 一次recvmmsg收一批数据报，收满了说明内核中可能还有，继续收，最多kMaxReceiveRounds批
+// 回调中的send先排队，所有数据报处理完以后一起sendmmsg
+void UdpSocket::handleRead(Timestamp receiveTime){
+    UdpSocketPtr self(shared_from_this());
+    inReceiveBatch_ = true;
+    for(int round = 0; round < kMaxReceiveRounds; ++round){
+        for(int i = 0; i < batchSize_; ++i){
+            recvMsgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            recvMsgs_[i].msg_hdr.msg_flags = 0;
+            recvMsgs_[i].msg_hdr.msg_controllen = gro_ ? kGroControlSpace : 0;
+        }
+        int n = ::recvmmsg(channel_->fd(), recvMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+        if(n < 0){
+            if(errno != EAGAIN && errno != EINTR){
+                LOG_ERROR("UdpSocket::handleRead [%s] recvmmsg error:%d \n", name_.c_str(), errno);
+            }
+            break;
+        }
+        ++receiveCalls_;
+        for(int i = 0; i < n; ++i){
+            msghdr& hdr = recvMsgs_[i].msg_hdr;
+            size_t length = recvMsgs_[i].msg_len;
+            size_t segmentSize = length;
+            if(gro_){
+                // 内核合并了多个数据报时带有UDP_GRO控制消息，内容是每个数据报的大小
+                for(cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)){
+                    if(cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO){
+                        int gsoSize = 0;
+                        memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof(gsoSize));
+                        if(gsoSize > 0 && static_cast<size_t>(gsoSize) < length){
+                            segmentSize = gsoSize;
+                            ++coalescedReceives_;
+                        }
+                        break;
+                    }
+                }
+            }
+            receivedDatagrams_ += segmentCount(length, segmentSize);
+            if(hdr.msg_flags & MSG_TRUNC){
+                // 数据报比接收区大，剩下的部分已经被内核丢弃了
+                ++truncatedDatagrams_;
+                continue;
+            }
+            if(messageCallback_){
+                UdpDatagram datagram = { static_cast<const char*>(recvIovecs_[i].iov_base), length, InetAddress(recvAddrs_[i]), segmentSize };
+                messageCallback_(self, datagram, receiveTime);
+            }
+        }
+        if(n < batchSize_){
+            break;
+        }
+    }
+    inReceiveBatch_ = false;
+    if(sendHead_ < sendQueue_.size() && !channel_->isWritingEvent()){
+        flushSendQueue();
+    }
+}
+
+void UdpSocket::handleWrite(){
+    if(channel_->isWritingEvent()){
+        flushSendQueue();
+    }
+}
+
+void UdpSocket::handleError(){
+    int optval = 0;
+    socklen_t optlen = static_cast<socklen_t>(sizeof(optval));
+    // 读出SO_ERROR，比如对端端口不可达（ICMP），否则EPOLLERR会一直触发
+    ::getsockopt(channel_->fd(), SOL_SOCKET, SO_ERROR, &optval, &optlen);
+    LOG_ERROR("UdpSocket::handleError name : %s - SO_ERROR: %d \n", name_.c_str(), optval);
+}
+
+void UdpSocket::send(const InetAddress& peer, const void* data, size_t len){
+    if(loop_->isInLoopThread()){
+        sendInLoop(*peer.getSockAddr(), data, len);
+    }else{
+        loop_->runInLoop(std::bind(&UdpSocket::sendStringInLoop, shared_from_this(), peer, std::string(static_cast<const char*>(data), len)));
+    }
+}
+
+void UdpSocket::send(const InetAddress& peer, const std::string& data){
+    send(peer, data.data(), data.size());
+}
+
+void UdpSocket::sendStringInLoop(const InetAddress& peer, const std::string& data){
+    sendInLoop(*peer.getSockAddr(), data.data(), data.size());
+}
+
+void UdpSocket::sendInLoop(const sockaddr_in& peer, const void* data, size_t len){
+    if(sendArena_.readableBytes() + len > maxQueuedBytes_){
+        ++droppedDatagrams_;
+        return;
+    }
+    PendingDatagram datagram;
+    datagram.peer = peer;
+    datagram.offset = sendArena_.readableBytes();
+    datagram.length = len;
+    datagram.segmentSize = 0;
+    sendArena_.append(static_cast<const char*>(data), len);
+    sendQueue_.push_back(datagram);
+    if(!inReceiveBatch_ && !channel_->isWritingEvent()){
+        queueFlush();
+    }
+}
+
+void UdpSocket::sendSegmented(const InetAddress& peer, const void* data, size_t len, size_t segmentSize){
+    if(loop_->isInLoopThread()){
+        sendSegmentedInLoop(*peer.getSockAddr(), static_cast<const char*>(data), len, segmentSize);
+    }else{
+        loop_->runInLoop(std::bind(&UdpSocket::sendSegmentedStringInLoop, shared_from_this(), peer, std::string(static_cast<const char*>(data), len), segmentSize));
+    }
+}
+
+void UdpSocket::sendSegmentedStringInLoop(const InetAddress& peer, const std::string& data, size_t segmentSize){
+    sendSegmentedInLoop(*peer.getSockAddr(), data.data(), data.size(), segmentSize);
+}
+
+// 数据只拷贝一次到sendArena_，开启GSO时每个消息最多kMaxGsoSegments个数据报，否则每个数据报一个消息
+void UdpSocket::sendSegmentedInLoop(const sockaddr_in& peer, const char* data, size_t len, size_t segmentSize){
+    if(segmentSize == 0 || len <= segmentSize){
+        sendInLoop(peer, data, len);
+        return;
+    }
+    if(sendArena_.readableBytes() + len > maxQueuedBytes_){
+        droppedDatagrams_ += segmentCount(len, segmentSize);
+        return;
+    }
+    // 一个GSO消息的长度必须是segmentSize的整数倍（最后一个消息除外），并且不能超过一个UDP包的大小
+    size_t messageSize = segmentSize;
+    if(gso_ && segmentSize <= kMaxUdpPayload){
+        messageSize = std::min(static_cast<size_t>(kMaxGsoSegments), kMaxUdpPayload / segmentSize) * segmentSize;
+    }
+    size_t offset = sendArena_.readableBytes();
+    sendArena_.append(data, len);
+    for(size_t pos = 0; pos < len; pos += messageSize){
+        PendingDatagram datagram;
+        datagram.peer = peer;
+        datagram.offset = offset + pos;
+        datagram.length = std::min(messageSize, len - pos);
+        datagram.segmentSize = datagram.length > segmentSize ? segmentSize : 0;
+        sendQueue_.push_back(datagram);
+    }
+    if(!inReceiveBatch_ && !channel_->isWritingEvent()){
+        queueFlush();
+    }
+}
+
+// 同一轮事件循环中的多次send合并成一次sendmmsg
+void UdpSocket::queueFlush(){
+    if(!flushQueued_){
+        flushQueued_ = true;
+        UdpSocketPtr self(shared_from_this());
+        loop_->queueInLoop([self](){
+            self->flushQueued_ = false;
+            if(!self->channel_->isWritingEvent()){
+                self->flushSendQueue();
+            }
+        });
+    }
+}
+
+void UdpSocket::flushSendQueue(){
+    mmsghdr msgs[kMaxSendBatch];
+    iovec iovecs[kMaxSendBatch];
+    // GSO消息的UDP_SEGMENT控制消息，union保证cmsghdr的对齐
+    union SegmentControl{
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        cmsghdr align;
+    } controls[kMaxSendBatch];
+    while(sendHead_ < sendQueue_.size()){
+        int count = static_cast<int>(std::min(sendQueue_.size() - sendHead_, static_cast<size_t>(kMaxSendBatch)));
+        for(int i = 0; i < count; ++i){
+            PendingDatagram& datagram = sendQueue_[sendHead_ + i];
+            iovecs[i].iov_base = const_cast<char*>(sendArena_.peek()) + datagram.offset;
+            iovecs[i].iov_len = datagram.length;
+            memset(&msgs[i], 0, sizeof(mmsghdr));
+            msgs[i].msg_hdr.msg_iov = &iovecs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &datagram.peer;
+            msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            if(datagram.segmentSize > 0){
+                msgs[i].msg_hdr.msg_control = controls[i].buf;
+                msgs[i].msg_hdr.msg_controllen = sizeof(controls[i].buf);
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t segmentSize = static_cast<uint16_t>(datagram.segmentSize);
+                memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+            }
+        }
+        int n = ::sendmmsg(channel_->fd(), msgs, count, MSG_DONTWAIT);
+        if(n < 0){
+            if(errno == EAGAIN || errno == ENOBUFS){
+                // 内核发送缓冲区满了，等EPOLLOUT再发，已经发送的部分先释放，queuedBytes只计算还没发送的数据
+                compactSendQueue();
+                if(!channel_->isWritingEvent()){
+                    channel_->enableWriting();
+                }
+                return;
+            }
+            const PendingDatagram& head = sendQueue_[sendHead_];
+            if(head.segmentSize > 0 && (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP)){
+                // 出口设备不支持校验和卸载（EIO）或者切分大小超过了MTU（EINVAL），改成每个数据报一个消息重新发送
+                LOG_ERROR("UdpSocket::flushSendQueue [%s] GSO rejected err:%d, fall back to plain datagrams \n", name_.c_str(), errno);
+                disableGso();
+                continue;
+            }
+            // 第一个数据报发送失败（比如地址不可达），丢弃它，继续发送后面的
+            LOG_ERROR("UdpSocket::flushSendQueue [%s] sendmmsg error:%d \n", name_.c_str(), errno);
+            droppedDatagrams_ += segmentCount(head.length, head.segmentSize);
+            n = 1;
+        }else{
+            ++sendCalls_;
+            for(int i = 0; i < n; ++i){
+                const PendingDatagram& datagram = sendQueue_[sendHead_ + i];
+                sentDatagrams_ += segmentCount(datagram.length, datagram.segmentSize);
+            }
+        }
+        sendHead_ += n;
+    }
+    sendQueue_.clear();
+    sendArena_.retrieveAll();
+    sendHead_ = 0;
+    if(channel_->isWritingEvent()){
+        channel_->disableWriting();
+    }
+}
+
+// 队列中的数据按顺序存放在sendArena_中，sendHead_之前的数据报占用的就是sendArena_开头的这些字节
+void UdpSocket::compactSendQueue(){
+    if(sendHead_ == 0){
+        return;
+    }
+    size_t sentBytes = sendQueue_[sendHead_].offset;
+    sendArena_.retrieve(sentBytes);
+    sendQueue_.erase(sendQueue_.begin(), sendQueue_.begin() + sendHead_);
+    for(PendingDatagram& datagram : sendQueue_){
+        datagram.offset -= sentBytes;
+    }
+    sendHead_ = 0;
+}
+
+void UdpSocket::disableGso(){
+    gso_ = false;
+    std::vector<PendingDatagram> pending;
+    pending.reserve(sendQueue_.size() - sendHead_);
+    for(size_t i = sendHead_; i < sendQueue_.size(); ++i){
+        const PendingDatagram& datagram = sendQueue_[i];
+        if(datagram.segmentSize == 0){
+            pending.push_back(datagram);
+            continue;
+        }
+        for(size_t pos = 0; pos < datagram.length; pos += datagram.segmentSize){
+            PendingDatagram segment = datagram;
+            segment.offset = datagram.offset + pos;
+            segment.length = std::min(datagram.segmentSize, datagram.length - pos);
+            segment.segmentSize = 0;
+            pending.push_back(segment);
+        }
+    }
+    sendQueue_.swap(pending);
+    sendHead_ = 0;
+}
@@ -0,0 +1,224 @@
+#include "UpstreamPool.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+#include <sys/socket.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+// 空闲连接上收到的数据直接丢弃
+static void discardMessage(const TcpConnectionPtr&, Buffer* buff, Timestamp){
+    buff->retrieveAll();
+}
+
+static void ignoreConnection(const TcpConnectionPtr&){
+}
+
+UpstreamPool::UpstreamPool(const InetAddress& serverAddr, const std::string& nameArg, size_t maxConnectionsPerLoop)
+    : serverAddr_(serverAddr)
+    , name_(nameArg)
+    , maxConnectionsPerLoop_(maxConnectionsPerLoop)
+    , idleTimeout_(0.0)
+    , acquireTimeout_(0.0)
+    , maxWaitersPerLoop_(1024)
+    , connectRetries_(2)
+{}
+
+UpstreamPool::~UpstreamPool(){
+    for(auto& item : pools_){
+        for(const ConnectorPtr& connector : item.second->connectors){
+            connector->stop();
+        }
+    }
+}
+
+UpstreamPool::LoopPool* UpstreamPool::getLoopPool(EventLoop* loop){
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_ptr<LoopPool>& pool = pools_[loop];
+    if(!pool){
+        pool.reset(new LoopPool);
+        pool->loop = loop;
+        pool->total = 0;
+        pool->nextConnId = 1;
+        pool->nextWaiterId = 1;
+        if(idleTimeout_ > 0.0){
+            LoopPool* p = pool.get();
+            loop->runEvery(idleTimeout_ / 2, std::bind(&UpstreamPool::closeIdleConnections, this, p));
+        }
+    }
+    return pool.get();
+}
+
+void UpstreamPool::acquire(EventLoop* loop, AcquireCallback cb){
+    LoopPool* pool = getLoopPool(loop);
+    // 优先使用最近归还的连接
+    while(!pool->idle.empty()){
+        TcpConnectionPtr conn = pool->idle.back().first;
+        pool->idle.pop_back();
+        if(conn->connected()){
+            cb(conn);
+            return;
+        }
+    }
+
+    if(pool->waiters.size() >= maxWaitersPerLoop_){
+        LOG_ERROR("UpstreamPool::acquire [%s] %lu requests waiting, reject \n", name_.c_str(), pool->waiters.size());
+        cb(TcpConnectionPtr());
+        return;
+    }
+    Waiter waiter;
+    waiter.id = pool->nextWaiterId++;
+    waiter.cb = std::move(cb);
+    if(acquireTimeout_ > 0.0){
+        waiter.timer = loop->runAfter(acquireTimeout_, std::bind(&UpstreamPool::acquireTimeout, this, pool, waiter.id));
+    }
+    pool->waiters.push_back(std::move(waiter));
+    if(pool->total < maxConnectionsPerLoop_){
+        connectNew(pool);
+    }
+}
+
+void UpstreamPool::acquireTimeout(LoopPool* pool, uint64_t waiterId){
+    for(auto it = pool->waiters.begin(); it != pool->waiters.end(); ++it){
+        if(it->id == waiterId){
+            AcquireCallback cb = std::move(it->cb);
+            pool->waiters.erase(it);
+            LOG_ERROR("UpstreamPool::acquireTimeout [%s] no connection in %.3f seconds \n", name_.c_str(), acquireTimeout_);
+            cb(TcpConnectionPtr());
+            return;
+        }
+    }
+}
+
+void UpstreamPool::release(const TcpConnectionPtr& conn, bool reusable){
+    // 可能是在这条连接的MessageCallback中调用的，延后到回调返回以后再处理，避免正在执行的回调被替换
+    conn->getLoop()->queueInLoop(std::bind(&UpstreamPool::releaseInLoop, this, conn, reusable));
+}
+
+void UpstreamPool::releaseInLoop(const TcpConnectionPtr& conn, bool reusable){
+    LoopPool* pool = getLoopPool(conn->getLoop());
+    conn->setMessageCallback(discardMessage);
+    if(!reusable || !conn->connected()){
+        // 连接关闭后在removeConnection中减少计数
+        conn->forceClose();
+        return;
+    }
+    handOut(pool, conn);
+}
+
+void UpstreamPool::handOut(LoopPool* pool, const TcpConnectionPtr& conn){
+    if(!pool->waiters.empty()){
+        Waiter waiter = std::move(pool->waiters.front());
+        pool->waiters.pop_front();
+        if(acquireTimeout_ > 0.0){
+            pool->loop->cancel(waiter.timer);
+        }
+        waiter.cb(conn);
+    }else{
+        pool->idle.emplace_back(conn, Timestamp::now());
+    }
+}
+
+void UpstreamPool::connectNew(LoopPool* pool){
+    ++pool->total;
+    ConnectorPtr connector(new Connector(pool->loop, serverAddr_));
+    // 回调中不能持有connector的shared_ptr，否则循环引用
+    connector->setNewConnectionCallback(std::bind(&UpstreamPool::newConnection, this, pool, connector.get(), std::placeholders::_1));
+    connector->setConnectFailedCallback(std::bind(&UpstreamPool::connectFailed, this, pool, connector.get(), std::placeholders::_1));
+    connector->setMaxRetries(connectRetries_);
+    pool->connectors.insert(connector);
+    connector->start();
+}
+
+// Connector还在自己的回调中，延后释放
+void UpstreamPool::removeConnector(LoopPool* pool, Connector* connector){
+    pool->loop->queueInLoop([pool, connector](){
+        for(auto it = pool->connectors.begin(); it != pool->connectors.end(); ++it){
+            if(it->get() == connector){
+                pool->connectors.erase(it);
+                break;
+            }
+        }
+    });
+}
+
+void UpstreamPool::connectFailed(LoopPool* pool, Connector* connector, int err){
+    removeConnector(pool, connector);
+    --pool->total;
+    if(pool->total > 0){
+        // 还有其他连接，排队的请求可以等它们归还，由acquireTimeout_兜底
+        return;
+    }
+    LOG_ERROR("UpstreamPool::connectFailed [%s] connect %s error:%d, fail %lu waiting requests \n",
+              name_.c_str(), serverAddr_.toIpPort().c_str(), err, pool->waiters.size());
+    // 回调中可能再次acquire，先取出来再回调
+    std::deque<Waiter> waiters;
+    waiters.swap(pool->waiters);
+    for(Waiter& waiter : waiters){
+        if(acquireTimeout_ > 0.0){
+            pool->loop->cancel(waiter.timer);
+        }
+        waiter.cb(TcpConnectionPtr());
+    }
+}
+
+void UpstreamPool::newConnection(LoopPool* pool, Connector* connector, int sockfd){
+    removeConnector(pool, connector);
+
+    sockaddr_in peer, local;
+    socklen_t addrLen = sizeof(peer);
+    memset(&peer, 0, sizeof(peer));
+    memset(&local, 0, sizeof(local));
+    ::getpeername(sockfd, (sockaddr*)&peer, &addrLen);
+    addrLen = sizeof(local);
+    ::getsockname(sockfd, (sockaddr*)&local, &addrLen);
+
+    char buff[64];
+    snprintf(buff, sizeof(buff), ":%s#%d", serverAddr_.toIpPort().c_str(), pool->nextConnId);
+    ++pool->nextConnId;
+
+    TcpConnectionPtr conn(new TcpConnection(pool->loop, name_ + buff, sockfd, InetAddress(local), InetAddress(peer)));
+    conn->setConnectionCallback(ignoreConnection);
+    conn->setMessageCallback(discardMessage);
+    conn->setCloseCallback(std::bind(&UpstreamPool::removeConnection, this, pool, std::placeholders::_1));
+    pool->connections.insert(conn);
+    conn->connectEstablished();
+    handOut(pool, conn);
+}
+
+void UpstreamPool::removeConnection(LoopPool* pool, const TcpConnectionPtr& conn){
+    --pool->total;
+    pool->connections.erase(conn);
+    for(auto it = pool->idle.begin(); it != pool->idle.end(); ++it){
+        if(it->first == conn){
+            pool->idle.erase(it);
+            break;
+        }
+    }
+    pool->loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+
+    // 有请求在排队，补充一条连接
+    if(!pool->waiters.empty() && pool->total < maxConnectionsPerLoop_){
+        connectNew(pool);
+    }
+}
+
+void UpstreamPool::closeIdleConnections(LoopPool* pool){
+    Timestamp now(Timestamp::now());
+    // idle队列按归还时间排序，最早归还的在前面
+    while(!pool->idle.empty() && timeDifference(now, pool->idle.front().second) > idleTimeout_){
+        TcpConnectionPtr conn = pool->idle.front().first;
+        pool->idle.pop_front();
+        conn->forceClose();
+    }
+}
+
+size_t UpstreamPool::idleConnections(EventLoop* loop){
+    return getLoopPool(loop)->idle.size();
+}
+
+size_t UpstreamPool::totalConnections(EventLoop* loop){
+    return getLoopPool(loop)->total;
+}
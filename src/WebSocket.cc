@@ -0,0 +1,245 @@
+#include "WebSocket.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <endian.h>
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define MYMUDUO_X86_SIMD 1
+#endif
+
+namespace WebSocket{
+    static const char kGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    static inline uint32_t rotl32(uint32_t x, int n){
+        return (x << n) | (x >> (32 - n));
+    }
+
+    // 只用于握手，数据很短，简单实现
+    static void sha1(const char* data, size_t len, unsigned char digest[20]){
+        uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        // 补位：0x80，若干个0，最后8字节是比特长度
+        std::string msg(data, len);
+        msg.push_back(static_cast<char>(0x80));
+        while(msg.size() % 64 != 56){
+            msg.push_back('\0');
+        }
+        uint64_t bits = htobe64(static_cast<uint64_t>(len) * 8);
+        msg.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+
+        for(size_t chunk = 0; chunk < msg.size(); chunk += 64){
+            uint32_t w[80];
+            for(int i = 0; i < 16; ++i){
+                uint32_t be32;
+                memcpy(&be32, msg.data() + chunk + i * 4, sizeof(be32));
+                w[i] = be32toh(be32);
+            }
+            for(int i = 16; i < 80; ++i){
+                w[i] = rotl32(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1);
+            }
+            uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+            for(int i = 0; i < 80; ++i){
+                uint32_t f, k;
+                if(i < 20){
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }else if(i < 40){
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }else if(i < 60){
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }else{
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t temp = rotl32(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotl32(b, 30);
+                b = a;
+                a = temp;
+            }
+            h[0] += a;
+            h[1] += b;
+            h[2] += c;
+            h[3] += d;
+            h[4] += e;
+        }
+        for(int i = 0; i < 5; ++i){
+            uint32_t be32 = htobe32(h[i]);
+            memcpy(digest + i * 4, &be32, sizeof(be32));
+        }
+    }
+
+    static std::string base64(const unsigned char* data, size_t len){
+        static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        out.reserve((len + 2) / 3 * 4);
+        for(size_t i = 0; i < len; i += 3){
+            uint32_t n = static_cast<uint32_t>(data[i]) << 16;
+            if(i + 1 < len){
+                n |= static_cast<uint32_t>(data[i+1]) << 8;
+            }
+            if(i + 2 < len){
+                n |= data[i+2];
+            }
+            out.push_back(kTable[(n >> 18) & 63]);
+            out.push_back(kTable[(n >> 12) & 63]);
+            out.push_back(i + 1 < len ? kTable[(n >> 6) & 63] : '=');
+            out.push_back(i + 2 < len ? kTable[n & 63] : '=');
+        }
+        return out;
+    }
+
+    std::string acceptKey(const StringPiece& clientKey){
+        std::string input = clientKey.as_string();
+        input.append(kGuid);
+        unsigned char digest[20];
+        sha1(input.data(), input.size(), digest);
+        return base64(digest, sizeof(digest));
+    }
+
+    using MaskFunc = size_t (*)(char*, const char*, size_t, const char*, size_t);
+
+    // 按8字节处理，掩码旋转到maskOffset对齐以后重复两次
+    static size_t maskScalar(char* dst, const char* src, size_t len, const char* mask, size_t maskOffset){
+        size_t i = 0;
+        unsigned char key[8];
+        for(int j = 0; j < 8; ++j){
+            key[j] = mask[(maskOffset + j) % 4];
+        }
+        uint64_t key64;
+        memcpy(&key64, key, sizeof(key64));
+        for(; i + 8 <= len; i += 8){
+            uint64_t word;
+            memcpy(&word, src + i, sizeof(word));
+            word ^= key64;
+            memcpy(dst + i, &word, sizeof(word));
+        }
+        for(; i < len; ++i){
+            dst[i] = src[i] ^ key[i % 4];
+        }
+        return (maskOffset + len) % 4;
+    }
+
+#ifdef MYMUDUO_X86_SIMD
+    static size_t maskSse2(char* dst, const char* src, size_t len, const char* mask, size_t maskOffset){
+        char key[4];
+        for(int j = 0; j < 4; ++j){
+            key[j] = mask[(maskOffset + j) % 4];
+        }
+        int32_t key32;
+        memcpy(&key32, key, sizeof(key32));
+        const __m128i key128 = _mm_set1_epi32(key32);
+        size_t i = 0;
+        // 每次处理的长度是4的倍数，掩码的相位不变
+        for(; i + 16 <= len; i += 16){
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_xor_si128(block, key128));
+        }
+        return maskScalar(dst + i, src + i, len - i, mask, (maskOffset + i) % 4);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t maskAvx2(char* dst, const char* src, size_t len, const char* mask, size_t maskOffset){
+        char key[4];
+        for(int j = 0; j < 4; ++j){
+            key[j] = mask[(maskOffset + j) % 4];
+        }
+        int32_t key32;
+        memcpy(&key32, key, sizeof(key32));
+        const __m256i key256 = _mm256_set1_epi32(key32);
+        size_t i = 0;
+        for(; i + 32 <= len; i += 32){
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_xor_si256(block, key256));
+        }
+        return maskSse2(dst + i, src + i, len - i, mask, (maskOffset + i) % 4);
+    }
+#endif
+
+    static const char* g_maskImplName = nullptr;
+
+    static MaskFunc selectMask(){
+#ifdef MYMUDUO_X86_SIMD
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")){
+            g_maskImplName = "avx2";
+            return maskAvx2;
+        }
+        g_maskImplName = "sse2";
+        return maskSse2;
+#else
+        g_maskImplName = "scalar";
+        return maskScalar;
+#endif
+    }
+
+    static MaskFunc maskDispatch(){
+        static const MaskFunc impl = selectMask();
+        return impl;
+    }
+
+    size_t applyMask(char* dst, const char* src, size_t len, const char mask[4], size_t maskOffset){
+        return maskDispatch()(dst, src, len, mask, maskOffset);
+    }
+
+    const char* maskImplementation(){
+        maskDispatch();
+        return g_maskImplName;
+    }
+
+    // 写入帧头，返回帧头长度，最长10字节
+    static size_t encodeHeader(char* header, Opcode opcode, size_t payloadLen, bool fin){
+        size_t headerLen = 2;
+        header[0] = static_cast<char>((fin ? 0x80 : 0x00) | opcode);
+        if(payloadLen < 126){
+            header[1] = static_cast<char>(payloadLen);
+        }else if(payloadLen <= 0xFFFF){
+            header[1] = 126;
+            uint16_t be16 = htobe16(static_cast<uint16_t>(payloadLen));
+            memcpy(header + 2, &be16, sizeof(be16));
+            headerLen += sizeof(be16);
+        }else{
+            header[1] = 127;
+            uint64_t be64 = htobe64(payloadLen);
+            memcpy(header + 2, &be64, sizeof(be64));
+            headerLen += sizeof(be64);
+        }
+        return headerLen;
+    }
+
+    void appendFrame(Buffer* output, Opcode opcode, const StringPiece& payload, bool fin){
+        char header[10];
+        output->append(header, encodeHeader(header, opcode, payload.size(), fin));
+        output->append(payload);
+    }
+
+    PayloadPtr makeFrame(Opcode opcode, const StringPiece& payload){
+        char header[10];
+        size_t headerLen = encodeHeader(header, opcode, payload.size(), true);
+        std::string frame;
+        frame.reserve(headerLen + payload.size());
+        frame.append(header, headerLen);
+        frame.append(payload.data(), payload.size());
+        return std::make_shared<const Payload>(std::move(frame));
+    }
+
+    void appendCloseFrame(Buffer* output, int code, const StringPiece& reason){
+        char payload[125];
+        uint16_t be16 = htobe16(static_cast<uint16_t>(code));
+        memcpy(payload, &be16, sizeof(be16));
+        // 控制帧的负载最多125字节
+        size_t reasonLen = std::min(reason.size(), sizeof(payload) - sizeof(be16));
+        memcpy(payload + sizeof(be16), reason.data(), reasonLen);
+        appendFrame(output, kClose, StringPiece(payload, sizeof(be16) + reasonLen));
+    }
+
+    bool isValidCloseCode(int code){
+        // 1000-1003、1007-1011是协议定义的，1012-1014是后来在IANA注册的，3000-4999留给库和应用
+        return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) || (code >= 3000 && code <= 4999);
+    }
+}
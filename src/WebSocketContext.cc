@@ -0,0 +1,158 @@
+#include "WebSocketContext.h"
+
+#include <string.h>
+#include <algorithm>
+
+WebSocketContext::WebSocketContext(size_t maxMessageSize)
+    : maxMessageSize_(maxMessageSize)
+    , state_(kExpectHeader)
+    , lastResult_(kIncomplete)
+    , frameOpcode_(WebSocket::kContinuation)
+    , frameFin_(false)
+    , frameRemaining_(0)
+    , maskOffset_(0)
+    , inMessage_(false)
+    , messageOpcode_(WebSocket::kText)
+    , message_(0)               // 大量空闲的连接时不占用内存，第一次使用时才分配
+    , controlOpcode_(WebSocket::kPing)
+    , control_(0)
+    , closeCode_(0)
+    , closeSent_(false)
+{
+    memset(mask_, 0, sizeof(mask_));
+}
+
+WebSocketContext::ParseResult WebSocketContext::fail(int code){
+    closeCode_ = code;
+    return kError;
+}
+
+WebSocketContext::ParseResult WebSocketContext::parse(Buffer* buff){
+    // 上一次交付的数据已经处理完了，分片消息中间交付控制帧时，已经收到的分片要保留
+    if(lastResult_ == kMessage){
+        message_.retrieveAll();
+    }else if(lastResult_ == kControl){
+        control_.retrieveAll();
+    }
+    lastResult_ = kIncomplete;
+    while(true){
+        if(state_ == kExpectHeader){
+            ParseResult result = parseHeader(buff);
+            if(result != kIncomplete || state_ == kExpectHeader){
+                return result;
+            }
+            if(frameRemaining_ == 0){
+                result = frameDone();
+                if(result != kIncomplete){
+                    return result;
+                }
+                continue;
+            }
+        }
+
+        // 去掉掩码，直接写到消息或者控制帧的缓冲区
+        size_t n = std::min(frameRemaining_, buff->readableBytes());
+        if(n == 0){
+            return kIncomplete;
+        }
+        Buffer* target = (frameOpcode_ & 0x08) ? &control_ : &message_;
+        target->ensureWritableBytes(n);
+        maskOffset_ = WebSocket::applyMask(target->beginWrite(), buff->peek(), n, mask_, maskOffset_);
+        target->hasWritten(n);
+        buff->retrieve(n);
+        frameRemaining_ -= n;
+        if(frameRemaining_ == 0){
+            ParseResult result = frameDone();
+            if(result != kIncomplete){
+                return result;
+            }
+        }
+    }
+}
+
+// 帧头：FIN RSV1-3 opcode(4) | MASK len(7) | 扩展长度(0/2/8) | 掩码(4)
+WebSocketContext::ParseResult WebSocketContext::parseHeader(Buffer* buff){
+    const size_t readable = buff->readableBytes();
+    if(readable < 2){
+        return kIncomplete;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buff->peek());
+    const bool fin = (p[0] & 0x80) != 0;
+    const int opcode = p[0] & 0x0F;
+    const bool masked = (p[1] & 0x80) != 0;
+    // 没有协商扩展，RSV必须为0；客户端发送的帧必须带掩码。前两个字节就能判断，不等帧头收全
+    if((p[0] & 0x70) != 0 || !masked){
+        return fail(WebSocket::kProtocolError);
+    }
+    size_t len = p[1] & 0x7F;
+    size_t headerLen = 2 + (len == 126 ? 2 : (len == 127 ? 8 : 0)) + 4;
+    if(readable < headerLen){
+        return kIncomplete;
+    }
+    if(len == 126){
+        uint16_t be16;
+        memcpy(&be16, p + 2, sizeof(be16));
+        len = be16toh(be16);
+    }else if(len == 127){
+        uint64_t be64;
+        memcpy(&be64, p + 2, sizeof(be64));
+        uint64_t len64 = be64toh(be64);
+        if(len64 >> 63){
+            return fail(WebSocket::kProtocolError);
+        }
+        if(len64 > maxMessageSize_){
+            return fail(WebSocket::kMessageTooBig);
+        }
+        len = static_cast<size_t>(len64);
+    }
+
+    if(opcode & 0x08){
+        // 控制帧不能分片，负载最多125字节
+        if(opcode != WebSocket::kClose && opcode != WebSocket::kPing && opcode != WebSocket::kPong){
+            return fail(WebSocket::kProtocolError);
+        }
+        if(!fin || len > 125){
+            return fail(WebSocket::kProtocolError);
+        }
+    }else if(opcode == WebSocket::kContinuation){
+        if(!inMessage_){
+            return fail(WebSocket::kProtocolError);
+        }
+    }else if(opcode == WebSocket::kText || opcode == WebSocket::kBinary){
+        if(inMessage_){
+            return fail(WebSocket::kProtocolError);
+        }
+        messageOpcode_ = static_cast<WebSocket::Opcode>(opcode);
+    }else{
+        return fail(WebSocket::kProtocolError);
+    }
+    if(!(opcode & 0x08) && message_.readableBytes() + len > maxMessageSize_){
+        return fail(WebSocket::kMessageTooBig);
+    }
+
+    memcpy(mask_, p + headerLen - 4, 4);
+    maskOffset_ = 0;
+    frameOpcode_ = static_cast<WebSocket::Opcode>(opcode);
+    frameFin_ = fin;
+    frameRemaining_ = len;
+    buff->retrieve(headerLen);
+    state_ = kExpectPayload;
+    return kIncomplete;
+}
+
+// 一个帧的负载都收到了
+WebSocketContext::ParseResult WebSocketContext::frameDone(){
+    state_ = kExpectHeader;
+    if(frameOpcode_ & 0x08){
+        controlOpcode_ = frameOpcode_;
+        lastResult_ = kControl;
+        return kControl;
+    }
+    if(!frameFin_){
+        inMessage_ = true;
+        return kIncomplete;
+    }
+    inMessage_ = false;
+    lastResult_ = kMessage;
+    return kMessage;
+}
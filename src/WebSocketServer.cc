@@ -0,0 +1,157 @@
+#include "WebSocketServer.h"
+#include "WebSocketContext.h"
+#include "Logger.h"
+
+#include <vector>
+#include <endian.h>
+
+WebSocketServer::WebSocketServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option)
+    , maxMessageSize_(16*1024*1024)
+{
+    server_.setUpgradeCallback(std::bind(&WebSocketServer::onUpgrade, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    server_.setConnectionCallback(std::bind(&WebSocketServer::onConnection, this, std::placeholders::_1));
+}
+
+// 检查握手请求，接受时回复101，返回处理WebSocket帧的回调
+MessageCallback WebSocketServer::onUpgrade(const TcpConnectionPtr& conn, const HttpRequest& request, HttpResponse* response){
+    if(!HttpRequest::hasToken(request.getHeader("Upgrade"), "websocket")){
+        // 其它协议的升级（比如h2c）不处理，状态码保持200，HttpServer按普通请求交给HttpCallback
+        return MessageCallback();
+    }
+    StringPiece key = request.getHeader("Sec-WebSocket-Key");
+    if(request.method() != HttpRequest::kGet || request.version() != HttpRequest::kHttp11
+        || !HttpRequest::hasToken(request.getHeader("Connection"), "upgrade") || key.size() != 24){
+        response->setStatusCode(HttpResponse::k400BadRequest);
+        return MessageCallback();
+    }
+    if(request.getHeader("Sec-WebSocket-Version") != "13"){
+        response->setStatusCode(HttpResponse::k426UpgradeRequired);
+        response->addHeader("Sec-WebSocket-Version", "13");
+        return MessageCallback();
+    }
+    if(handshakeCallback_ && !handshakeCallback_(conn, request)){
+        response->setStatusCode(HttpResponse::k403Forbidden);
+        return MessageCallback();
+    }
+
+    response->setStatusCode(HttpResponse::k101SwitchingProtocols);
+    response->addHeader("Upgrade", "websocket");
+    response->addHeader("Connection", "Upgrade");
+    response->addHeader("Sec-WebSocket-Accept", WebSocket::acceptKey(key));
+
+    conn->setContext(std::make_shared<WebSocketContext>(maxMessageSize_));
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        connections_.insert(conn);
+    }
+    if(openCallback_){
+        // HttpServer在这个回调返回以后才发送101响应，open回调中发送的消息要在101后面
+        conn->getLoop()->queueInLoop(std::bind(openCallback_, conn));
+    }
+    return std::bind(&WebSocketServer::onWebSocketMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+}
+
+void WebSocketServer::onConnection(const TcpConnectionPtr& conn){
+    if(conn->connected()){
+        return;
+    }
+    size_t erased = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        erased = connections_.erase(conn);
+    }
+    if(erased > 0 && disconnectCallback_){
+        disconnectCallback_(conn);
+    }
+}
+
+void WebSocketServer::onWebSocketMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp receiveTime){
+    std::shared_ptr<void> holder = conn->getContext();
+    WebSocketContext* context = static_cast<WebSocketContext*>(holder.get());
+    while(true){
+        WebSocketContext::ParseResult result = context->parse(buff);
+        if(result == WebSocketContext::kIncomplete){
+            return;
+        }
+        if(result == WebSocketContext::kError){
+            LOG_DEBUG("WebSocketServer::onWebSocketMessage [%s] protocol error, close code %d\n", conn->name().c_str(), context->closeCode());
+            closeInLoop(conn, context->closeCode(), std::string());
+            buff->retrieveAll();
+            return;
+        }
+        if(result == WebSocketContext::kMessage){
+            if(!context->closeSent() && messageCallback_){
+                messageCallback_(conn, context->message(), context->binary(), receiveTime);
+            }
+            continue;
+        }
+
+        // 控制帧
+        StringPiece payload = context->control();
+        if(context->controlOpcode() == WebSocket::kPing){
+            if(!context->closeSent()){
+                Buffer pong(payload.size() + 2);
+                WebSocket::appendFrame(&pong, WebSocket::kPong, payload);
+                conn->send(&pong);
+            }
+        }else if(context->controlOpcode() == WebSocket::kClose){
+            // 回复对方的关闭码，然后关闭连接，不合法的关闭码回复1002
+            int code = WebSocket::kNormalClosure;
+            if(payload.size() >= 2){
+                uint16_t be16;
+                memcpy(&be16, payload.data(), sizeof(be16));
+                code = be16toh(be16);
+                if(!WebSocket::isValidCloseCode(code)){
+                    code = WebSocket::kProtocolError;
+                }
+            }else if(payload.size() == 1){
+                code = WebSocket::kProtocolError;
+            }
+            closeInLoop(conn, code, std::string());
+            buff->retrieveAll();
+            return;
+        }
+        // pong不需要处理
+    }
+}
+
+void WebSocketServer::send(const TcpConnectionPtr& conn, const StringPiece& message, bool binary){
+    Buffer frame(message.size() + 10);
+    WebSocket::appendFrame(&frame, binary ? WebSocket::kBinary : WebSocket::kText, message);
+    // 不在loop线程时send(Buffer*)会把frame交换给loop线程，不拷贝
+    conn->send(&frame);
+}
+
+void WebSocketServer::close(const TcpConnectionPtr& conn, int code, const std::string& reason){
+    conn->getLoop()->runInLoop(std::bind(&WebSocketServer::closeInLoop, conn, code, reason));
+}
+
+void WebSocketServer::closeInLoop(const TcpConnectionPtr& conn, int code, const std::string& reason){
+    WebSocketContext* context = static_cast<WebSocketContext*>(conn->getContext().get());
+    if(context != nullptr && !context->closeSent()){
+        context->setCloseSent();
+        Buffer frame;
+        WebSocket::appendCloseFrame(&frame, code, reason);
+        conn->send(&frame);
+    }
+    // 发送完close帧以后关闭写端，对方收到以后会关闭连接
+    conn->shutdown();
+}
+
+void WebSocketServer::broadcast(const StringPiece& message, bool binary){
+    PayloadPtr frame = WebSocket::makeFrame(binary ? WebSocket::kBinary : WebSocket::kText, message);
+    std::vector<TcpConnectionPtr> targets;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        targets.assign(connections_.begin(), connections_.end());
+    }
+    for(const TcpConnectionPtr& conn : targets){
+        conn->send(frame);
+    }
+}
+
+size_t WebSocketServer::connectionCount(){
+    std::unique_lock<std::mutex> lock(mutex_);
+    return connections_.size();
+}
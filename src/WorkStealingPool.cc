@@ -0,0 +1,203 @@
+#include "WorkStealingPool.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+// 当前线程是哪个线程池的第几个工作线程，工作线程中提交的任务直接放到自己的队列
+static __thread WorkStealingPool* t_pool = nullptr;
+static __thread size_t t_workerIndex = 0;
+
+WorkStealingPool::WorkStealingPool(const std::string& nameArg)
+    : name_(nameArg)
+    , next_(0)
+    , running_(false)
+    , pending_(0)
+    , sleepers_(0)
+    , executedTasks_(0)
+    , stolenTasks_(0)
+{}
+
+WorkStealingPool::~WorkStealingPool(){
+    if(running_){
+        stop();
+    }
+}
+
+void WorkStealingPool::bindLoops(const std::vector<EventLoop*>& loops){
+    boundLoops_ = loops;
+}
+
+void WorkStealingPool::start(int numWorkers){
+    if(numWorkers <= 0){
+        LOG_FATAL("WorkStealingPool::start [%s] numWorkers must be positive \n", name_.c_str());
+    }
+    running_ = true;
+    for(int i = 0; i < numWorkers; ++i){
+        workers_.emplace_back(new Worker);
+    }
+    // loop和工作线程一一绑定，loop比工作线程多时轮流绑定
+    for(size_t i = 0; i < boundLoops_.size(); ++i){
+        loopToWorker_[boundLoops_[i]] = i % workers_.size();
+    }
+    for(int i = 0; i < numWorkers; ++i){
+        char buff[name_.size() + 32];
+        snprintf(buff, sizeof(buff), "%s%d", name_.c_str(), i);
+        workers_[i]->thread.reset(new Thread(std::bind(&WorkStealingPool::runInThread, this, static_cast<size_t>(i)), buff));
+        workers_[i]->thread->start();
+    }
+}
+
+void WorkStealingPool::stop(){
+    {
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        running_ = false;
+        idleCond_.notify_all();
+    }
+    for(std::unique_ptr<Worker>& worker : workers_){
+        worker->thread->join();
+    }
+    // 和stop同时提交的任务可能在工作线程退出以后才放入队列，不会再执行了，释放它们捕获的资源
+    size_t dropped = 0;
+    for(std::unique_ptr<Worker>& worker : workers_){
+        std::unique_lock<std::mutex> lock(worker->mutex);
+        dropped += worker->tasks.size();
+        worker->tasks.clear();
+    }
+    if(dropped > 0){
+        pending_ = 0;
+        LOG_ERROR("WorkStealingPool::stop [%s] drop %lu tasks submitted during stop \n", name_.c_str(), dropped);
+    }
+}
+
+size_t WorkStealingPool::queueSize(int worker) const{
+    std::unique_lock<std::mutex> lock(workers_[worker]->mutex);
+    return workers_[worker]->tasks.size();
+}
+
+bool WorkStealingPool::accepting() const{
+    if(running_ || t_pool == this){
+        return true;
+    }
+    LOG_ERROR("WorkStealingPool::submit [%s] thread pool is not running, drop the task \n", name_.c_str());
+    return false;
+}
+
+bool WorkStealingPool::submit(Task task){
+    if(!accepting()){
+        return false;
+    }
+    size_t index;
+    if(t_pool == this){
+        index = t_workerIndex;
+    }else{
+        index = next_++ % workers_.size();
+    }
+    push(index, std::move(task));
+    return true;
+}
+
+bool WorkStealingPool::submit(EventLoop* loop, Task work, Task done){
+    if(!accepting()){
+        return false;
+    }
+    size_t index;
+    auto it = loopToWorker_.find(loop);
+    if(it != loopToWorker_.end()){
+        index = it->second;
+    }else{
+        index = next_++ % workers_.size();
+    }
+
+    if(done){
+        push(index, [loop, work, done](){
+            work();
+            loop->queueInLoop(done);
+        });
+    }else{
+        push(index, std::move(work));
+    }
+    return true;
+}
+
+void WorkStealingPool::push(size_t index, Task task){
+    {
+        std::unique_lock<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    ++pending_;
+    // pending_和sleepers_都是顺序一致的原子操作，工作线程先增加sleepers_再检查pending_，这里先增加pending_再检查sleepers_，不会漏掉唤醒
+    if(sleepers_ > 0){
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        idleCond_.notify_one();
+    }
+}
+
+bool WorkStealingPool::popLocal(size_t index, Task* task){
+    Worker& worker = *workers_[index];
+    std::unique_lock<std::mutex> lock(worker.mutex);
+    if(worker.tasks.empty()){
+        return false;
+    }
+    // 自己的队列从头部取，先提交的请求先处理
+    *task = std::move(worker.tasks.front());
+    worker.tasks.pop_front();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t index, Task* task){
+    size_t n = workers_.size();
+    for(size_t i = 1; i < n; ++i){
+        Worker& victim = *workers_[(index + i) % n];
+        std::deque<Task> stolen;
+        {
+            std::unique_lock<std::mutex> lock(victim.mutex);
+            size_t count = (victim.tasks.size() + 1) / 2;
+            for(size_t k = 0; k < count; ++k){
+                stolen.push_front(std::move(victim.tasks.back()));
+                victim.tasks.pop_back();
+            }
+        }
+        if(stolen.empty()){
+            continue;
+        }
+
+        stolenTasks_ += stolen.size();
+        *task = std::move(stolen.front());
+        stolen.pop_front();
+        if(!stolen.empty()){
+            Worker& self = *workers_[index];
+            std::unique_lock<std::mutex> lock(self.mutex);
+            for(Task& t : stolen){
+                self.tasks.push_back(std::move(t));
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::runInThread(size_t index){
+    t_pool = this;
+    t_workerIndex = index;
+
+    Task task;
+    while(true){
+        if(popLocal(index, &task) || steal(index, &task)){
+            --pending_;
+            task();
+            task = Task();
+            ++executedTasks_;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        ++sleepers_;
+        while(pending_ == 0 && running_){
+            idleCond_.wait(lock);
+        }
+        --sleepers_;
+        if(pending_ == 0 && !running_){
+            break;
+        }
+    }
+    t_pool = nullptr;
+}
@@ -0,0 +1,259 @@
+// HttpServer的性能测试，和同样负载下的回显服务器对比
+// 客户端线程用epoll管理大量长连接，每条连接保持pipeline个请求在路上，收到一个响应就再发一个请求
+// 用法：./bench_http [连接数 1000] [subloop数 4] [客户端线程数 4] [秒数 5] [pipeline 1]
+// 超过几万个连接时需要足够大的ulimit -n，客户端会轮流绑定127.0.0.x作为源地址，避免本地端口不够用
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/HttpServer.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+static const char kRequest[] = "GET /hello HTTP/1.1\r\nHost: 127.0.0.1\r\nUser-Agent: bench_http\r\n\r\n";
+
+struct Options{
+    int connections;
+    int subloops;
+    int clientThreads;
+    int seconds;
+    int pipeline;
+};
+
+// 第一个响应的长度，之后按长度切分响应
+static size_t fetchResponseSize(uint16_t port){
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while(::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+        usleep(1000);
+    }
+    ::write(fd, kRequest, sizeof(kRequest) - 1);
+    std::string response;
+    char buf[4096];
+    while(response.find("\r\n\r\n") == std::string::npos){
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if(n <= 0){
+            break;
+        }
+        response.append(buf, n);
+    }
+    size_t headerEnd = response.find("\r\n\r\n") + 4;
+    size_t length = 0;
+    size_t pos = response.find("Content-Length: ");
+    if(pos != std::string::npos){
+        length = strtoul(response.c_str() + pos + 16, nullptr, 10);
+    }
+    ::close(fd);
+    return headerEnd + length;
+}
+
+struct ClientConn{
+    int fd;
+    size_t received;    // 当前响应已经收到的字节
+};
+
+// 一个客户端线程，返回测量期间完成的请求数
+static void runClient(uint16_t port, int connections, int firstConn, const Options& opt, size_t responseSize,
+                      std::atomic<int>* ready, std::atomic<bool>* measuring, std::atomic<bool>* stop, std::atomic<long>* completed){
+    int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+    std::vector<ClientConn> conns(connections);
+    std::string batch;
+    for(int i = 0; i < opt.pipeline; ++i){
+        batch.append(kRequest, sizeof(kRequest) - 1);
+    }
+
+    for(int i = 0; i < connections; ++i){
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if(fd < 0){
+            fprintf(stderr, "socket failed after %d connections: %s\n", i, strerror(errno));
+            conns.resize(i);
+            break;
+        }
+        int on = 1;
+        ::setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on, sizeof(on));
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(0x7f000002 + (firstConn + i) % 200);     // 127.0.0.2 ~ 127.0.0.201
+        ::bind(fd, (sockaddr*)&local, sizeof(local));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+            fprintf(stderr, "connect failed after %d connections: %s\n", i, strerror(errno));
+            ::close(fd);
+            conns.resize(i);
+            break;
+        }
+        ::fcntl(fd, F_SETFL, O_NONBLOCK);
+        conns[i].fd = fd;
+        conns[i].received = 0;
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    for(ClientConn& conn : conns){
+        ::write(conn.fd, batch.data(), batch.size());
+    }
+    ++*ready;
+
+    std::vector<epoll_event> events(1024);
+    std::string requests;
+    char buf[65536];
+    long done = 0;
+    while(!stop->load(std::memory_order_relaxed)){
+        int n = ::epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 100);
+        for(int i = 0; i < n; ++i){
+            ClientConn& conn = conns[events[i].data.u32];
+            ssize_t len = ::read(conn.fd, buf, sizeof(buf));
+            if(len <= 0){
+                continue;
+            }
+            conn.received += len;
+            size_t responses = conn.received / responseSize;
+            conn.received %= responseSize;
+            if(responses > 0){
+                if(measuring->load(std::memory_order_relaxed)){
+                    done += responses;
+                }
+                requests.clear();
+                for(size_t r = 0; r < responses; ++r){
+                    requests.append(kRequest, sizeof(kRequest) - 1);
+                }
+                ::write(conn.fd, requests.data(), requests.size());
+            }
+        }
+    }
+    *completed += done;
+    for(ClientConn& conn : conns){
+        ::close(conn.fd);
+    }
+    ::close(epfd);
+}
+
+// 在当前线程运行服务器的baseloop，客户端在其它线程，测试结束后退出loop
+template <typename Server>
+static double runBenchmark(const char* name, uint16_t port, const Options& opt){
+    EventLoop loop;
+    Server server(&loop, InetAddress(port), name);
+    server.setThreadNum(opt.subloops);
+    server.start();
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> stop(false);
+    std::atomic<long> completed(0);
+    double rate = 0.0;
+    std::thread driver([&]{
+        size_t responseSize = fetchResponseSize(port);
+        std::vector<std::thread> clients;
+        int perThread = opt.connections / opt.clientThreads;
+        for(int i = 0; i < opt.clientThreads; ++i){
+            clients.emplace_back(runClient, port, perThread, i * perThread, std::cref(opt), responseSize, &ready, &measuring, &stop, &completed);
+        }
+        // 等连接都建立好，再预热1秒
+        while(ready < opt.clientThreads){
+            usleep(10000);
+        }
+        sleep(1);
+        measuring = true;
+        Timestamp start = Timestamp::now();
+        sleep(opt.seconds);
+        measuring = false;
+        double seconds = timeDifference(Timestamp::now(), start);
+        stop = true;
+        for(std::thread& t : clients){
+            t.join();
+        }
+        rate = completed / seconds;
+        loop.quit();
+    });
+    loop.loop();
+    driver.join();
+    return rate;
+}
+
+// 回显服务器，收到什么发回什么，作为对比的基准
+class EchoServer{
+    public:
+        EchoServer(EventLoop* loop, const InetAddress& addr, const std::string& name)
+            : server_(loop, addr, name)
+        {
+            server_.setConnectionCallback([](const TcpConnectionPtr&){});
+            server_.setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buff, Timestamp){
+                conn->send(buff);
+            });
+        }
+        void setThreadNum(int n){ server_.setThreadNum(n); }
+        void start(){ server_.start(); }
+    private:
+        TcpServer server_;
+};
+
+class HelloServer{
+    public:
+        HelloServer(EventLoop* loop, const InetAddress& addr, const std::string& name)
+            : server_(loop, addr, name)
+        {
+            server_.setHttpCallback([](const HttpRequest& req, HttpResponse* resp){
+                if(req.path() == "/hello"){
+                    resp->setContentType("text/plain");
+                    resp->setBody("hello, world!\n");
+                }else{
+                    resp->setStatusCode(HttpResponse::k404NotFound);
+                }
+            });
+        }
+        void setThreadNum(int n){ server_.setThreadNum(n); }
+        void start(){ server_.start(); }
+    private:
+        HttpServer server_;
+};
+
+int main(int argc, char* argv[]){
+    Options opt;
+    opt.connections = argc > 1 ? atoi(argv[1]) : 1000;
+    opt.subloops = argc > 2 ? atoi(argv[2]) : 4;
+    opt.clientThreads = argc > 3 ? atoi(argv[3]) : 4;
+    opt.seconds = argc > 4 ? atoi(argv[4]) : 5;
+    opt.pipeline = argc > 5 ? atoi(argv[5]) : 1;
+
+    // 服务器和客户端在同一个进程中，每个连接需要两个fd
+    rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    if(limit.rlim_cur < static_cast<rlim_t>(opt.connections) * 2 + 100){
+        int fit = static_cast<int>((limit.rlim_cur - 100) / 2);
+        fprintf(stderr, "RLIMIT_NOFILE %lu is too small for %d connections, use %d\n", (unsigned long)limit.rlim_cur, opt.connections, fit);
+        opt.connections = fit;
+    }
+
+    // 日志太多会影响测试结果
+    freopen("/dev/null", "w", stdout);
+    double echo = runBenchmark<EchoServer>("echo", 9400, opt);
+    double http = runBenchmark<HelloServer>("http", 9401, opt);
+
+    fprintf(stderr, "connections %d, subloops %d, client threads %d, pipeline %d\n", opt.connections, opt.subloops, opt.clientThreads, opt.pipeline);
+    fprintf(stderr, "echo baseline: %.0f requests/s\n", echo);
+    fprintf(stderr, "HttpServer:    %.0f requests/s (%.1f%% of echo)\n", http, echo > 0 ? http * 100 / echo : 0.0);
+    return 0;
+}
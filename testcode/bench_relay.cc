@@ -0,0 +1,286 @@
+// TCP转发代理的性能测试：客户端 -> 代理 -> 回显服务器 -> 代理 -> 客户端
+// 代理在一个loop线程中运行，每条客户端连接对应同一个loop中的一条上游连接，比较splice转发和拷贝转发时代理线程每GB消耗的CPU时间
+// 用法：./bench_relay [splice|copy] [连接数 4] [每条连接的MB数 1024] [每次write的KB数 256] [管道KB数 1024]
+// 管道越大，每次splice移动的数据越多，系统调用和暂停、恢复读的次数越少
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Logger.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <memory>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+
+static const uint16_t kBackendPort = 19090;
+static const uint16_t kProxyPort = 19091;
+
+static int listenOn(uint16_t port){
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(::bind(fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 128) < 0){
+        fprintf(stderr, "listen on %u failed: %s\n", port, strerror(errno));
+        exit(1);
+    }
+    return fd;
+}
+
+static int connectTo(uint16_t port){
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while(::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+        usleep(1000);
+    }
+    return fd;
+}
+
+// 回显服务器，每条连接一个线程，用阻塞IO，不占用代理的loop线程
+static void runBackend(int listenFd, int connections){
+    std::vector<std::thread> threads;
+    for(int i = 0; i < connections; ++i){
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        threads.emplace_back([fd]{
+            std::vector<char> buf(256 * 1024);
+            ssize_t n;
+            while((n = ::read(fd, buf.data(), buf.size())) > 0){
+                for(ssize_t sent = 0; sent < n; ){
+                    ssize_t m = ::write(fd, buf.data() + sent, n - sent);
+                    if(m <= 0){
+                        ::close(fd);
+                        return;
+                    }
+                    sent += m;
+                }
+            }
+            ::close(fd);
+        });
+    }
+    for(std::thread& t : threads){
+        t.join();
+    }
+}
+
+// 每条客户端连接对应一个TcpClient，都在同一个loop中
+class RelayProxy{
+    public:
+        RelayProxy(EventLoop* loop, bool useSplice, size_t pipeSize)
+            : loop_(loop)
+            , server_(loop, InetAddress(kProxyPort), "RelayProxy")
+            , useSplice_(useSplice)
+            , pipeSize_(pipeSize)
+        {
+            server_.setConnectionCallback(std::bind(&RelayProxy::onClientConnection, this, std::placeholders::_1));
+            server_.setMessageCallback(std::bind(&RelayProxy::onClientMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            // 拷贝转发时客户端发送拥塞会暂停上游的读
+            server_.setWaterMarks(256 * 1024, 1024 * 1024);
+        }
+
+        void start(){ server_.start(); }
+
+    private:
+        void onClientConnection(const TcpConnectionPtr& conn){
+            if(conn->connected()){
+                // 上游连接建立之前不读客户端的数据
+                conn->stopRead();
+                std::shared_ptr<TcpClient> client(new TcpClient(loop_, InetAddress(kBackendPort), "upstream-" + conn->name()));
+                std::weak_ptr<TcpConnection> weakConn(conn);
+                client->setConnectionCallback(std::bind(&RelayProxy::onUpstreamConnection, this, weakConn, conn->name(), std::placeholders::_1));
+                client->setMessageCallback(std::bind(&RelayProxy::onUpstreamMessage, this, weakConn, std::placeholders::_1, std::placeholders::_2));
+                tunnels_[conn->name()] = client;
+                client->connect();
+            }else{
+                // 等上游的数据发送完再关闭，上游连接断开后再删除TcpClient
+                auto it = tunnels_.find(conn->name());
+                if(it != tunnels_.end()){
+                    it->second->disconnect();
+                }
+            }
+        }
+
+        void onUpstreamConnection(const std::weak_ptr<TcpConnection>& weakConn, const std::string& name, const TcpConnectionPtr& upstream){
+            TcpConnectionPtr conn = weakConn.lock();
+            if(!upstream->connected()){
+                if(conn){
+                    conn->shutdown();
+                }
+                auto it = tunnels_.find(name);
+                if(it != tunnels_.end()){
+                    // 不能在TcpClient自己的回调中析构它
+                    std::shared_ptr<TcpClient> client = it->second;
+                    loop_->queueInLoop([client]{});
+                    tunnels_.erase(it);
+                }
+                return;
+            }
+            if(!conn){
+                upstream->shutdown();
+                return;
+            }
+            if(useSplice_ && conn->startSplice(upstream, pipeSize_) && upstream->startSplice(conn, pipeSize_)){
+                conn->startRead();
+                return;
+            }
+            // 拷贝转发，用水位线做双向的流量控制
+            conn->linkPeer(upstream);
+            conn->startRead();
+        }
+
+        void onClientMessage(const TcpConnectionPtr& conn, Buffer* buff, Timestamp){
+            auto it = tunnels_.find(conn->name());
+            TcpConnectionPtr upstream = it != tunnels_.end() ? it->second->connection() : TcpConnectionPtr();
+            if(upstream){
+                upstream->send(buff);
+            }
+        }
+
+        // splice转发时客户端关闭以后，上游的数据也会回到这里
+        void onUpstreamMessage(const std::weak_ptr<TcpConnection>& weakConn, const TcpConnectionPtr& upstream, Buffer* buff){
+            TcpConnectionPtr conn = weakConn.lock();
+            if(conn && conn->connected()){
+                conn->send(buff);
+            }else{
+                // 客户端已经关闭，上游的数据没有人接收了
+                buff->retrieveAll();
+                upstream->forceClose();
+            }
+        }
+
+        EventLoop* loop_;
+        TcpServer server_;
+        const bool useSplice_;
+        const size_t pipeSize_;
+        std::map<std::string, std::shared_ptr<TcpClient>> tunnels_;
+};
+
+static double threadCpuSeconds(){
+    rusage usage;
+    ::getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static double nowSeconds(){
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 在loop线程中取线程的CPU时间
+static double loopCpuSeconds(EventLoop* loop){
+    std::atomic<double> result(-1.0);
+    loop->runInLoop([&result]{ result = threadCpuSeconds(); });
+    while(result < 0.0){
+        usleep(1000);
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]){
+    bool useSplice = argc <= 1 || strcmp(argv[1], "copy") != 0;
+    int connections = argc > 2 ? atoi(argv[2]) : 4;
+    size_t bytesPerConn = (argc > 3 ? atol(argv[3]) : 1024) * 1024 * 1024;
+    size_t chunkSize = (argc > 4 ? atol(argv[4]) : 256) * 1024;
+    size_t pipeSize = (argc > 5 ? atol(argv[5]) : 1024) * 1024;
+
+    // 日志太多会影响测试结果
+    freopen("/dev/null", "w", stdout);
+    int backendFd = listenOn(kBackendPort);
+    std::thread backend(runBackend, backendFd, connections);
+
+    EventLoop* proxyLoop = nullptr;
+    std::atomic<bool> proxyReady(false);
+    std::thread proxy([&]{
+        EventLoop loop;
+        RelayProxy relay(&loop, useSplice, pipeSize);
+        relay.start();
+        proxyLoop = &loop;
+        proxyReady = true;
+        loop.loop();
+    });
+    while(!proxyReady){
+        usleep(1000);
+    }
+
+    double cpuStart = loopCpuSeconds(proxyLoop);
+    double start = nowSeconds();
+    std::atomic<size_t> corrupted(0);
+    std::vector<std::thread> clients;
+    for(int i = 0; i < connections; ++i){
+        clients.emplace_back([&, i]{
+            int fd = connectTo(kProxyPort);
+            // 一个线程发送，当前线程接收并校验回显的数据
+            std::thread writer([&, fd]{
+                std::vector<char> data(chunkSize);
+                for(size_t k = 0; k < chunkSize; ++k){
+                    data[k] = static_cast<char>(k * 131 + i);
+                }
+                for(size_t sent = 0; sent < bytesPerConn; ){
+                    size_t len = std::min(chunkSize - sent % chunkSize, bytesPerConn - sent);
+                    ssize_t n = ::write(fd, data.data() + sent % chunkSize, len);
+                    if(n <= 0){
+                        break;
+                    }
+                    sent += n;
+                }
+            });
+            std::vector<char> buf(chunkSize);
+            size_t received = 0;
+            while(received < bytesPerConn){
+                ssize_t n = ::read(fd, buf.data(), buf.size());
+                if(n <= 0){
+                    break;
+                }
+                for(ssize_t k = 0; k < n; k += 4093){
+                    if(buf[k] != static_cast<char>(((received + k) % chunkSize) * 131 + i)){
+                        ++corrupted;
+                        break;
+                    }
+                }
+                received += n;
+            }
+            writer.join();
+            if(received != bytesPerConn){
+                fprintf(stderr, "connection %d received %lu of %lu bytes\n", i, received, bytesPerConn);
+            }
+            ::close(fd);
+        });
+    }
+    for(std::thread& t : clients){
+        t.join();
+    }
+    double seconds = nowSeconds() - start;
+    double cpu = loopCpuSeconds(proxyLoop) - cpuStart;
+
+    // 代理两个方向各转发一遍
+    double gigabytes = 2.0 * connections * bytesPerConn / (1024.0 * 1024 * 1024);
+    fprintf(stderr, "%s: %d connections, %.1f GB relayed in %.2f s, %.2f GB/s, proxy cpu %.2f s, %.3f cpu-s/GB%s\n",
+            useSplice ? "splice" : "copy", connections, gigabytes, seconds, gigabytes / seconds, cpu, cpu / gigabytes,
+            corrupted > 0 ? ", DATA CORRUPTED" : "");
+
+    proxyLoop->quit();
+    proxy.join();
+    backend.join();
+    ::close(backendFd);
+    return corrupted > 0 ? 1 : 0;
+}
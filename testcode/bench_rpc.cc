@@ -0,0 +1,170 @@
+// RpcServer/RpcClient的性能测试：一条连接上保持多个调用在路上，和每个调用新建一条连接对比
+// 用法：./bench_rpc [同时在路上的调用数 100] [subloop数 2] [秒数 3] [请求字节数 64]
+#include <mymuduo/RpcServer.h>
+#include <mymuduo/RpcClient.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+static const uint16_t kPort = 9460;
+
+struct Result{
+    double callsPerSecond;
+    double p50Us;
+    double p99Us;
+};
+
+static Result summarize(std::vector<double>& latencies, double seconds){
+    Result result = { latencies.size() / seconds, 0, 0 };
+    if(!latencies.empty()){
+        std::sort(latencies.begin(), latencies.end());
+        result.p50Us = latencies[latencies.size() / 2];
+        result.p99Us = latencies[latencies.size() * 99 / 100];
+    }
+    return result;
+}
+
+// 所有调用共用一个RpcClient，每收到一个响应就再发一个调用
+class MultiplexedBench{
+    public:
+        MultiplexedBench(EventLoop* loop, int inflight, const std::string& request, double seconds)
+            : loop_(loop)
+            , client_(loop, InetAddress(kPort), "bench")
+            , inflight_(inflight)
+            , request_(request)
+            , seconds_(seconds)
+        {}
+
+        Result run(){
+            for(int i = 0; i < inflight_; ++i){
+                issue();
+            }
+            client_.connect();
+            Timestamp start = Timestamp::now();
+            loop_->runAfter(seconds_, std::bind(&EventLoop::quit, loop_));
+            loop_->loop();
+            return summarize(latencies_, timeDifference(Timestamp::now(), start));
+        }
+
+    private:
+        void issue(){
+            Timestamp sent = Timestamp::now();
+            client_.call("echo", request_, 5, [this, sent](int status, const StringPiece& response){
+                if(status != Rpc::kOk || response.size() != request_.size()){
+                    fprintf(stderr, "call failed: %s\n", Rpc::statusString(status));
+                    loop_->quit();
+                    return;
+                }
+                latencies_.push_back(timeDifference(Timestamp::now(), sent) * 1e6);
+                issue();
+            });
+        }
+
+        EventLoop* loop_;
+        RpcClient client_;
+        const int inflight_;
+        const std::string request_;
+        const double seconds_;
+        std::vector<double> latencies_;
+};
+
+// 每个调用新建一条连接：connect、发送请求、读响应、关闭，用阻塞IO，每个线程一个调用在路上
+// 关闭时发RST，不留TIME_WAIT，否则几秒钟就会用完本地端口
+static void connectionPerCall(const std::string& frame, size_t responseSize, double seconds, std::vector<double>* latencies){
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    std::vector<char> response(responseSize);
+    Timestamp end = addTime(Timestamp::now(), seconds);
+    while(Timestamp::now() < end){
+        Timestamp sent = Timestamp::now();
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        linger lg = { 1, 0 };
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        if(::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+            ::close(fd);
+            continue;
+        }
+        ::write(fd, frame.data(), frame.size());
+        size_t got = 0;
+        while(got < responseSize){
+            ssize_t n = ::read(fd, response.data() + got, responseSize - got);
+            if(n <= 0){
+                break;
+            }
+            got += n;
+        }
+        ::close(fd);
+        if(got == responseSize){
+            latencies->push_back(timeDifference(Timestamp::now(), sent) * 1e6);
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    int inflight = argc > 1 ? atoi(argv[1]) : 100;
+    int subloops = argc > 2 ? atoi(argv[2]) : 2;
+    double seconds = argc > 3 ? atof(argv[3]) : 3;
+    size_t requestSize = argc > 4 ? atoi(argv[4]) : 64;
+
+    // 日志太多会影响测试结果
+    freopen("/dev/null", "w", stdout);
+
+    EventLoopThread serverThread;
+    EventLoop* serverLoop = serverThread.startLoop();
+    RpcServer server(serverLoop, InetAddress(kPort), "bench_rpc");
+    server.registerMethod("echo", [](const StringPiece& request, Buffer* response){
+        response->append(request);
+        return static_cast<int>(Rpc::kOk);
+    });
+    server.setThreadNum(subloops);
+    serverLoop->runInLoop(std::bind(&RpcServer::start, &server));
+    usleep(100 * 1000);
+
+    std::string request(requestSize, 'x');
+    Result multiplexed;
+    {
+        EventLoop loop;
+        MultiplexedBench bench(&loop, inflight, request, seconds);
+        multiplexed = bench.run();
+    }
+
+    Buffer frame;
+    Rpc::appendRequest(&frame, 1, "echo", 5000, request);
+    std::string frameData(frame.peek(), frame.readableBytes());
+    size_t responseSize = Rpc::kResponseHeaderLen + requestSize;
+    int threads = std::min(inflight, 16);
+    std::vector<std::vector<double>> latencies(threads);
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i){
+        workers.emplace_back(connectionPerCall, std::cref(frameData), responseSize, seconds, &latencies[i]);
+    }
+    for(std::thread& t : workers){
+        t.join();
+    }
+    std::vector<double> all;
+    for(std::vector<double>& l : latencies){
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    Result perCall = summarize(all, seconds);
+
+    fprintf(stderr, "in flight %d (connection per call: %d threads), subloops %d, request %zu bytes\n", inflight, threads, subloops, requestSize);
+    fprintf(stderr, "multiplexed, 1 connection: %8.0f calls/s  p50 %6.0f us  p99 %6.0f us\n", multiplexed.callsPerSecond, multiplexed.p50Us, multiplexed.p99Us);
+    fprintf(stderr, "connection per call:       %8.0f calls/s  p50 %6.0f us  p99 %6.0f us\n", perCall.callsPerSecond, perCall.p50Us, perCall.p99Us);
+    // server还在serverThread的loop中使用，直接退出
+    _exit(0);
+}
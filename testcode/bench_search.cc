@@ -0,0 +1,143 @@
+// Buffer查找分隔符的性能测试
+// 1. 一次查找：在一大块没有分隔符的数据里查找，对比std::search、memmem和SimdSearch的各个实现
+// 2. 增量查找：一条很长的消息分成很多段到达，每到一段查找一次，对比每次从头查找和Buffer::findDelimiter
+#include <mymuduo/Buffer.h>
+#include <mymuduo/SimdSearch.h>
+#include <mymuduo/Timestamp.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char kPattern[] = "\r\n\r\n";
+static const size_t kPatternLen = 4;
+
+// 类似HTTP头部的文本，有很多\r\n，但是没有\r\n\r\n
+static std::string makeText(size_t size){
+    static const char kLine[] = "X-Header-Name: some header value 0123456789\r\n";
+    std::string text;
+    text.reserve(size + sizeof(kLine));
+    while(text.size() < size){
+        text.append(kLine);
+    }
+    text.resize(size);
+    return text;
+}
+
+static volatile size_t g_sink = 0;
+
+template <typename Search>
+static void benchOnce(const char* name, const std::string& text, int rounds, Search search){
+    Timestamp start = Timestamp::now();
+    for(int i = 0; i < rounds; ++i){
+        const char* found = search(text.data(), text.data() + text.size());
+        g_sink += found == nullptr ? 0 : 1;
+    }
+    double seconds = timeDifference(Timestamp::now(), start);
+    double gb = static_cast<double>(text.size()) * rounds / (1024.0 * 1024 * 1024);
+    printf("  %-12s %8.2f GB/s\n", name, gb / seconds);
+}
+
+static const char* stdSearch(const char* begin, const char* end){
+    const char* found = std::search(begin, end, kPattern, kPattern + kPatternLen);
+    return found == end ? nullptr : found;
+}
+
+static const char* memmemSearch(const char* begin, const char* end){
+    return static_cast<const char*>(memmem(begin, end - begin, kPattern, kPatternLen));
+}
+
+// 检查各个实现的结果和std::search一致，包括分隔符跨越向量块边界的情况
+static bool checkImplementations(){
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    const char* patterns[] = {"\r\n", "\r\n\r\n", "\n", "boundary--", "ab"};
+    srand(1);
+    for(int round = 0; round < 2000; ++round){
+        std::string text(rand() % 300, 'a');
+        for(size_t i = 0; i < text.size(); ++i){
+            text[i] = "ab\r\n-y"[rand() % 6];
+        }
+        for(const char* pattern : patterns){
+            size_t len = strlen(pattern);
+            const char* begin = text.data();
+            const char* end = begin + text.size();
+            const char* expect = std::search(begin, end, pattern, pattern + len);
+            if(expect == end){
+                expect = nullptr;
+            }
+            for(const char* name : names){
+                SimdSearch::SearchFunc func = SimdSearch::findImpl(name);
+                if(func != nullptr && func(begin, end, pattern, len) != expect){
+                    printf("%s mismatch, pattern length %zu, text length %zu\n", name, len, text.size());
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// 一条消息按segment字节一段到达，每到一段查找一次分隔符
+static void benchIncremental(size_t messageSize, size_t segment){
+    std::string message = makeText(messageSize);
+    message.append(kPattern);
+
+    // 每次从头查找
+    Buffer rescan;
+    Timestamp start = Timestamp::now();
+    size_t found = 0;
+    for(size_t off = 0; off < message.size(); off += segment){
+        rescan.append(message.data() + off, std::min(segment, message.size() - off));
+        if(memmem(rescan.peek(), rescan.readableBytes(), kPattern, kPatternLen) != nullptr){
+            ++found;
+        }
+    }
+    double rescanSeconds = timeDifference(Timestamp::now(), start);
+
+    // 只查找新到达的数据
+    Buffer resume;
+    start = Timestamp::now();
+    for(size_t off = 0; off < message.size(); off += segment){
+        resume.append(message.data() + off, std::min(segment, message.size() - off));
+        if(resume.findDelimiter(kPattern, kPatternLen) != nullptr){
+            ++found;
+        }
+    }
+    double resumeSeconds = timeDifference(Timestamp::now(), start);
+
+    g_sink += found;
+    printf("  message %zuKB in %zu-byte segments: memmem rescan %.2f ms, findDelimiter %.2f ms, found %zu\n",
+           messageSize / 1024, segment, rescanSeconds * 1000, resumeSeconds * 1000, found);
+}
+
+int main(){
+    if(!checkImplementations()){
+        return 1;
+    }
+    printf("SimdSearch implementation: %s\n", SimdSearch::implementation());
+
+    const std::string text = makeText(16 * 1024 * 1024);
+    const int rounds = 20;
+    printf("search \\r\\n\\r\\n in %zuMB:\n", text.size() / (1024 * 1024));
+    benchOnce("std::search", text, rounds, stdSearch);
+    benchOnce("memmem", text, rounds, memmemSearch);
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    for(const char* name : names){
+        SimdSearch::SearchFunc func = SimdSearch::findImpl(name);
+        if(func == nullptr){
+            printf("  %-12s not supported\n", name);
+            continue;
+        }
+        benchOnce(name, text, rounds, [func](const char* begin, const char* end){
+            return func(begin, end, kPattern, kPatternLen);
+        });
+    }
+
+    printf("incremental search:\n");
+    benchIncremental(64 * 1024, 1460);
+    benchIncremental(1024 * 1024, 1460);
+    return 0;
+}
@@ -0,0 +1,201 @@
+// UdpServer的性能测试
+// echo：客户端每个线程保持window个数据报在路上，收到一个回复就再发一个，统计往返的数据报个数
+// sink：客户端只发送，服务器只计数，相当于遥测数据的收集端
+// 用法：./bench_udp [-m echo|sink] [-t subloop数 2] [-T 客户端线程数 2] [-d 秒数 5] [-s 数据报字节数 64] [-w window 256]
+//                  [-B 服务器每次recvmmsg的个数 64] [-n 不使用SO_REUSEPORT]
+#include <mymuduo/UdpServer.h>
+#include <mymuduo/EventLoop.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+static const uint16_t kPort = 19500;
+static const int kClientBatch = 64;
+
+struct Options{
+    bool echo;
+    int subloops;
+    int clientThreads;
+    int seconds;
+    size_t datagramSize;
+    int window;
+    int serverBatch;
+    bool reusePort;
+};
+
+static double nowSeconds(){
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 每个客户端线程一个connect过的socket，源端口不同，SO_REUSEPORT会把它们分到不同的服务器socket
+static void runClient(const Options& opt, std::atomic<bool>* measuring, std::atomic<bool>* stop, std::atomic<uint64_t>* completed){
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ::connect(fd, (sockaddr*)&addr, sizeof(addr));
+    timeval timeout = { 0, 100 * 1000 };
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    int bufferSize = 4 * 1024 * 1024;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    std::vector<char> payload(opt.datagramSize, 'u');
+    std::vector<char> recvArena(kClientBatch * 2048);
+    mmsghdr sendMsgs[kClientBatch];
+    iovec sendIovecs[kClientBatch];
+    mmsghdr recvMsgs[kClientBatch];
+    iovec recvIovecs[kClientBatch];
+    for(int i = 0; i < kClientBatch; ++i){
+        sendIovecs[i].iov_base = payload.data();
+        sendIovecs[i].iov_len = payload.size();
+        memset(&sendMsgs[i], 0, sizeof(mmsghdr));
+        sendMsgs[i].msg_hdr.msg_iov = &sendIovecs[i];
+        sendMsgs[i].msg_hdr.msg_iovlen = 1;
+        recvIovecs[i].iov_base = recvArena.data() + i * 2048;
+        recvIovecs[i].iov_len = 2048;
+        memset(&recvMsgs[i], 0, sizeof(mmsghdr));
+        recvMsgs[i].msg_hdr.msg_iov = &recvIovecs[i];
+        recvMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    auto sendBatch = [&](int count){
+        while(count > 0){
+            int n = ::sendmmsg(fd, sendMsgs, std::min(count, kClientBatch), 0);
+            if(n <= 0){
+                break;
+            }
+            count -= n;
+        }
+    };
+
+    uint64_t local = 0;
+    if(!opt.echo){
+        while(!stop->load(std::memory_order_relaxed)){
+            int n = ::sendmmsg(fd, sendMsgs, kClientBatch, 0);
+            if(n > 0 && measuring->load(std::memory_order_relaxed)){
+                local += n;
+            }
+        }
+    }else{
+        sendBatch(opt.window);
+        while(!stop->load(std::memory_order_relaxed)){
+            int n = ::recvmmsg(fd, recvMsgs, kClientBatch, 0, nullptr);
+            if(n < 0){
+                // 超时，说明window中的数据报都丢了，重新发送一个window
+                sendBatch(opt.window);
+                continue;
+            }
+            if(measuring->load(std::memory_order_relaxed)){
+                local += n;
+            }
+            sendBatch(n);
+        }
+    }
+    *completed += local;
+    ::close(fd);
+}
+
+int main(int argc, char* argv[]){
+    Options opt = { true, 2, 2, 5, 64, 256, 64, true };
+    int c;
+    while((c = getopt(argc, argv, "m:t:T:d:s:w:B:n")) != -1){
+        switch(c){
+            case 'm': opt.echo = strcmp(optarg, "sink") != 0; break;
+            case 't': opt.subloops = atoi(optarg); break;
+            case 'T': opt.clientThreads = atoi(optarg); break;
+            case 'd': opt.seconds = atoi(optarg); break;
+            case 's': opt.datagramSize = std::min<size_t>(std::max(atoi(optarg), 1), 2048); break;
+            case 'w': opt.window = atoi(optarg); break;
+            case 'B': opt.serverBatch = atoi(optarg); break;
+            case 'n': opt.reusePort = false; break;
+            default:
+                fprintf(stderr, "usage: %s [-m echo|sink] [-t subloops] [-T threads] [-d seconds] [-s bytes] [-w window] [-B batch] [-n]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // 日志太多会影响测试结果
+    freopen("/dev/null", "w", stdout);
+    EventLoop* baseLoop = nullptr;
+    UdpServer* server = nullptr;
+    std::atomic<bool> ready(false);
+    std::thread serverThread([&]{
+        EventLoop loop;
+        UdpServer udpServer(&loop, InetAddress(kPort), "bench_udp", opt.reusePort ? UdpServer::kReusePort : UdpServer::kNoReusePort);
+        udpServer.setThreadNum(opt.subloops);
+        udpServer.setBatchSize(opt.serverBatch);
+        udpServer.setReceiveBufferSize(4 * 1024 * 1024);
+        if(opt.echo){
+            udpServer.setMessageCallback([](const UdpSocketPtr& socket, const UdpDatagram& datagram, Timestamp){
+                socket->send(datagram.peer, datagram.data, datagram.length);
+            });
+        }
+        udpServer.start();
+        baseLoop = &loop;
+        server = &udpServer;
+        ready = true;
+        loop.loop();
+    });
+    while(!ready){
+        usleep(1000);
+    }
+
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> completed(0);
+    std::vector<std::thread> clients;
+    for(int i = 0; i < opt.clientThreads; ++i){
+        clients.emplace_back(runClient, std::cref(opt), &measuring, &stop, &completed);
+    }
+    sleep(1);   // 预热
+    uint64_t receivedBefore = server->receivedDatagrams();
+    uint64_t callsBefore = 0;
+    for(const UdpSocketPtr& socket : server->sockets()){
+        callsBefore += socket->receiveCalls();
+    }
+    measuring = true;
+    double start = nowSeconds();
+    sleep(opt.seconds);
+    measuring = false;
+    double seconds = nowSeconds() - start;
+    uint64_t received = server->receivedDatagrams() - receivedBefore;
+    uint64_t calls = 0;
+    for(const UdpSocketPtr& socket : server->sockets()){
+        calls += socket->receiveCalls();
+    }
+    calls -= callsBefore;
+    stop = true;
+    for(std::thread& t : clients){
+        t.join();
+    }
+
+    fprintf(stderr, "%s: %lu socket(s), %d client threads, %lu-byte datagrams, server batch %d\n",
+            opt.echo ? "echo" : "sink", server->sockets().size(), opt.clientThreads, opt.datagramSize, opt.serverBatch);
+    fprintf(stderr, "server received %.0f datagrams/s, %.1f datagrams per recvmmsg, dropped %lu replies\n",
+            received / seconds, calls > 0 ? static_cast<double>(received) / calls : 0.0, server->droppedDatagrams());
+    if(opt.echo){
+        fprintf(stderr, "client completed %.0f round trips/s\n", completed / seconds);
+    }else{
+        fprintf(stderr, "client sent %.0f datagrams/s\n", completed / seconds);
+    }
+
+    baseLoop->quit();
+    serverThread.join();
+    return 0;
+}
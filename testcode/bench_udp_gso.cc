@@ -0,0 +1,181 @@
+// UDP GSO/GRO的性能测试：一个loop线程用sendSegmented持续发送大块数据，另一个loop线程接收并校验数据报的边界
+// 发送方的每个数据报填满同一个字节（数据报在大块数据中的序号），接收方检查合并后的缓冲区按segmentSize切开以后每一段仍然是同一个字节
+// 用法：./bench_udp_gso [-g 开启GSO] [-r 开启GRO] [-d 秒数 5] [-s 数据报字节数 1400] [-c 每次sendSegmented的KB数 64]
+#include <mymuduo/UdpSocket.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Socket.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+
+static const uint16_t kReceiverPort = 19600;
+static const uint16_t kSenderPort = 19601;
+static const size_t kMaxQueued = 4 * 1024 * 1024;
+
+struct Options{
+    bool gso;
+    bool gro;
+    int seconds;
+    size_t segmentSize;
+    size_t chunkSize;
+};
+
+static double nowSeconds(){
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double threadCpuSeconds(){
+    rusage usage;
+    ::getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// 在loop线程中取线程的CPU时间
+static double loopCpuSeconds(EventLoop* loop){
+    std::atomic<double> result(-1.0);
+    loop->runInLoop([&result]{ result = threadCpuSeconds(); });
+    while(result < 0.0){
+        usleep(1000);
+    }
+    return result;
+}
+
+// 发送队列积压不多时再放一块数据，然后让出loop，等flushSendQueue把队列发出去
+static void pump(const UdpSocketPtr& socket, const std::vector<char>* chunk, size_t segmentSize, const std::atomic<bool>* stop){
+    if(stop->load(std::memory_order_relaxed)){
+        return;
+    }
+    while(socket->queuedBytes() + chunk->size() <= kMaxQueued){
+        socket->sendSegmented(InetAddress(kReceiverPort), chunk->data(), chunk->size(), segmentSize);
+    }
+    socket->getLoop()->queueInLoop(std::bind(pump, socket, chunk, segmentSize, stop));
+}
+
+int main(int argc, char* argv[]){
+    Options opt = { false, false, 5, 1400, 64 * 1024 };
+    int c;
+    while((c = getopt(argc, argv, "grd:s:c:")) != -1){
+        switch(c){
+            case 'g': opt.gso = true; break;
+            case 'r': opt.gro = true; break;
+            case 'd': opt.seconds = atoi(optarg); break;
+            case 's': opt.segmentSize = std::min(std::max(atoi(optarg), 1), 8192); break;
+            case 'c': opt.chunkSize = std::max(atoi(optarg), 1) * 1024; break;
+            default:
+                fprintf(stderr, "usage: %s [-g] [-r] [-d seconds] [-s segment bytes] [-c chunk KB]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // 日志太多会影响测试结果
+    freopen("/dev/null", "w", stdout);
+    std::vector<char> chunk(opt.chunkSize);
+    for(size_t i = 0; i < chunk.size(); ++i){
+        chunk[i] = static_cast<char>(i / opt.segmentSize);
+    }
+
+    std::atomic<uint64_t> receivedBytes(0);
+    std::atomic<uint64_t> corrupted(0);
+    EventLoop* receiverLoop = nullptr;
+    UdpSocketPtr receiver;
+    std::atomic<bool> receiverReady(false);
+    std::thread receiverThread([&]{
+        EventLoop loop;
+        UdpSocketPtr socket(new UdpSocket(&loop, "receiver", UdpSocket::createBound(InetAddress(kReceiverPort), false), 64, opt.segmentSize));
+        socket->socket()->setRecvBufferSize(8 * 1024 * 1024);
+        if(opt.gro && !socket->enableGro()){
+            fprintf(stderr, "UDP_GRO not supported, receiving plain datagrams\n");
+        }
+        socket->setMessageCallback([&](const UdpSocketPtr&, const UdpDatagram& datagram, Timestamp){
+            receivedBytes += datagram.length;
+            for(size_t pos = 0; pos < datagram.length; pos += datagram.segmentSize){
+                size_t len = std::min(datagram.segmentSize, datagram.length - pos);
+                if(datagram.data[pos] != datagram.data[pos + len - 1]){
+                    ++corrupted;
+                }
+            }
+        });
+        socket->start();
+        receiverLoop = &loop;
+        receiver = socket;
+        receiverReady = true;
+        loop.loop();
+        socket->stop();
+    });
+
+    std::atomic<bool> stop(false);
+    EventLoop* senderLoop = nullptr;
+    UdpSocketPtr sender;
+    std::atomic<bool> senderReady(false);
+    std::thread senderThread([&]{
+        while(!receiverReady){
+            usleep(1000);
+        }
+        EventLoop loop;
+        UdpSocketPtr socket(new UdpSocket(&loop, "sender", UdpSocket::createBound(InetAddress(kSenderPort), false)));
+        socket->socket()->setSendBufferSize(8 * 1024 * 1024);
+        socket->setMaxQueuedBytes(2 * kMaxQueued);
+        if(opt.gso && !socket->enableGso()){
+            fprintf(stderr, "UDP_SEGMENT not supported, sending plain datagrams\n");
+        }
+        socket->start();
+        senderLoop = &loop;
+        sender = socket;
+        senderReady = true;
+        loop.queueInLoop(std::bind(pump, socket, &chunk, opt.segmentSize, &stop));
+        loop.loop();
+        socket->stop();
+    });
+    while(!senderReady){
+        usleep(1000);
+    }
+
+    sleep(1);   // 预热
+    uint64_t bytesBefore = receivedBytes;
+    uint64_t receivedBefore = receiver->receivedDatagrams();
+    uint64_t receiveCallsBefore = receiver->receiveCalls();
+    uint64_t coalescedBefore = receiver->coalescedReceives();
+    uint64_t sentBefore = sender->sentDatagrams();
+    uint64_t sendCallsBefore = sender->sendCalls();
+    double senderCpuBefore = loopCpuSeconds(senderLoop);
+    double receiverCpuBefore = loopCpuSeconds(receiverLoop);
+    double start = nowSeconds();
+    sleep(opt.seconds);
+    double seconds = nowSeconds() - start;
+    double senderCpu = loopCpuSeconds(senderLoop) - senderCpuBefore;
+    double receiverCpu = loopCpuSeconds(receiverLoop) - receiverCpuBefore;
+    uint64_t bytes = receivedBytes - bytesBefore;
+    uint64_t received = receiver->receivedDatagrams() - receivedBefore;
+    uint64_t receiveCalls = receiver->receiveCalls() - receiveCallsBefore;
+    uint64_t coalesced = receiver->coalescedReceives() - coalescedBefore;
+    uint64_t sent = sender->sentDatagrams() - sentBefore;
+    uint64_t sendCalls = sender->sendCalls() - sendCallsBefore;
+    stop = true;
+
+    double gigabytes = bytes / (1024.0 * 1024 * 1024);
+    fprintf(stderr, "gso %s, gro %s, %lu-byte datagrams, %lu KB per sendSegmented\n",
+            sender->gsoEnabled() ? "on" : "off", receiver->groEnabled() ? "on" : "off", opt.segmentSize, opt.chunkSize / 1024);
+    fprintf(stderr, "sent %.0f datagrams/s, %.1f datagrams per sendmmsg, sender cpu %.3f cpu-s/GB\n",
+            sent / seconds, sendCalls > 0 ? static_cast<double>(sent) / sendCalls : 0.0, gigabytes > 0 ? senderCpu / gigabytes : 0.0);
+    fprintf(stderr, "received %.1f MB/s, %.0f datagrams/s, %.1f datagrams per recvmmsg, %lu coalesced buffers, receiver cpu %.3f cpu-s/GB%s\n",
+            bytes / seconds / (1024 * 1024), received / seconds, receiveCalls > 0 ? static_cast<double>(received) / receiveCalls : 0.0,
+            coalesced, gigabytes > 0 ? receiverCpu / gigabytes : 0.0, corrupted > 0 ? ", DATA CORRUPTED" : "");
+
+    senderLoop->quit();
+    senderThread.join();
+    receiverLoop->quit();
+    receiverThread.join();
+    return corrupted > 0 ? 1 : 0;
+}
@@ -0,0 +1,367 @@
+// 兼容memcached文本协议的缓存服务器，也可以作为压测客户端
+// 服务器：./memcached [-p 端口 11211] [-t subloop数 4] [-m 内存MB 64]
+// 压测：  ./memcached -b [-s] [-p 端口] [-c 连接数 50] [-T 客户端线程数 2] [-d 秒数 5] [-k key个数 100000]
+//                     [-v 数据字节数 100] [-r get百分比 90] [-g 每个get的key数 1] [-P pipeline 1]
+// -s表示在同一个进程中启动服务器（使用-t、-m），否则压测-p端口上已经运行的服务器，可以是真正的memcached
+#include <mymuduo/MemcacheServer.h>
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/Buffer.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <deque>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+struct Options{
+    uint16_t port;
+    int subloops;
+    size_t memoryMB;
+    bool bench;
+    bool inProcess;
+    int connections;
+    int clientThreads;
+    int seconds;
+    int keys;
+    int valueSize;
+    int getPercent;
+    int keysPerGet;
+    int pipeline;
+};
+
+static int64_t nowNs(){
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static int connectTo(uint16_t port){
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(::connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0){
+        fprintf(stderr, "connect to port %u failed: %s\n", port, strerror(errno));
+        exit(1);
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+static void appendKey(std::string* out, int key){
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "key:%08d", key);
+    out->append(buf, n);
+}
+
+// 用noreply的set预先写入所有的key，最后一个get确认都处理完了
+static void preload(const Options& opt){
+    int fd = connectTo(opt.port);
+    std::string value(opt.valueSize, 'x');
+    std::string batch;
+    for(int i = 0; i < opt.keys; ++i){
+        batch.append("set ");
+        appendKey(&batch, i);
+        batch.append(" 0 0 " + std::to_string(opt.valueSize) + " noreply\r\n");
+        batch.append(value);
+        batch.append("\r\n");
+        if(batch.size() > 64 * 1024 || i == opt.keys - 1){
+            for(size_t sent = 0; sent < batch.size(); ){
+                ssize_t n = ::write(fd, batch.data() + sent, batch.size() - sent);
+                if(n <= 0){
+                    fprintf(stderr, "preload write failed: %s\n", strerror(errno));
+                    exit(1);
+                }
+                sent += n;
+            }
+            batch.clear();
+        }
+    }
+    const char version[] = "version\r\n";
+    ::write(fd, version, sizeof(version) - 1);
+    char buf[256];
+    ::read(fd, buf, sizeof(buf));
+    ::close(fd);
+}
+
+struct ClientConn{
+    int fd;
+    Buffer input;
+    std::deque<std::pair<int64_t, bool>> outstanding;  // 发送时间，是否是get
+};
+
+struct ClientResult{
+    long requests;
+    long sets;
+    long keysRequested;
+    long hits;
+    std::vector<int> latenciesUs;
+};
+
+class LoadClient{
+    public:
+        LoadClient(const Options& opt, int connections, uint32_t seed)
+            : opt_(opt)
+            , conns_(connections)
+            , rng_(seed | 1)
+            , value_(opt.valueSize, 'v')
+        {}
+
+        void run(std::atomic<int>* ready, std::atomic<bool>* measuring, std::atomic<bool>* stop, ClientResult* result){
+            result_ = result;
+            measuring_ = measuring;
+            int epfd = ::epoll_create1(EPOLL_CLOEXEC);
+            for(size_t i = 0; i < conns_.size(); ++i){
+                conns_[i].fd = connectTo(opt_.port);
+                ::fcntl(conns_[i].fd, F_SETFL, O_NONBLOCK);
+                epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.u32 = static_cast<uint32_t>(i);
+                ::epoll_ctl(epfd, EPOLL_CTL_ADD, conns_[i].fd, &ev);
+            }
+            for(ClientConn& conn : conns_){
+                issue(&conn, opt_.pipeline);
+            }
+            ++*ready;
+
+            std::vector<epoll_event> events(256);
+            while(!stop->load(std::memory_order_relaxed)){
+                int n = ::epoll_wait(epfd, events.data(), static_cast<int>(events.size()), 100);
+                for(int i = 0; i < n; ++i){
+                    ClientConn& conn = conns_[events[i].data.u32];
+                    int savedErrno = 0;
+                    if(conn.input.readFd(conn.fd, &savedErrno) <= 0){
+                        continue;
+                    }
+                    int completed = parseResponses(&conn);
+                    if(completed > 0){
+                        issue(&conn, completed);
+                    }
+                }
+            }
+            for(ClientConn& conn : conns_){
+                ::close(conn.fd);
+            }
+            ::close(epfd);
+        }
+
+    private:
+        uint32_t nextRandom(){
+            // xorshift32
+            rng_ ^= rng_ << 13;
+            rng_ ^= rng_ >> 17;
+            rng_ ^= rng_ << 5;
+            return rng_;
+        }
+
+        void issue(ClientConn* conn, int count){
+            requests_.clear();
+            const int64_t now = nowNs();
+            for(int i = 0; i < count; ++i){
+                bool isGet = static_cast<int>(nextRandom() % 100) < opt_.getPercent;
+                if(isGet){
+                    requests_.append("get");
+                    for(int k = 0; k < opt_.keysPerGet; ++k){
+                        requests_.append(" ");
+                        appendKey(&requests_, nextRandom() % opt_.keys);
+                    }
+                    requests_.append("\r\n");
+                }else{
+                    requests_.append("set ");
+                    appendKey(&requests_, nextRandom() % opt_.keys);
+                    requests_.append(" 0 0 " + std::to_string(opt_.valueSize) + "\r\n");
+                    requests_.append(value_);
+                    requests_.append("\r\n");
+                }
+                conn->outstanding.push_back(std::make_pair(now, isGet));
+            }
+            // 请求很小，socket发送缓冲区一般放得下，阻塞写简化处理
+            ::fcntl(conn->fd, F_SETFL, 0);
+            for(size_t sent = 0; sent < requests_.size(); ){
+                ssize_t n = ::write(conn->fd, requests_.data() + sent, requests_.size() - sent);
+                if(n <= 0){
+                    break;
+                }
+                sent += n;
+            }
+            ::fcntl(conn->fd, F_SETFL, O_NONBLOCK);
+        }
+
+        // 解析完整的响应，返回完成的请求数
+        int parseResponses(ClientConn* conn){
+            int completed = 0;
+            Buffer& in = conn->input;
+            while(!conn->outstanding.empty()){
+                const bool isGet = conn->outstanding.front().second;
+                const char* p = in.peek();
+                const char* end = p + in.readableBytes();
+                int hits = 0;
+                bool complete = false;
+                while(true){
+                    const char* crlf = static_cast<const char*>(memmem(p, end - p, "\r\n", 2));
+                    if(crlf == nullptr){
+                        break;
+                    }
+                    if(isGet && crlf - p > 6 && memcmp(p, "VALUE ", 6) == 0){
+                        // VALUE <key> <flags> <bytes>，跳过数据
+                        const char* lastSpace = static_cast<const char*>(memrchr(p, ' ', crlf - p));
+                        size_t bytes = strtoul(lastSpace + 1, nullptr, 10);
+                        if(static_cast<size_t>(end - crlf) < 2 + bytes + 2){
+                            break;
+                        }
+                        p = crlf + 2 + bytes + 2;
+                        ++hits;
+                        continue;
+                    }
+                    p = crlf + 2;
+                    complete = true;    // END、STORED或者错误
+                    break;
+                }
+                if(!complete){
+                    break;
+                }
+                in.retrieveUntil(p);
+                if(measuring_->load(std::memory_order_relaxed)){
+                    ++result_->requests;
+                    result_->sets += isGet ? 0 : 1;
+                    result_->keysRequested += isGet ? opt_.keysPerGet : 0;
+                    result_->hits += hits;
+                    result_->latenciesUs.push_back(static_cast<int>((nowNs() - conn->outstanding.front().first) / 1000));
+                }
+                conn->outstanding.pop_front();
+                ++completed;
+            }
+            return completed;
+        }
+
+        const Options& opt_;
+        std::vector<ClientConn> conns_;
+        uint32_t rng_;
+        std::string value_;
+        std::string requests_;
+        ClientResult* result_;
+        std::atomic<bool>* measuring_;
+};
+
+static void runBench(const Options& opt){
+    fprintf(stderr, "preloading %d keys of %d bytes...\n", opt.keys, opt.valueSize);
+    preload(opt);
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> measuring(false);
+    std::atomic<bool> stop(false);
+    std::vector<ClientResult> results(opt.clientThreads);
+    std::vector<std::thread> threads;
+    for(int i = 0; i < opt.clientThreads; ++i){
+        int connections = opt.connections / opt.clientThreads + (i < opt.connections % opt.clientThreads ? 1 : 0);
+        results[i] = ClientResult{0, 0, 0, 0, std::vector<int>()};
+        threads.emplace_back([&, i, connections]{
+            LoadClient client(opt, connections, 2654435761u * (i + 1));
+            client.run(&ready, &measuring, &stop, &results[i]);
+        });
+    }
+    while(ready < opt.clientThreads){
+        usleep(10000);
+    }
+    sleep(1);   // 预热
+    measuring = true;
+    int64_t start = nowNs();
+    sleep(opt.seconds);
+    measuring = false;
+    double seconds = (nowNs() - start) / 1e9;
+    stop = true;
+    for(std::thread& t : threads){
+        t.join();
+    }
+
+    long requests = 0;
+    long sets = 0;
+    long keysRequested = 0;
+    long hits = 0;
+    std::vector<int> latencies;
+    for(ClientResult& r : results){
+        requests += r.requests;
+        sets += r.sets;
+        keysRequested += r.keysRequested;
+        hits += r.hits;
+        latencies.insert(latencies.end(), r.latenciesUs.begin(), r.latenciesUs.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) -> int {
+        return latencies.empty() ? 0 : latencies[std::min(latencies.size() - 1, static_cast<size_t>(latencies.size() * p))];
+    };
+    fprintf(stderr, "connections %d, client threads %d, pipeline %d, get %d%% x %d keys, value %d bytes, %d keys\n",
+            opt.connections, opt.clientThreads, opt.pipeline, opt.getPercent, opt.keysPerGet, opt.valueSize, opt.keys);
+    fprintf(stderr, "requests/s %.0f, keys/s %.0f, hit rate %.1f%%\n", requests / seconds,
+            (keysRequested + sets) / seconds,
+            keysRequested > 0 ? hits * 100.0 / keysRequested : 0.0);
+    fprintf(stderr, "latency us: p50 %d, p99 %d, p99.9 %d, max %d\n", percentile(0.5), percentile(0.99), percentile(0.999), latencies.empty() ? 0 : latencies.back());
+}
+
+int main(int argc, char* argv[]){
+    Options opt = { 11211, 4, 64, false, false, 50, 2, 5, 100000, 100, 90, 1, 1 };
+    int c;
+    while((c = getopt(argc, argv, "p:t:m:bsc:T:d:k:v:r:g:P:")) != -1){
+        switch(c){
+            case 'p': opt.port = static_cast<uint16_t>(atoi(optarg)); break;
+            case 't': opt.subloops = atoi(optarg); break;
+            case 'm': opt.memoryMB = atoi(optarg); break;
+            case 'b': opt.bench = true; break;
+            case 's': opt.inProcess = true; break;
+            case 'c': opt.connections = atoi(optarg); break;
+            case 'T': opt.clientThreads = atoi(optarg); break;
+            case 'd': opt.seconds = atoi(optarg); break;
+            case 'k': opt.keys = atoi(optarg); break;
+            case 'v': opt.valueSize = atoi(optarg); break;
+            case 'r': opt.getPercent = atoi(optarg); break;
+            case 'g': opt.keysPerGet = atoi(optarg); break;
+            case 'P': opt.pipeline = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-t subloops] [-m MB] [-b [-s] [-c conns] [-T threads] [-d seconds] [-k keys] [-v bytes] [-r get%%] [-g keys/get] [-P pipeline]]\n", argv[0]);
+                return 1;
+        }
+    }
+    opt.clientThreads = std::max(1, std::min(opt.clientThreads, opt.connections));
+
+    if(opt.bench && !opt.inProcess){
+        runBench(opt);
+        return 0;
+    }
+
+    if(opt.bench){
+        // 日志太多会影响测试结果
+        freopen("/dev/null", "w", stdout);
+    }
+    EventLoop loop;
+    MemcacheServer server(&loop, InetAddress(opt.port), "memcached", opt.memoryMB * 1024 * 1024);
+    server.setThreadNum(opt.subloops);
+    server.start();
+    if(opt.bench){
+        std::thread driver([&]{
+            runBench(opt);
+            loop.quit();
+        });
+        loop.loop();
+        driver.join();
+        return 0;
+    }
+    loop.loop();
+    return 0;
+}
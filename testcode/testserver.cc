@@ -32,8 +32,8 @@ class EchoServer{
         }
 
         void on_message(const TcpConnectionPtr& conn, Buffer* buff, Timestamp time){
-            std::string msg = buff->retrieveAllAsString();
-            conn->send(msg);
+            // 直接发送inputBuffer_中的数据，不拷贝成std::string
+            conn->send(buff);
             conn->shutdown();  // 关闭写端，触发EPOLLHUP，Channel调用closeCallback_
         }
 